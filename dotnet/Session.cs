@@ -2428,7 +2428,12 @@ namespace WinSCP
         internal void DispatchEvents(int interval)
         {
             DateTime start = DateTime.Now;
-            while (_eventsEvent.WaitOne(interval, false))
+            // Newer versions of WinSCP signal the log event, once they write to the XML log,
+            // so that the log readers do not have to wait for the whole interval
+            WaitHandle logEvent = _process?.LogEvent;
+            WaitHandle[] handles =
+                (logEvent != null) ? new WaitHandle[] { _eventsEvent, logEvent } : new WaitHandle[] { _eventsEvent };
+            while (WaitHandle.WaitAny(handles, interval) == 0)
             {
                 lock (_events)
                 {
@@ -29,6 +29,8 @@ namespace WinSCP
         public PipeStream StdOut { get; set; }
         public Stream StdIn { get; set; }
         public string ExecutablePath { get; }
+        // Signaled by WinSCP whenever it adds a record to the XML log
+        public WaitHandle LogEvent { get { return _logEvent; } }
 
         public static ExeSessionProcess CreateForSession(Session session)
         {
@@ -635,6 +637,7 @@ namespace WinSCP
                         _logger.WriteLine("Event {0} is unique", _instanceName);
                         _responseEvent = CreateEvent(ConsoleEventResponse + _instanceName);
                         _cancelEvent = CreateEvent(ConsoleEventCancel + _instanceName);
+                        _logEvent = CreateEvent(ConsoleEventLog + _instanceName);
                         string fileMappingName = ConsoleMapping + _instanceName;
                         _fileMapping = CreateFileMapping(fileMappingName);
                         if (Marshal.GetLastWin32Error() == UnsafeNativeMethods.ERROR_ALREADY_EXISTS)
@@ -878,6 +881,11 @@ namespace WinSCP
                         _cancelEvent.Close();
                         TestEventClosed(ConsoleEventCancel + _instanceName);
                     }
+                    if (_logEvent != null)
+                    {
+                        _logEvent.Close();
+                        TestEventClosed(ConsoleEventLog + _instanceName);
+                    }
                     if (_fileMapping != null)
                     {
                         _fileMapping.Dispose();
@@ -1279,6 +1287,7 @@ namespace WinSCP
         private const string ConsoleEventRequest = "WinSCPConsoleEventRequest";
         private const string ConsoleEventResponse = "WinSCPConsoleEventResponse";
         private const string ConsoleEventCancel = "WinSCPConsoleEventCancel";
+        private const string ConsoleEventLog = "WinSCPConsoleEventLog";
         private const string ConsoleJob = "WinSCPConsoleJob";
         private const string ExeExecutableFileName = "winscp.exe";
 
@@ -1289,6 +1298,7 @@ namespace WinSCP
         private EventWaitHandle _requestEvent;
         private EventWaitHandle _responseEvent;
         private EventWaitHandle _cancelEvent;
+        private EventWaitHandle _logEvent;
         private SafeFileHandle _fileMapping;
         private string _instanceName;
         private Thread _thread;
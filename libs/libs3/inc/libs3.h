@@ -2182,7 +2182,7 @@ void S3_copy_object_range(const S3BucketContext *bucketContext,
                           const char *key, const char *destinationBucket,
                           const char *destinationKey,
                           const int partNo, const char *uploadId,
-                          const unsigned long startOffset, const unsigned long count,
+                          const uint64_t startOffset, const uint64_t count, // WINSCP (was unsigned long)
                           const S3PutProperties *putProperties,
                           int64_t *lastModifiedReturn, int eTagReturnSize,
                           char *eTagReturn, S3RequestContext *requestContext,
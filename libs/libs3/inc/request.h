@@ -81,10 +81,10 @@ typedef struct RequestParams
     const S3GetConditions *getConditions;
 
     // Start byte
-    size_t startByte;
+    uint64_t startByte; // WINSCP (was size_t)
 
     // Byte count
-    size_t byteCount;
+    uint64_t byteCount; // WINSCP (was size_t)
 
     // Put properties
     const S3PutProperties *putProperties;
@@ -200,8 +200,8 @@ void S3_copy_object(const S3BucketContext *bucketContext, const char *key,
 void S3_copy_object_range(const S3BucketContext *bucketContext, const char *key,
                           const char *destinationBucket,
                           const char *destinationKey, const int partNo,
-                          const char *uploadId, const unsigned long startOffset,
-                          const unsigned long count,
+                          const char *uploadId, const uint64_t startOffset, // WINSCP (was unsigned long)
+                          const uint64_t count,
                           const S3PutProperties *putProperties,
                           int64_t *lastModifiedReturn, int eTagReturnSize,
                           char *eTagReturn, S3RequestContext *requestContext,
@@ -302,8 +302,8 @@ void S3_get_object(const S3BucketContext *bucketContext, const char *key,
         0,                                            // copySourceBucketName
         0,                                            // copySourceKey
         getConditions,                                // getConditions
-        static_cast<size_t>(startByte),               // startByte (WINSCP cast)
-        static_cast<size_t>(byteCount),               // byteCount (WINSCP cast)
+        startByte,                                    // startByte
+        byteCount,                                    // byteCount
         0,                                            // putProperties
         handler->responseHandler.propertiesCallback,  // propertiesCallback
         0,                                            // toS3Callback
@@ -415,8 +415,10 @@ static S3Status compose_amz_headers(const RequestParams *params,
         // If byteCount != 0 then we're just copying a range, add header
         if (params->byteCount > 0) {
             char byteRange[64];
-            snprintf(byteRange, sizeof(byteRange), "bytes=%zd-%zd",
-                     params->startByte, params->startByte + params->byteCount);
+            // WINSCP (the range end is inclusive, and %zd truncates on 32-bit)
+            snprintf(byteRange, sizeof(byteRange), "bytes=%llu-%llu",
+                     (unsigned long long) params->startByte,
+                     (unsigned long long) (params->startByte + params->byteCount - 1));
             append_amz_header(values, 0, "x-amz-copy-source-range", byteRange);
         }
         // And the x-amz-metadata-directive header
@@ -6,6 +6,8 @@
 #define CONSOLE_EVENT_REQUEST L"WinSCPConsoleEventRequest"
 #define CONSOLE_EVENT_RESPONSE L"WinSCPConsoleEventResponse"
 #define CONSOLE_EVENT_CANCEL L"WinSCPConsoleEventCancel"
+// optional, signaled whenever a record is added to XML log
+#define CONSOLE_EVENT_LOG L"WinSCPConsoleEventLog"
 #define CONSOLE_JOB L"WinSCPConsoleJob"
 //---------------------------------------------------------------------------
 struct TConsoleCommStruct
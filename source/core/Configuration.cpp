@@ -34,6 +34,7 @@ const UnicodeString DirectoryStatisticsCacheKey(L"DirectoryStatisticsCache");
 const UnicodeString SshHostCAsKey(L"SshHostCAs");
 const UnicodeString CDCacheKey(L"CDCache");
 const UnicodeString BannersKey(L"Banners");
+const UnicodeString ParallelConnectionsKey(L"ParallelConnections");
 //---------------------------------------------------------------------------
 const UnicodeString OpensshFolderName(L".ssh");
 const UnicodeString OpensshAuthorizedKeysFileName(L"authorized_keys");
@@ -236,6 +237,9 @@ void __fastcall TConfiguration::Default()
   FScriptProgressFileNameLimit = 25;
   FQueueTransfersLimit = 2;
   FParallelTransferThreshold = -1; // default (currently off), 0 = explicitly off
+  FParallelTransferPreallocate = true;
+  FQueueTransfersAutoscale = false;
+  FQueueWarmConnections = 0;
   FKeyVersion = 0;
   FSshHostCAList->Default();
   RefreshPuttySshHostCAList();
@@ -314,7 +318,14 @@ THierarchicalStorage * TConfiguration::CreateScpStorage(bool & SessionList)
   else
   {
     UnicodeString StorageName = IniFileStorageName;
-    Result = TIniFileStorage::CreateFromPath(StorageName);
+    if (TBinaryFileStorage::IsBinaryStorage(StorageName))
+    {
+      Result = TBinaryFileStorage::CreateFromPath(StorageName);
+    }
+    else
+    {
+      Result = TIniFileStorage::CreateFromPath(StorageName);
+    }
   }
 
   if ((FOptionsStorage.get() != NULL) && (FOptionsStorage->Count > 0))
@@ -379,6 +390,9 @@ UnicodeString __fastcall TConfiguration::PropertyToKey(const UnicodeString & Pro
     KEY(Integer,  ScriptProgressFileNameLimit); \
     KEY(Integer,  QueueTransfersLimit); \
     KEY(Integer,  ParallelTransferThreshold); \
+    KEY(Bool,     ParallelTransferPreallocate); \
+    KEY(Bool,     QueueTransfersAutoscale); \
+    KEY(Integer,  QueueWarmConnections); \
     KEY(Integer,  KeyVersion); \
     KEY(Bool,     SshHostCAsFromPuTTY); \
     KEY(Integer,  HttpsCertificateValidation); \
@@ -704,6 +718,7 @@ void __fastcall TConfiguration::CopyData(THierarchicalStorage * Source,
 
     CopyAllStringsInSubKey(Source, Target, BannersKey);
     CopyAllStringsInSubKey(Source, Target, LastFingerprintsStorageKey);
+    CopyAllStringsInSubKey(Source, Target, ParallelConnectionsKey);
 
     Target->CloseSubKey();
     Source->CloseSubKey();
@@ -855,6 +870,34 @@ UnicodeString __fastcall TConfiguration::LastFingerprint(const UnicodeString & S
   return Result;
 }
 //---------------------------------------------------------------------------
+// Number of connections, with which the queue transfers autoscaling reached the best throughput for the site
+void TConfiguration::RememberParallelConnections(const UnicodeString & SessionKey, int Connections)
+{
+  std::unique_ptr<THierarchicalStorage> Storage(CreateConfigStorage());
+  Storage->AccessMode = smReadWrite;
+
+  if (Storage->OpenSubKey(ConfigurationSubKey, true) &&
+      Storage->OpenSubKey(ParallelConnectionsKey, true))
+  {
+    Storage->WriteInteger(SessionKey, Connections);
+  }
+}
+//---------------------------------------------------------------------------
+int TConfiguration::LastParallelConnections(const UnicodeString & SessionKey)
+{
+  int Result = 0;
+
+  std::unique_ptr<THierarchicalStorage> Storage(CreateConfigStorage());
+  Storage->AccessMode = smRead;
+
+  if (Storage->OpenSubKey(ConfigurationSubKey, false) &&
+      Storage->OpenSubKey(ParallelConnectionsKey, false))
+  {
+    Result = Storage->ReadInteger(SessionKey, Result);
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
 void __fastcall TConfiguration::Changed()
 {
   TNotifyEvent AOnChange = NULL;
@@ -986,6 +1029,7 @@ TStrings * TConfiguration::GetCaches()
   Result->Add(CombinePaths(ConfigurationSubKey, CDCacheKey));
   Result->Add(CombinePaths(ConfigurationSubKey, BannersKey));
   Result->Add(CombinePaths(ConfigurationSubKey, LastFingerprintsStorageKey));
+  Result->Add(CombinePaths(ConfigurationSubKey, ParallelConnectionsKey));
   return Result.release();
 }
 //---------------------------------------------------------------------------
@@ -87,6 +87,7 @@ private:
   bool FLogActionsRequired;
   UnicodeString FActionsLogFileName;
   UnicodeString FPermanentActionsLogFileName;
+  UnicodeString FActionsLogEventName;
   bool FConfirmOverwriting;
   bool FConfirmResume;
   bool FAutoReadDirectoryAfterOp;
@@ -118,6 +119,9 @@ private:
   int FKeyVersion;
   int FQueueTransfersLimit;
   int FParallelTransferThreshold;
+  bool FParallelTransferPreallocate;
+  bool FQueueTransfersAutoscale;
+  int FQueueWarmConnections;
   UnicodeString FCertificateStorage;
   UnicodeString FAWSAPI;
   UnicodeString FChecksumCommands;
@@ -309,6 +313,8 @@ public:
   void __fastcall SetBannerParams(const UnicodeString & SessionKey, unsigned int Params);
   void __fastcall RememberLastFingerprint(const UnicodeString & SiteKey, const UnicodeString & FingerprintType, const UnicodeString & Fingerprint);
   UnicodeString __fastcall LastFingerprint(const UnicodeString & SiteKey, const UnicodeString & FingerprintType);
+  void RememberParallelConnections(const UnicodeString & SessionKey, int Connections);
+  int LastParallelConnections(const UnicodeString & SessionKey);
   THierarchicalStorage * CreateConfigStorage();
   THierarchicalStorage * CreateConfigRegistryStorage();
   virtual THierarchicalStorage * CreateScpStorage(bool & SessionList);
@@ -374,6 +380,7 @@ public:
   __property bool LogActions  = { read=FLogActions, write=SetLogActions };
   __property bool LogActionsRequired  = { read=FLogActionsRequired, write=FLogActionsRequired };
   __property UnicodeString ActionsLogFileName  = { read=GetActionsLogFileName, write=SetActionsLogFileName };
+  __property UnicodeString ActionsLogEventName  = { read=FActionsLogEventName, write=FActionsLogEventName };
   __property UnicodeString DefaultLogFileName  = { read=GetDefaultLogFileName };
   __property TNotifyEvent OnChange = { read = FOnChange, write = FOnChange };
   __property bool ConfirmOverwriting = { read = GetConfirmOverwriting, write = SetConfirmOverwriting};
@@ -402,6 +409,9 @@ public:
   __property int ScriptProgressFileNameLimit = { read = FScriptProgressFileNameLimit, write = FScriptProgressFileNameLimit };
   __property int QueueTransfersLimit = { read = FQueueTransfersLimit, write = SetQueueTransfersLimit };
   __property int ParallelTransferThreshold = { read = FParallelTransferThreshold, write = FParallelTransferThreshold };
+  __property bool ParallelTransferPreallocate = { read = FParallelTransferPreallocate, write = FParallelTransferPreallocate };
+  __property bool QueueTransfersAutoscale = { read = FQueueTransfersAutoscale, write = FQueueTransfersAutoscale };
+  __property int QueueWarmConnections = { read = FQueueWarmConnections, write = FQueueWarmConnections };
   __property int KeyVersion = { read = FKeyVersion, write = FKeyVersion };
   __property TSshHostCAList * SshHostCAList = { read = GetSshHostCAList, write = SetSshHostCAList };
   __property TSshHostCAList * PuttySshHostCAList = { read = GetPuttySshHostCAList };
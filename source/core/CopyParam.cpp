@@ -56,6 +56,7 @@ void __fastcall TCopyParamType::Default()
   Size = -1;
   PartOffset = -1;
   PartSize = -1;
+  PartPreallocated = false;
   OnceDoneOperation = odoIdle;
   OnTransferOut = NULL;
   OnTransferIn = NULL;
@@ -576,6 +577,7 @@ void __fastcall TCopyParamType::Assign(const TCopyParamType * Source)
   COPY(Size);
   COPY(PartOffset);
   COPY(PartSize);
+  COPY(PartPreallocated);
   COPY(OnceDoneOperation);
   COPY(OnTransferOut);
   COPY(OnTransferIn);
@@ -915,6 +917,7 @@ void __fastcall TCopyParamType::Load(THierarchicalStorage * Storage)
   Size = -1;
   PartOffset = -1;
   PartSize = -1;
+  PartPreallocated = false;
   OnceDoneOperation = odoIdle;
   OnTransferOut = NULL;
   OnTransferIn = NULL;
@@ -967,6 +970,7 @@ void __fastcall TCopyParamType::Save(THierarchicalStorage * Storage, const TCopy
   DebugAssert(Size < 0);
   DebugAssert(PartOffset < 0);
   DebugAssert(PartSize < 0);
+  DebugAssert(!PartPreallocated);
   DebugAssert(OnceDoneOperation == odoIdle);
   DebugAssert(OnTransferOut == NULL);
   DebugAssert(OnTransferIn == NULL);
@@ -1011,6 +1015,7 @@ bool __fastcall TCopyParamType::operator==(const TCopyParamType & rhp) const
     C(Size) &&
     C(PartOffset) &&
     C(PartSize) &&
+    C(PartPreallocated) &&
     C(OnceDoneOperation) &&
     true;
 }
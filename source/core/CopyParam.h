@@ -72,6 +72,7 @@ private:
   __int64 FSize;
   __int64 FPartOffset;
   __int64 FPartSize;
+  bool FPartPreallocated;
   TOnceDoneOperation FOnceDoneOperation;
   TTransferOutEvent FOnTransferOut;
   TTransferInEvent FOnTransferIn;
@@ -149,6 +150,7 @@ public:
   __property __int64 Size = { read = FSize, write = FSize };
   __property __int64 PartSize = { read = FPartSize, write = FPartSize };
   __property __int64 PartOffset = { read = FPartOffset, write = FPartOffset };
+  __property bool PartPreallocated = { read = FPartPreallocated, write = FPartPreallocated };
   __property TOnceDoneOperation OnceDoneOperation = { read = FOnceDoneOperation, write = FOnceDoneOperation };
   __property TTransferOutEvent OnTransferOut = { read = FOnTransferOut, write = FOnTransferOut };
   __property TTransferInEvent OnTransferIn = { read = FOnTransferIn, write = FOnTransferIn };
@@ -314,6 +314,7 @@ void __fastcall TFileMasks::Clear()
   for (size_t Index = 0; Index < std::size(FMasks); Index++)
   {
     Clear(FMasks[Index]);
+    FMasksIndex[Index].Clear();
   }
 }
 //---------------------------------------------------------------------------
@@ -330,109 +331,179 @@ void __fastcall TFileMasks::Clear(TMasks & Masks)
   Masks.clear();
 }
 //---------------------------------------------------------------------------
+void TFileMasks::TMasksIndex::Add(const TMask & Mask, const UnicodeString & FileNameMaskStr, size_t Index)
+{
+  bool Indexed = false;
+  // Only masks without directory part that match by file name alone
+  if ((Mask.DirectoryMaskKind == TMask::TKind::Any) && (Mask.FileNameMaskKind == TMask::TKind::Regular))
+  {
+    // Masks::TMask is case-insensitive
+    UnicodeString Key = AnsiUpperCase(FileNameMaskStr);
+    if (Key.LastDelimiter(MaskSymbols) == 0)
+    {
+      Names[Key].push_back(Index);
+      Indexed = true;
+    }
+    else if ((Key.Length() >= 3) && (Key[1] == L'*') && (Key[2] == L'.') &&
+             (Key.LastDelimiter(MaskSymbols) == 1))
+    {
+      Extensions[Key.SubString(2, Key.Length() - 1)].push_back(Index);
+      Indexed = true;
+    }
+  }
+
+  if (!Indexed)
+  {
+    Others.push_back(Index);
+  }
+}
+//---------------------------------------------------------------------------
+void TFileMasks::TMasksIndex::Clear()
+{
+  Names.clear();
+  Extensions.clear();
+  Others.clear();
+}
+//---------------------------------------------------------------------------
+bool TFileMasks::MatchesIndexedMasks(
+  const TMasksIndex::TLookup & Lookup, const UnicodeString & Key, const TMasks & Masks, const TParams * Params)
+{
+  bool Result = false;
+  TMasksIndex::TLookup::const_iterator I = Lookup.find(Key);
+  if (I != Lookup.end())
+  {
+    // The file name matches already, only the size and time bounds remain to be checked
+    const std::vector<size_t> & Indexes = I->second;
+    for (size_t Index = 0; !Result && (Index < Indexes.size()); Index++)
+    {
+      Result = MatchesMaskParams(Masks[Indexes[Index]], Params);
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
 bool __fastcall TFileMasks::MatchesMasks(
   const UnicodeString & FileName, bool Local, bool Directory,
-  const UnicodeString & Path, const TParams * Params, const TMasks & Masks, bool Recurse)
+  const UnicodeString & Path, const TParams * Params, const TMasks & Masks, const TMasksIndex & Index, bool Recurse)
 {
   bool Result = false;
 
-  TMasks::const_iterator I = Masks.begin();
-  while (!Result && (I != Masks.end()))
+  if (!Index.Names.empty() || !Index.Extensions.empty())
+  {
+    UnicodeString Key = AnsiUpperCase(FileName);
+    Result = MatchesIndexedMasks(Index.Names, Key, Masks, Params);
+
+    // "*.gz" and "*.tar.gz" both match "a.tar.gz"
+    for (int P = 1; !Result && !Index.Extensions.empty() && (P <= Key.Length()); P++)
+    {
+      if (Key[P] == L'.')
+      {
+        Result = MatchesIndexedMasks(Index.Extensions, Key.SubString(P, Key.Length() - P + 1), Masks, Params);
+      }
+    }
+  }
+
+  std::vector<size_t>::const_iterator I = Index.Others.begin();
+  while (!Result && (I != Index.Others.end()))
   {
-    const TMask & Mask = *I;
+    const TMask & Mask = Masks[*I];
     Masks::TMask * DirectoryMask = Local ? Mask.LocalDirectoryMask : Mask.RemoteDirectoryMask;
     Result =
       MatchesMaskMask(Mask.DirectoryMaskKind, DirectoryMask, Path) &&
-      MatchesMaskMask(Mask.FileNameMaskKind, Mask.FileNameMask, FileName);
+      MatchesMaskMask(Mask.FileNameMaskKind, Mask.FileNameMask, FileName) &&
+      MatchesMaskParams(Mask, Params);
 
-    if (Result)
-    {
-      bool HasSize = (Params != NULL);
-
-      switch (Mask.HighSizeMask)
-      {
-        case TMask::None:
-          Result = true;
-          break;
+    I++;
+  }
 
-        case TMask::Open:
-          Result = HasSize && (Params->Size < Mask.HighSize);
-          break;
+  if (!Result && Directory && !IsUnixRootPath(Path) && Recurse)
+  {
+    UnicodeString ParentFileName = UnixExtractFileName(Path);
+    UnicodeString ParentPath = SimpleUnixExcludeTrailingBackslash(UnixExtractFilePath(Path));
+    // Pass Params down or not?
+    // Currently it includes Size/Time only, what is not used for directories.
+    // So it depends on future use. Possibly we should make a copy
+    // and pass on only relevant fields.
+    Result = MatchesMasks(ParentFileName, Local, true, ParentPath, Params, Masks, Index, Recurse);
+  }
 
-        case TMask::Close:
-          Result = HasSize && (Params->Size <= Mask.HighSize);
-          break;
-      }
+  return Result;
+}
+//---------------------------------------------------------------------------
+bool TFileMasks::MatchesMaskParams(const TMask & Mask, const TParams * Params)
+{
+  bool Result = false;
+  bool HasSize = (Params != NULL);
 
-      if (Result)
-      {
-        switch (Mask.LowSizeMask)
-        {
-          case TMask::None:
-            Result = true;
-            break;
+  switch (Mask.HighSizeMask)
+  {
+    case TMask::None:
+      Result = true;
+      break;
 
-          case TMask::Open:
-            Result = HasSize && (Params->Size > Mask.LowSize);
-            break;
+    case TMask::Open:
+      Result = HasSize && (Params->Size < Mask.HighSize);
+      break;
 
-          case TMask::Close:
-            Result = HasSize && (Params->Size >= Mask.LowSize);
-            break;
-        }
-      }
+    case TMask::Close:
+      Result = HasSize && (Params->Size <= Mask.HighSize);
+      break;
+  }
 
-      bool HasModification = (Params != NULL);
+  if (Result)
+  {
+    switch (Mask.LowSizeMask)
+    {
+      case TMask::None:
+        Result = true;
+        break;
 
-      if (Result)
-      {
-        switch (Mask.HighModificationMask)
-        {
-          case TMask::None:
-            Result = true;
-            break;
+      case TMask::Open:
+        Result = HasSize && (Params->Size > Mask.LowSize);
+        break;
 
-          case TMask::Open:
-            Result = HasModification && (Params->Modification < Mask.HighModification);
-            break;
+      case TMask::Close:
+        Result = HasSize && (Params->Size >= Mask.LowSize);
+        break;
+    }
+  }
 
-          case TMask::Close:
-            Result = HasModification && (Params->Modification <= Mask.HighModification);
-            break;
-        }
-      }
+  bool HasModification = (Params != NULL);
 
-      if (Result)
-      {
-        switch (Mask.LowModificationMask)
-        {
-          case TMask::None:
-            Result = true;
-            break;
+  if (Result)
+  {
+    switch (Mask.HighModificationMask)
+    {
+      case TMask::None:
+        Result = true;
+        break;
 
-          case TMask::Open:
-            Result = HasModification && (Params->Modification > Mask.LowModification);
-            break;
+      case TMask::Open:
+        Result = HasModification && (Params->Modification < Mask.HighModification);
+        break;
 
-          case TMask::Close:
-            Result = HasModification && (Params->Modification >= Mask.LowModification);
-            break;
-        }
-      }
+      case TMask::Close:
+        Result = HasModification && (Params->Modification <= Mask.HighModification);
+        break;
     }
-
-    I++;
   }
 
-  if (!Result && Directory && !IsUnixRootPath(Path) && Recurse)
+  if (Result)
   {
-    UnicodeString ParentFileName = UnixExtractFileName(Path);
-    UnicodeString ParentPath = SimpleUnixExcludeTrailingBackslash(UnixExtractFilePath(Path));
-    // Pass Params down or not?
-    // Currently it includes Size/Time only, what is not used for directories.
-    // So it depends on future use. Possibly we should make a copy
-    // and pass on only relevant fields.
-    Result = MatchesMasks(ParentFileName, Local, true, ParentPath, Params, Masks, Recurse);
+    switch (Mask.LowModificationMask)
+    {
+      case TMask::None:
+        Result = true;
+        break;
+
+      case TMask::Open:
+        Result = HasModification && (Params->Modification > Mask.LowModification);
+        break;
+
+      case TMask::Close:
+        Result = HasModification && (Params->Modification >= Mask.LowModification);
+        break;
+    }
   }
 
   return Result;
@@ -443,10 +514,15 @@ bool TFileMasks::DoMatches(
   bool RecurseInclude, bool & ImplicitMatch) const
 {
   bool ImplicitIncludeMatch = (FAllDirsAreImplicitlyIncluded && Directory) || FMasks[MASK_INDEX(Directory, true)].empty();
-  bool ExplicitIncludeMatch = MatchesMasks(FileName, Local, Directory, Path, Params, FMasks[MASK_INDEX(Directory, true)], RecurseInclude);
+  bool ExplicitIncludeMatch =
+    MatchesMasks(
+      FileName, Local, Directory, Path, Params,
+      FMasks[MASK_INDEX(Directory, true)], FMasksIndex[MASK_INDEX(Directory, true)], RecurseInclude);
   bool Result =
     (ImplicitIncludeMatch || ExplicitIncludeMatch) &&
-    !MatchesMasks(FileName, Local, Directory, Path, Params, FMasks[MASK_INDEX(Directory, false)], false);
+    !MatchesMasks(
+      FileName, Local, Directory, Path, Params,
+      FMasks[MASK_INDEX(Directory, false)], FMasksIndex[MASK_INDEX(Directory, false)], false);
   ImplicitMatch =
     Result && ImplicitIncludeMatch && !ExplicitIncludeMatch &&
     ((Directory && FNoImplicitMatchWithDirExcludeMask) || FMasks[MASK_INDEX(Directory, false)].empty());
@@ -525,7 +601,8 @@ Masks::TMask * TFileMasks::DoCreateMaskMask(const UnicodeString & Str)
 }
 //---------------------------------------------------------------------------
 void __fastcall TFileMasks::CreateMaskMask(
-  const UnicodeString & Mask, int Start, int End, bool Ex, TMask::TKind & MaskKind, Masks::TMask *& MaskMask)
+  const UnicodeString & Mask, int Start, int End, bool Ex, TMask::TKind & MaskKind, Masks::TMask *& MaskMask,
+  UnicodeString * MaskStr)
 {
   try
   {
@@ -539,6 +616,10 @@ void __fastcall TFileMasks::CreateMaskMask(
     {
       MaskKind = (Ex && (Mask == L"*.")) ? TMask::TKind::NoExt : TMask::TKind::Regular;
       MaskMask = DoCreateMaskMask(Mask);
+      if (MaskStr != NULL)
+      {
+        *MaskStr = Mask;
+      }
     }
   }
   catch(...)
@@ -578,6 +659,7 @@ void __fastcall TFileMasks::CreateMask(
   Mask.LowSizeMask = TMask::None;
   Mask.HighModificationMask = TMask::None;
   Mask.LowModificationMask = TMask::None;
+  UnicodeString FileNameMaskStr;
 
   wchar_t NextPartDelimiter = L'\0';
   int NextPartFrom = 1;
@@ -717,16 +799,18 @@ void __fastcall TFileMasks::CreateMask(
         CreateMaskMask(
           PartStr.SubString(D + 1, PartStr.Length() - D),
           PartStart + D, PartEnd, true,
-          Mask.FileNameMaskKind, Mask.FileNameMask);
+          Mask.FileNameMaskKind, Mask.FileNameMask, &FileNameMaskStr);
       }
       else
       {
-        CreateMaskMask(PartStr, PartStart, PartEnd, true, Mask.FileNameMaskKind, Mask.FileNameMask);
+        CreateMaskMask(PartStr, PartStart, PartEnd, true, Mask.FileNameMaskKind, Mask.FileNameMask, &FileNameMaskStr);
       }
     }
   }
 
-  FMasks[MASK_INDEX(Directory, Include)].push_back(Mask);
+  int Index = MASK_INDEX(Directory, Include);
+  FMasksIndex[Index].Add(Mask, FileNameMaskStr, FMasks[Index].size());
+  FMasks[Index].push_back(Mask);
 }
 //---------------------------------------------------------------------------
 TStrings * __fastcall TFileMasks::GetMasksStr(int Index) const
@@ -3,6 +3,7 @@
 #define FileMasksH
 //---------------------------------------------------------------------------
 #include <vector>
+#include <map>
 #include <Masks.hpp>
 #include <Global.h>
 //---------------------------------------------------------------------------
@@ -105,12 +106,27 @@ private:
 
   typedef std::vector<TMask> TMasks;
   TMasks FMasks[4];
+
+  // Allows finding masks with literal file name or extension by a lookup,
+  // instead of evaluating them one by one
+  struct TMasksIndex
+  {
+    typedef std::map<UnicodeString, std::vector<size_t> > TLookup;
+    TLookup Names;
+    TLookup Extensions;
+    std::vector<size_t> Others;
+
+    void Add(const TMask & Mask, const UnicodeString & FileNameMaskStr, size_t Index);
+    void Clear();
+  };
+  TMasksIndex FMasksIndex[4];
   mutable TStrings * FMasksStr[4];
 
   void __fastcall SetStr(const UnicodeString value, bool SingleMask);
   void __fastcall SetMasks(const UnicodeString value);
   void __fastcall CreateMaskMask(
-    const UnicodeString & Mask, int Start, int End, bool Ex, TMask::TKind & MaskKind, Masks::TMask *& MaskMask);
+    const UnicodeString & Mask, int Start, int End, bool Ex, TMask::TKind & MaskKind, Masks::TMask *& MaskMask,
+    UnicodeString * MaskStr = NULL);
   void __fastcall CreateMask(const UnicodeString & MaskStr, int MaskStart,
     int MaskEnd, bool Include);
   TStrings * __fastcall GetMasksStr(int Index) const;
@@ -123,7 +139,10 @@ private:
   static void __fastcall TrimEx(UnicodeString & Str, int & Start, int & End);
   static bool __fastcall MatchesMasks(
     const UnicodeString & FileName, bool Local, bool Directory,
-    const UnicodeString & Path, const TParams * Params, const TMasks & Masks, bool Recurse);
+    const UnicodeString & Path, const TParams * Params, const TMasks & Masks, const TMasksIndex & Index, bool Recurse);
+  static bool MatchesMaskParams(const TMask & Mask, const TParams * Params);
+  static bool MatchesIndexedMasks(
+    const TMasksIndex::TLookup & Lookup, const UnicodeString & Key, const TMasks & Masks, const TParams * Params);
   static inline bool MatchesMaskMask(TMask::TKind MaskKind, Masks::TMask * MaskMask, const UnicodeString & Str);
   static Masks::TMask * DoCreateMaskMask(const UnicodeString & Str);
   NORETURN void __fastcall ThrowError(int Start, int End);
@@ -13,6 +13,7 @@
 #include "NeonIntf.h"
 #include "SessionInfo.h"
 #include "Cryptography.h"
+#include "PuttyTools.h"
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wold-style-cast"
 #include <openssl/x509_vfy.h>
@@ -59,6 +60,7 @@ protected:
   virtual std::wstring GetClientString();
   virtual void SetupSsl(ssl_st * Ssl);
   virtual std::wstring CustomReason(int Err);
+  virtual CZlibStream * CreateZlibStream(bool Compress, int Level);
 
 private:
   TFTPFileSystem * FFileSystem;
@@ -187,6 +189,46 @@ std::wstring TFileZillaImpl::CustomReason(int Err)
   return Result;
 }
 //---------------------------------------------------------------------------
+class TFtpZlibStream : public CZlibStream
+{
+public:
+  TFtpZlibStream(bool Compress, int Level) :
+    FStream(Compress, Level)
+  {
+  }
+
+  virtual bool Process(const char * Data, int Len, std::string & Output)
+  {
+    RawByteString Buf;
+    bool Result = FStream.Process(Data, Len, Buf);
+    if (Result)
+    {
+      Output.assign(Buf.c_str(), Buf.Length());
+    }
+    return Result;
+  }
+
+  virtual void Finish(std::string & Output)
+  {
+    RawByteString Buf;
+    FStream.Finish(Buf);
+    Output.assign(Buf.c_str(), Buf.Length());
+  }
+
+  virtual bool IsComplete()
+  {
+    return FStream.IsComplete();
+  }
+
+private:
+  TZlibStream FStream;
+};
+//---------------------------------------------------------------------------
+CZlibStream * TFileZillaImpl::CreateZlibStream(bool Compress, int Level)
+{
+  return new TFtpZlibStream(Compress, Level);
+}
+//---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 class TMessageQueue : public std::list<std::pair<WPARAM, LPARAM> >
 {
@@ -2927,6 +2969,10 @@ int __fastcall TFTPFileSystem::GetOptionVal(int OptionID) const
       Result = (FWorkFromCwd == asOn);
       break;
 
+    case OPTION_MPEXT_MODEZ_LEVEL:
+      Result = Data->FtpModeZLevel;
+      break;
+
     case OPTION_MPEXT_TRANSFER_SIZE:
       {
         __int64 TransferSize = 0;
@@ -1339,6 +1339,10 @@ void __fastcall TCustomIniFileStorage::DoGetSubKeyNames(TStrings * Strings)
     FMasterStorage->GetSubKeyNames(Strings);
   }
   CacheSections();
+  // Sorted copy of the names, as Strings->IndexOf would be quadratic with large number of sites
+  std::unique_ptr<TStringList> Names(new TStringList());
+  Names->AddStrings(Strings);
+  Names->Sorted = true;
   for (int i = 0; i < FSections->Count; i++)
   {
     UnicodeString Section = FSections->Strings[i];
@@ -1352,9 +1356,11 @@ void __fastcall TCustomIniFileStorage::DoGetSubKeyNames(TStrings * Strings)
       {
         SubSection.SetLength(P - 1);
       }
-      if (Strings->IndexOf(SubSection) < 0)
+      if (Names->IndexOf(SubSection) < 0)
       {
-        Strings->Add(UnMungeStr(SubSection));
+        UnicodeString Name = UnMungeStr(SubSection);
+        Strings->Add(Name);
+        Names->Add(Name);
       }
     }
   }
@@ -2112,3 +2118,459 @@ bool __fastcall TOptionsStorage::GetTemporary()
 {
   return true;
 }
+//===========================================================================
+// Compact binary snapshot of INI-like sections, to avoid parsing (and writing) the text format value by value.
+// Layout: signature, section count, then for each section its name, value count and name/value pairs.
+// Counts are 32-bit little-endian, strings are UTF-8 prefixed by their 32-bit length.
+static const char BinaryStorageSignature[] = "WSCPCFG1";
+static const int BinaryStorageSignatureLen = sizeof(BinaryStorageSignature) - 1;
+static const UnicodeString BinaryStorageExt(L".bin");
+//---------------------------------------------------------------------------
+class TBinaryIniFile : public TCustomIniFile
+{
+public:
+  __fastcall TBinaryIniFile(const UnicodeString & FileName);
+
+  virtual UnicodeString __fastcall ReadString(const UnicodeString Section, const UnicodeString Ident, const UnicodeString Default);
+  virtual void __fastcall WriteString(const UnicodeString Section, const UnicodeString Ident, const UnicodeString Value);
+  virtual void __fastcall ReadSection(const UnicodeString Section, TStrings * Strings);
+  virtual void __fastcall ReadSections(TStrings* Strings);
+  virtual void __fastcall ReadSectionValues(const UnicodeString Section, TStrings* Strings);
+  virtual void __fastcall EraseSection(const UnicodeString Section);
+  virtual void __fastcall DeleteKey(const UnicodeString Section, const UnicodeString Ident);
+  virtual void __fastcall UpdateFile();
+  virtual bool __fastcall ValueExists(const UnicodeString Section, const UnicodeString Ident);
+  // Hoisted overload
+  void __fastcall ReadSections(const UnicodeString Section, TStrings* Strings);
+
+  void Load(const RawByteString & Data);
+  RawByteString Save();
+
+  bool Modified;
+
+private:
+  typedef std::pair<UnicodeString, UnicodeString> TValue;
+  typedef std::vector<TValue> TValues;
+  // Values are kept in the order they were written, like in INI files,
+  // as some lists rely on it (e.g. history or custom commands)
+  struct TSection
+  {
+    UnicodeString Name;
+    TValues Values;
+    // Keyed by uppercase names, indexes to Values
+    std::map<UnicodeString, size_t> Index;
+
+    const TValue * FindValue(const UnicodeString & Ident) const;
+    bool SetValue(const UnicodeString & Ident, const UnicodeString & Value);
+    bool DeleteValue(const UnicodeString & Ident);
+  };
+  // Keyed by uppercase names, as INI files are case-insensitive
+  typedef std::map<UnicodeString, TSection> TSections;
+  TSections FSections;
+
+  const TSection * FindSection(const UnicodeString & Section);
+};
+//---------------------------------------------------------------------------
+__fastcall TBinaryIniFile::TBinaryIniFile(const UnicodeString & FileName) :
+  TCustomIniFile(FileName)
+{
+  Modified = false;
+}
+//---------------------------------------------------------------------------
+const TBinaryIniFile::TValue * TBinaryIniFile::TSection::FindValue(const UnicodeString & Ident) const
+{
+  std::map<UnicodeString, size_t>::const_iterator I = Index.find(AnsiUpperCase(Ident));
+  return (I != Index.end()) ? &Values[I->second] : NULL;
+}
+//---------------------------------------------------------------------------
+bool TBinaryIniFile::TSection::SetValue(const UnicodeString & Ident, const UnicodeString & Value)
+{
+  bool Result = true;
+  UnicodeString Key = AnsiUpperCase(Ident);
+  std::map<UnicodeString, size_t>::const_iterator I = Index.find(Key);
+  if (I == Index.end())
+  {
+    Index.insert(std::make_pair(Key, Values.size()));
+    Values.push_back(TValue(Ident, Value));
+  }
+  else if (Values[I->second].second != Value)
+  {
+    Values[I->second] = TValue(Ident, Value);
+  }
+  else
+  {
+    Result = false;
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+bool TBinaryIniFile::TSection::DeleteValue(const UnicodeString & Ident)
+{
+  std::map<UnicodeString, size_t>::iterator I = Index.find(AnsiUpperCase(Ident));
+  bool Result = (I != Index.end());
+  if (Result)
+  {
+    size_t Deleted = I->second;
+    Values.erase(Values.begin() + Deleted);
+    Index.erase(I);
+    for (I = Index.begin(); I != Index.end(); I++)
+    {
+      if (I->second > Deleted)
+      {
+        I->second--;
+      }
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+const TBinaryIniFile::TSection * TBinaryIniFile::FindSection(const UnicodeString & Section)
+{
+  TSections::const_iterator I = FSections.find(AnsiUpperCase(Section));
+  return (I != FSections.end()) ? &I->second : NULL;
+}
+//---------------------------------------------------------------------------
+UnicodeString __fastcall TBinaryIniFile::ReadString(const UnicodeString Section, const UnicodeString Ident, const UnicodeString Default)
+{
+  UnicodeString Result = Default;
+  const TSection * ASection = FindSection(Section);
+  if (ASection != NULL)
+  {
+    const TValue * AValue = ASection->FindValue(Ident);
+    if (AValue != NULL)
+    {
+      Result = AValue->second;
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+void __fastcall TBinaryIniFile::WriteString(const UnicodeString Section, const UnicodeString Ident, const UnicodeString Value)
+{
+  TSection & ASection = FSections[AnsiUpperCase(Section)];
+  if (ASection.Name.IsEmpty())
+  {
+    ASection.Name = Section;
+  }
+  if (ASection.SetValue(Ident, Value))
+  {
+    Modified = true;
+  }
+}
+//---------------------------------------------------------------------------
+bool __fastcall TBinaryIniFile::ValueExists(const UnicodeString Section, const UnicodeString Ident)
+{
+  const TSection * ASection = FindSection(Section);
+  return
+    (ASection != NULL) &&
+    (ASection->FindValue(Ident) != NULL);
+}
+//---------------------------------------------------------------------------
+void __fastcall TBinaryIniFile::ReadSection(const UnicodeString Section, TStrings * Strings)
+{
+  const TSection * ASection = FindSection(Section);
+  if (ASection != NULL)
+  {
+    Strings->BeginUpdate();
+    try
+    {
+      for (TValues::const_iterator I = ASection->Values.begin(); I != ASection->Values.end(); I++)
+      {
+        Strings->Add(I->first);
+      }
+    }
+    __finally
+    {
+      Strings->EndUpdate();
+    }
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TBinaryIniFile::ReadSections(TStrings * Strings)
+{
+  Strings->BeginUpdate();
+  try
+  {
+    for (TSections::const_iterator I = FSections.begin(); I != FSections.end(); I++)
+    {
+      Strings->Add(I->second.Name);
+    }
+  }
+  __finally
+  {
+    Strings->EndUpdate();
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TBinaryIniFile::ReadSectionValues(const UnicodeString Section, TStrings * Strings)
+{
+  const TSection * ASection = FindSection(Section);
+  if (ASection != NULL)
+  {
+    for (TValues::const_iterator I = ASection->Values.begin(); I != ASection->Values.end(); I++)
+    {
+      Strings->Add(I->first + L"=" + I->second);
+    }
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TBinaryIniFile::EraseSection(const UnicodeString Section)
+{
+  if (FSections.erase(AnsiUpperCase(Section)) > 0)
+  {
+    Modified = true;
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TBinaryIniFile::DeleteKey(const UnicodeString Section, const UnicodeString Ident)
+{
+  TSections::iterator I = FSections.find(AnsiUpperCase(Section));
+  if ((I != FSections.end()) &&
+      I->second.DeleteValue(Ident))
+  {
+    Modified = true;
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TBinaryIniFile::UpdateFile()
+{
+  // noop, saved by TBinaryFileStorage::Flush
+}
+//---------------------------------------------------------------------------
+void __fastcall TBinaryIniFile::ReadSections(const UnicodeString /*Section*/, TStrings * /*Strings*/)
+{
+  NotImplemented();
+}
+//---------------------------------------------------------------------------
+static void AddBinaryStorageCount(RawByteString & Data, size_t Count)
+{
+  unsigned char Buf[4];
+  for (int Index = 0; Index < 4; Index++)
+  {
+    Buf[Index] = static_cast<unsigned char>((Count >> (Index * 8)) & 0xFF);
+  }
+  Data += RawByteString(reinterpret_cast<const char *>(Buf), sizeof(Buf));
+}
+//---------------------------------------------------------------------------
+static void AddBinaryStorageString(RawByteString & Data, const UnicodeString & Str)
+{
+  UTF8String Buf(Str);
+  AddBinaryStorageCount(Data, Buf.Length());
+  Data += RawByteString(Buf.c_str(), Buf.Length());
+}
+//---------------------------------------------------------------------------
+RawByteString TBinaryIniFile::Save()
+{
+  RawByteString Result(BinaryStorageSignature, BinaryStorageSignatureLen);
+  AddBinaryStorageCount(Result, FSections.size());
+  for (TSections::const_iterator I = FSections.begin(); I != FSections.end(); I++)
+  {
+    const TSection & Section = I->second;
+    AddBinaryStorageString(Result, Section.Name);
+    AddBinaryStorageCount(Result, Section.Values.size());
+    for (TValues::const_iterator I2 = Section.Values.begin(); I2 != Section.Values.end(); I2++)
+    {
+      AddBinaryStorageString(Result, I2->first);
+      AddBinaryStorageString(Result, I2->second);
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+class TBinaryStorageReader
+{
+public:
+  TBinaryStorageReader(const RawByteString & Data, const UnicodeString & FileName) :
+    FData(Data), FFileName(FileName), FPos(BinaryStorageSignatureLen)
+  {
+  }
+
+  size_t ReadCount()
+  {
+    Need(4);
+    const unsigned char * P = reinterpret_cast<const unsigned char *>(FData.c_str()) + FPos;
+    size_t Result = P[0] | (P[1] << 8) | (P[2] << 16) | (static_cast<size_t>(P[3]) << 24);
+    FPos += 4;
+    return Result;
+  }
+
+  UnicodeString ReadString()
+  {
+    size_t Len = ReadCount();
+    Need(Len);
+    UnicodeString Result = UTF8ToString(FData.SubString(FPos + 1, Len));
+    FPos += Len;
+    return Result;
+  }
+
+private:
+  const RawByteString & FData;
+  UnicodeString FFileName;
+  size_t FPos;
+
+  void Need(size_t Len)
+  {
+    if (Len > static_cast<size_t>(FData.Length()) - FPos)
+    {
+      throw Exception(FMTLOAD(READ_ERROR, (FFileName)));
+    }
+  }
+};
+//---------------------------------------------------------------------------
+void TBinaryIniFile::Load(const RawByteString & Data)
+{
+  if (Data.SubString(1, BinaryStorageSignatureLen) != RawByteString(BinaryStorageSignature))
+  {
+    throw Exception(FMTLOAD(READ_ERROR, (FileName)));
+  }
+  TBinaryStorageReader Reader(Data, FileName);
+  FSections.clear();
+  size_t SectionCount = Reader.ReadCount();
+  for (size_t SectionIndex = 0; SectionIndex < SectionCount; SectionIndex++)
+  {
+    UnicodeString SectionName = Reader.ReadString();
+    TSection & Section = FSections[AnsiUpperCase(SectionName)];
+    Section.Name = SectionName;
+    size_t ValueCount = Reader.ReadCount();
+    for (size_t ValueIndex = 0; ValueIndex < ValueCount; ValueIndex++)
+    {
+      UnicodeString Name = Reader.ReadString();
+      UnicodeString Value = Reader.ReadString();
+      Section.SetValue(Name, Value);
+    }
+  }
+  Modified = false;
+}
+//===========================================================================
+bool __fastcall TBinaryFileStorage::IsBinaryStorage(const UnicodeString & FileName)
+{
+  bool Result;
+  if (!FileExists(ApiPath(FileName)))
+  {
+    Result = SameText(ExtractFileExt(FileName), BinaryStorageExt);
+  }
+  else
+  {
+    std::unique_ptr<TStream> Stream(TSafeHandleStream::CreateFromFile(FileName, fmOpenRead | fmShareDenyWrite));
+    char Buf[BinaryStorageSignatureLen];
+    Result =
+      (Stream->Read(Buf, BinaryStorageSignatureLen) == BinaryStorageSignatureLen) &&
+      (memcmp(Buf, BinaryStorageSignature, BinaryStorageSignatureLen) == 0);
+    // Allow starting with an empty file
+    if (!Result && (Stream->Size == 0))
+    {
+      Result = SameText(ExtractFileExt(FileName), BinaryStorageExt);
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+TBinaryFileStorage * __fastcall TBinaryFileStorage::CreateFromPath(const UnicodeString & AStorage)
+{
+  // See TIniFileStorage::CreateFromPath for reasons why this is a factory
+  std::unique_ptr<TBinaryIniFile> IniFile(new TBinaryIniFile(AStorage));
+  if (FileExists(ApiPath(AStorage)))
+  {
+    RawByteString Data;
+    try
+    {
+      // Read the file in one go, what matters on network shares
+      std::unique_ptr<TStream> Stream(TSafeHandleStream::CreateFromFile(AStorage, fmOpenRead | fmShareDenyWrite));
+      Data.SetLength(static_cast<int>(Stream->Size));
+      if (Data.Length() > 0)
+      {
+        Stream->ReadBuffer(Data.c_str(), Data.Length());
+      }
+    }
+    catch (Exception & E)
+    {
+      throw ExtException(&E, FMTLOAD(READ_ERROR, (AStorage)));
+    }
+    if (Data.Length() > 0)
+    {
+      IniFile->Load(Data);
+    }
+  }
+  return new TBinaryFileStorage(AStorage, IniFile.release());
+}
+//---------------------------------------------------------------------------
+__fastcall TBinaryFileStorage::TBinaryFileStorage(const UnicodeString & AStorage, TCustomIniFile * IniFile):
+  TCustomIniFileStorage(AStorage, IniFile)
+{
+}
+//---------------------------------------------------------------------------
+__fastcall TBinaryFileStorage::~TBinaryFileStorage()
+{
+  Flush();
+}
+//---------------------------------------------------------------------------
+void __fastcall TBinaryFileStorage::Flush()
+{
+  if (FMasterStorage.get() != NULL)
+  {
+    FMasterStorage->Flush();
+  }
+  TBinaryIniFile * IniFile = DebugNotNull(dynamic_cast<TBinaryIniFile *>(FIniFile));
+  if (IniFile->Modified)
+  {
+    bool Exists = FileExists(ApiPath(Storage));
+    // preserve attributes (especially hidden)
+    int Attr = Exists ? GetFileAttributes(ApiPath(Storage).c_str()) : FILE_ATTRIBUTE_NORMAL;
+    if (FLAGSET(Attr, FILE_ATTRIBUTE_READONLY) && ForceSave)
+    {
+      SetFileAttributes(ApiPath(Storage).c_str(), Attr & ~FILE_ATTRIBUTE_READONLY);
+    }
+
+    // Write to a temporary file and replace the original only once complete,
+    // so that an interrupted save does not leave a truncated configuration behind.
+    // The name is unique to the process, as other instance may be saving the same file.
+    UnicodeString TempStorage = FORMAT(L"%s.%d.tmp", (Storage, static_cast<int>(GetCurrentProcessId())));
+    int Error = 0;
+    HANDLE Handle =
+      CreateFile(ApiPath(TempStorage).c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if (Handle == INVALID_HANDLE_VALUE)
+    {
+      Error = GetLastError();
+    }
+    else
+    {
+      try
+      {
+        RawByteString Data = IniFile->Save();
+        std::unique_ptr<TStream> Stream(new TSafeHandleStream(int(Handle)));
+        try
+        {
+          Stream->WriteBuffer(Data.c_str(), Data.Length());
+        }
+        __finally
+        {
+          CloseHandle(Handle);
+        }
+      }
+      catch (Exception & E)
+      {
+        DeleteFile(ApiPath(TempStorage));
+        throw ExtException(&E, FMTLOAD((Exists ? WRITE_ERROR : CREATE_FILE_ERROR), (Storage)));
+      }
+
+      SetFileAttributes(ApiPath(TempStorage).c_str(), Attr);
+      if (!MoveFileEx(ApiPath(TempStorage).c_str(), ApiPath(Storage).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+      {
+        Error = GetLastError();
+        SetFileAttributes(ApiPath(TempStorage).c_str(), FILE_ATTRIBUTE_NORMAL);
+        DeleteFile(ApiPath(TempStorage));
+      }
+    }
+
+    if (Error == 0)
+    {
+      IniFile->Modified = false;
+    }
+    // As with TIniFileStorage::Flush, "access denied" errors upon implicit saves to existing file are ignored
+    // (e.g. a portable configuration on a read-only share)
+    else if (Explicit || !Exists || (Error != ERROR_ACCESS_DENIED))
+    {
+      throw EOSExtException(FMTLOAD((Exists ? WRITE_ERROR : CREATE_FILE_ERROR), (Storage)), Error);
+    }
+  }
+}
@@ -286,6 +286,19 @@ protected:
   virtual bool __fastcall GetTemporary();
 };
 //---------------------------------------------------------------------------
+class TBinaryFileStorage : public TCustomIniFileStorage
+{
+public:
+  static TBinaryFileStorage * __fastcall CreateFromPath(const UnicodeString & AStorage);
+  static bool __fastcall IsBinaryStorage(const UnicodeString & FileName);
+  virtual __fastcall ~TBinaryFileStorage();
+
+  virtual void __fastcall Flush();
+
+private:
+  __fastcall TBinaryFileStorage(const UnicodeString & AStorage, TCustomIniFile * IniFile);
+};
+//---------------------------------------------------------------------------
 UnicodeString __fastcall PuttyMungeStr(const UnicodeString & Str);
 AnsiString PuttyStr(const UnicodeString & Str);
 TIntMapping CreateIntMappingFromEnumNames(const UnicodeString & Names);
@@ -1632,4 +1632,71 @@ void done_with_socket(SOCKET)
   // noop (no callbacks queued by our code)
 }
 //---------------------------------------------------------------------------
+TZlibStream::TZlibStream(bool Compress, int Level) :
+  FCompressor(NULL),
+  FDecompressor(NULL)
+{
+  if (Compress)
+  {
+    FCompressor = ssh_compressor_new_level(&ssh_zlib, Level);
+  }
+  else
+  {
+    FDecompressor = ssh_decompressor_new(&ssh_zlib);
+  }
+}
+//---------------------------------------------------------------------------
+TZlibStream::~TZlibStream()
+{
+  if (FCompressor != NULL)
+  {
+    ssh_compressor_free(FCompressor);
+  }
+  if (FDecompressor != NULL)
+  {
+    ssh_decompressor_free(FDecompressor);
+  }
+}
+//---------------------------------------------------------------------------
+bool TZlibStream::Process(const char * Data, size_t Len, RawByteString & Output)
+{
+  unsigned char * Block = NULL;
+  int BlockLen = 0;
+  const unsigned char * Input = reinterpret_cast<const unsigned char *>(Data);
+  bool Result;
+  if (FCompressor != NULL)
+  {
+    ssh_compressor_compress(FCompressor, Input, SizeToIntChecked(Len), &Block, &BlockLen, 0);
+    Result = true;
+  }
+  else
+  {
+    Result = ssh_decompressor_decompress(FDecompressor, Input, SizeToIntChecked(Len), &Block, &BlockLen);
+  }
+  if (Result)
+  {
+    Output = RawByteString(reinterpret_cast<char *>(Block), BlockLen);
+  }
+  sfree(Block);
+  return Result;
+}
+//---------------------------------------------------------------------------
+void TZlibStream::Finish(RawByteString & Output)
+{
+  Output = RawByteString();
+  if (DebugAlwaysTrue(FCompressor != NULL))
+  {
+    unsigned char * Block = NULL;
+    int BlockLen = 0;
+    zlib_compress_finish(FCompressor, &Block, &BlockLen);
+    Output = RawByteString(reinterpret_cast<char *>(Block), BlockLen);
+    sfree(Block);
+  }
+}
+//---------------------------------------------------------------------------
+bool TZlibStream::IsComplete()
+{
+  return DebugAlwaysTrue(FDecompressor != NULL) && zlib_decompress_finished(FDecompressor);
+}
+//---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
@@ -60,4 +60,21 @@ void SavePuttyDefaults(const UnicodeString & Name);
 //---------------------------------------------------------------------------
 bool RandomSeedExists();
 //---------------------------------------------------------------------------
+struct ssh_compressor;
+struct ssh_decompressor;
+class TZlibStream
+{
+public:
+  TZlibStream(bool Compress, int Level = 0);
+  ~TZlibStream();
+
+  bool Process(const char * Data, size_t Len, RawByteString & Output);
+  void Finish(RawByteString & Output);
+  bool IsComplete();
+
+private:
+  ssh_compressor * FCompressor;
+  ssh_decompressor * FDecompressor;
+};
+//---------------------------------------------------------------------------
 #endif
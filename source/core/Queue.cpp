@@ -14,6 +14,7 @@ public:
 
 protected:
   virtual void __fastcall DoExecute(TTerminal * Terminal);
+  virtual bool ConnectionFailed();
 
 private:
   TParallelOperation * FParallelOperation;
@@ -234,6 +235,7 @@ public:
   virtual __fastcall ~TTerminalItem();
 
   void __fastcall Process(TQueueItem * Item);
+  void Warm();
   bool __fastcall ProcessUserAction(void * Arg);
   void __fastcall Cancel();
   void __fastcall Idle();
@@ -249,9 +251,11 @@ protected:
   TUserAction * FUserAction;
   bool FCancel;
   bool FPause;
+  bool FWarming;
 
   virtual void __fastcall ProcessEvent();
   virtual bool __fastcall Finished();
+  void ProcessWarm();
   bool __fastcall WaitForUserAction(TQueueItem::TStatus ItemStatus, TUserAction * UserAction);
   bool __fastcall OverrideItemStatus(TQueueItem::TStatus & ItemStatus);
 
@@ -424,6 +428,116 @@ void __fastcall TSignalThread::Terminate()
   TriggerEvent();
 }
 //---------------------------------------------------------------------------
+TTransferPipe::TTransferPipe(size_t Capacity) :
+  FBuffer(Capacity)
+{
+  FSection.reset(new TCriticalSection());
+  FDataEvent = CreateEvent(NULL, false, false, NULL);
+  FSpaceEvent = CreateEvent(NULL, false, false, NULL);
+  FStart = 0;
+  FCount = 0;
+  FWriteClosed = false;
+  FWriteFailed = false;
+  FReadClosed = false;
+}
+//---------------------------------------------------------------------------
+TTransferPipe::~TTransferPipe()
+{
+  CloseHandle(FDataEvent);
+  CloseHandle(FSpaceEvent);
+}
+//---------------------------------------------------------------------------
+void __fastcall TTransferPipe::Write(TObject *, const unsigned char * Data, size_t Len)
+{
+  size_t Capacity = FBuffer.size();
+  size_t Offset = 0;
+  while (Offset < Len)
+  {
+    bool Wait;
+    {
+      TGuard Guard(FSection.get());
+      if (FReadClosed)
+      {
+        // The reading side failed, stop the writing side
+        Abort();
+      }
+      size_t Space = Capacity - FCount;
+      Wait = (Space == 0);
+      if (!Wait)
+      {
+        size_t Chunk = std::min(Space, Len - Offset);
+        size_t End = (FStart + FCount) % Capacity;
+        size_t First = std::min(Chunk, Capacity - End);
+        memcpy(&FBuffer[End], Data + Offset, First);
+        memcpy(&FBuffer[0], Data + Offset + First, Chunk - First);
+        FCount += Chunk;
+        Offset += Chunk;
+        SetEvent(FDataEvent);
+      }
+    }
+    if (Wait)
+    {
+      WaitForSingleObject(FSpaceEvent, INFINITE);
+    }
+  }
+}
+//---------------------------------------------------------------------------
+size_t __fastcall TTransferPipe::Read(TObject *, unsigned char * Data, size_t Len)
+{
+  size_t Capacity = FBuffer.size();
+  size_t Result = 0;
+  bool Eof = false;
+  while ((Result < Len) && !Eof)
+  {
+    bool Wait;
+    {
+      TGuard Guard(FSection.get());
+      Wait = (FCount == 0);
+      if (!Wait)
+      {
+        size_t Chunk = std::min(FCount, Len - Result);
+        size_t First = std::min(Chunk, Capacity - FStart);
+        memcpy(Data + Result, &FBuffer[FStart], First);
+        memcpy(Data + Result + First, &FBuffer[0], Chunk - First);
+        FStart = (FStart + Chunk) % Capacity;
+        FCount -= Chunk;
+        Result += Chunk;
+        SetEvent(FSpaceEvent);
+      }
+      else if (FWriteClosed)
+      {
+        if (FWriteFailed)
+        {
+          // The writing side failed, do not let the reading side complete with partial data
+          Abort();
+        }
+        Wait = false;
+        Eof = true;
+      }
+    }
+    if (Wait)
+    {
+      WaitForSingleObject(FDataEvent, INFINITE);
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+void TTransferPipe::CloseWrite(bool Failed)
+{
+  TGuard Guard(FSection.get());
+  FWriteClosed = true;
+  FWriteFailed = Failed;
+  SetEvent(FDataEvent);
+}
+//---------------------------------------------------------------------------
+void TTransferPipe::CloseRead()
+{
+  TGuard Guard(FSection.get());
+  FReadClosed = true;
+  SetEvent(FSpaceEvent);
+}
+//---------------------------------------------------------------------------
 // TTerminalQueue
 //---------------------------------------------------------------------------
 __fastcall TTerminalQueue::TTerminalQueue(TTerminal * Terminal,
@@ -440,6 +554,8 @@ __fastcall TTerminalQueue::TTerminalQueue(TTerminal * Terminal,
   FOnEvent = NULL;
   FLastIdle = Now();
   FIdleInterval = EncodeTimeVerbose(0, 0, 2, 0);
+  FWarmingTerminals = 0;
+  FWarmingFailed = false;
 
   DebugAssert(Terminal != NULL);
   FSessionData = new TSessionData(L"");
@@ -1075,6 +1191,44 @@ void __fastcall TTerminalQueue::ProcessEvent()
     }
   }
   while (!FTerminated && (TerminalItem != NULL));
+
+  if (!FTerminated)
+  {
+    WarmTerminals();
+  }
+}
+//---------------------------------------------------------------------------
+void TTerminalQueue::WarmTerminals()
+{
+  TTerminalItem * TerminalItem = NULL;
+
+  {
+    TGuard Guard(FItemsSection);
+
+    int WarmConnections = FConfiguration->QueueWarmConnections;
+    if ((FTransfersLimit >= 0) && (WarmConnections > FTransfersLimit))
+    {
+      WarmConnections = FTransfersLimit;
+    }
+
+    // Only idle connections count, the ones busy with items will not be ready for the next item.
+    // Warming connections are not free yet, so they are counted separately.
+    // We open one more on each event, until we have enough of them.
+    if (FEnabled && !FWarmingFailed &&
+        (FFreeTerminals + FWarmingTerminals < WarmConnections) &&
+        ((FTransfersLimit < 0) || (FTerminals->Count < FTransfersLimit + FTemporaryTerminals)))
+    {
+      FOverallTerminals++;
+      TerminalItem = new TTerminalItem(this, FOverallTerminals);
+      FTerminals->Add(TerminalItem);
+      FWarmingTerminals++;
+    }
+  }
+
+  if (TerminalItem != NULL)
+  {
+    TerminalItem->Warm();
+  }
 }
 //---------------------------------------------------------------------------
 void __fastcall TTerminalQueue::DoQueueItemUpdate(TQueueItem * Item)
@@ -1231,7 +1385,7 @@ bool __fastcall TBackgroundTerminal::DoQueryReopen(Exception *)
 //---------------------------------------------------------------------------
 __fastcall TTerminalItem::TTerminalItem(TTerminalQueue * Queue, int Index) :
   TSignalThread(true), FQueue(Queue), FTerminal(NULL), FItem(NULL),
-  FCriticalSection(NULL), FUserAction(NULL)
+  FCriticalSection(NULL), FUserAction(NULL), FWarming(false)
 {
   FCriticalSection = new TCriticalSection();
 
@@ -1277,10 +1431,62 @@ void __fastcall TTerminalItem::Process(TQueueItem * Item)
   TriggerEvent();
 }
 //---------------------------------------------------------------------------
+void TTerminalItem::Warm()
+{
+  {
+    TGuard Guard(FCriticalSection);
+
+    DebugAssert(FItem == NULL);
+    FWarming = true;
+  }
+
+  TriggerEvent();
+}
+//---------------------------------------------------------------------------
+void TTerminalItem::ProcessWarm()
+{
+  // Called with FCriticalSection acquired.
+  // Open the connection ahead, so that it is ready for the next queue item.
+  // There's no item to present any prompt with, so this works only
+  // when the connection can reuse the credentials of the main session.
+  bool Failed = false;
+  try
+  {
+    FTerminal->Open();
+  }
+  catch(Exception & E)
+  {
+    FTerminal->LogEvent(FORMAT(L"Warming up a background connection failed, not trying until a connection succeeds: %s", (E.Message)));
+    Failed = true;
+  }
+  FWarming = false;
+
+  {
+    TGuard Guard(FQueue->FItemsSection);
+    FQueue->FWarmingTerminals--;
+    if (Failed)
+    {
+      FQueue->FWarmingFailed = true;
+    }
+  }
+
+  if (!FTerminal->Active ||
+      !FQueue->TerminalFree(this))
+  {
+    Terminate();
+  }
+}
+//---------------------------------------------------------------------------
 void __fastcall TTerminalItem::ProcessEvent()
 {
   TGuard Guard(FCriticalSection);
 
+  if (FWarming)
+  {
+    ProcessWarm();
+    return;
+  }
+
   bool Retry = true;
 
   FCancel = false;
@@ -1297,6 +1503,10 @@ void __fastcall TTerminalItem::ProcessEvent()
 
       FTerminal->SessionData->RemoteDirectory = FItem->StartupDirectory();
       FTerminal->Open();
+
+      // The connection works again (possibly after the user was prompted), so warming can be retried
+      TGuard Guard(FQueue->FItemsSection);
+      FQueue->FWarmingFailed = false;
     }
 
     Retry = false;
@@ -1313,7 +1523,14 @@ void __fastcall TTerminalItem::ProcessEvent()
   catch(Exception & E)
   {
     UnicodeString Message;
-    if (ExceptionMessageFormatted(&E, Message))
+    // Retry is still set, when the connection has failed
+    if (Retry && !FCancel && !FTerminal->Active && FItem->ConnectionFailed())
+    {
+      FTerminal->LogEvent(FORMAT(L"Giving up on the item, as the connection has failed: %s", (E.Message)));
+      Retry = false;
+      FCancel = true;
+    }
+    else if (ExceptionMessageFormatted(&E, Message))
     {
       // do not show error messages, if task was canceled anyway
       // (for example if transfer is canceled during reconnection attempts)
@@ -1498,8 +1715,8 @@ void __fastcall TTerminalItem::TerminalPromptUser(TTerminal * Terminal,
 {
   if (FItem == NULL)
   {
-    // sanity, should not occur
-    DebugFail();
+    // can happen only when warming up the connection (ProcessWarm)
+    DebugAssert(FWarming);
     Result = false;
   }
   else
@@ -1729,6 +1946,12 @@ bool __fastcall TQueueItem::UpdateFileList(TQueueFileList *)
   return false;
 }
 //---------------------------------------------------------------------------
+bool TQueueItem::ConnectionFailed()
+{
+  // Report the error and retry
+  return false;
+}
+//---------------------------------------------------------------------------
 bool TQueueItem::IsExecutionCancelled()
 {
   return DebugAlwaysTrue(FTerminalItem != NULL) ? FTerminalItem->IsCancelled() : true;
@@ -2153,6 +2376,11 @@ __fastcall TTransferQueueItem::TTransferQueueItem(TTerminal * Terminal,
 
   FParallel = Parallel;
   FLastParallelOperationAdded = GetTickCount();
+  FAutoscale = false;
+  FAutoscaleConnections = 1;
+  FAutoscaleBestConnections = 0;
+  FAutoscaleCPS = 0;
+  FAutoscaleSettled = false;
 
 }
 //---------------------------------------------------------------------------
@@ -2180,6 +2408,19 @@ void __fastcall TTransferQueueItem::DoExecute(TTerminal * Terminal)
 
   DebugAssert(Terminal != NULL);
   FParallelOperation.reset(new TParallelOperation(FInfo->Side));
+  UnicodeString SessionKey = Terminal->SessionData->SessionKey;
+  {
+    TGuard Guard(FSection);
+    FAutoscale = FParallel && Terminal->Configuration->QueueTransfersAutoscale;
+    if (FAutoscale)
+    {
+      FAutoscaleBestConnections = Terminal->Configuration->LastParallelConnections(SessionKey);
+      if (FAutoscaleBestConnections > 1)
+      {
+        Terminal->LogEvent(FORMAT(L"Will open up to %d connections right away, as that performed best previously.", (FAutoscaleBestConnections)));
+      }
+    }
+  }
   try
   {
     DoTransferExecute(Terminal, FParallelOperation.get());
@@ -2187,9 +2428,70 @@ void __fastcall TTransferQueueItem::DoExecute(TTerminal * Terminal)
   __finally
   {
     FParallelOperation->WaitFor();
+
+    int Connections = 0;
+    {
+      TGuard Guard(FSection);
+      // Remember only, if we have actually tried
+      if (FAutoscale && FAutoscaleSettled)
+      {
+        Connections = FAutoscaleConnections;
+      }
+    }
+    if (Connections > 0)
+    {
+      Terminal->LogEvent(FORMAT(L"Best throughput was achieved with %d connections.", (Connections)));
+      Terminal->Configuration->RememberParallelConnections(SessionKey, Connections);
+    }
   }
 }
 //---------------------------------------------------------------------------
+// Called with FSection acquired, when adding a parallel connection is considered
+bool TTransferQueueItem::Autoscale(DWORD Now, bool & Force)
+{
+  bool Result;
+  if (FAutoscaleSettled)
+  {
+    Result = false;
+  }
+  else if (FAutoscaleConnections < FAutoscaleBestConnections)
+  {
+    // Ramp up to what worked before without measuring
+    Result = true;
+    Force = true;
+    FAutoscaleCPS = FProgressData->CPS();
+  }
+  else if (Now - FLastParallelOperationAdded < 5*1000)
+  {
+    // Let the throughput of the last added connection show
+    Result = false;
+  }
+  else
+  {
+    unsigned int CPS = FProgressData->CPS();
+    // The last added connection has not improved the throughput by at least 10%
+    // (or it has not even managed to connect)
+    if ((FAutoscaleConnections > 1) &&
+        (static_cast<__int64>(CPS) * 100 < static_cast<__int64>(FAutoscaleCPS) * 110))
+    {
+      FAutoscaleSettled = true;
+      Result = false;
+      if (CPS < FAutoscaleCPS)
+      {
+        // It even made things worse
+        FParallelOperation->DropClient();
+        FAutoscaleConnections--;
+      }
+    }
+    else
+    {
+      Result = true;
+      FAutoscaleCPS = CPS;
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
 void __fastcall TTransferQueueItem::ProgressUpdated()
 {
   TLocatedQueueItem::ProgressUpdated();
@@ -2211,12 +2513,19 @@ void __fastcall TTransferQueueItem::ProgressUpdated()
         if (FProgressData->Operation == foCopy)
         {
           Add = FParallelOperation->ShouldAddClient();
+          DWORD Now = GetTickCount();
           if (Add)
           {
-            DWORD Now = GetTickCount();
             Force =
               (Now - FLastParallelOperationAdded >= 5*1000) &&
               (TimeToSeconds(FProgressData->TotalTimeLeft()) >= FQueue->ParallelDurationThreshold);
+            if (FAutoscale)
+            {
+              Add = Autoscale(Now, Force);
+            }
+          }
+          if (Add)
+          {
             LastParallelOperationAddedPrev = FLastParallelOperationAdded;
             // update now already to prevent race condition, but we will have to rollback it back,
             // if we actually do not add the parallel operation
@@ -2233,6 +2542,11 @@ void __fastcall TTransferQueueItem::ProgressUpdated()
         TGuard Guard(FSection);
         FLastParallelOperationAdded = LastParallelOperationAddedPrev;
       }
+      else
+      {
+        TGuard Guard(FSection);
+        FAutoscaleConnections++;
+      }
     }
   }
 }
@@ -2341,6 +2655,14 @@ __fastcall TParallelTransferQueueItem::TParallelTransferQueueItem(
   FInfo->GroupToken = ParentItem->FInfo->GroupToken;
 }
 //---------------------------------------------------------------------------
+bool TParallelTransferQueueItem::ConnectionFailed()
+{
+  // Typically the server does not allow that many connections/logins.
+  // Do not bother the user, the main transfer and the connections
+  // that we have already can complete the work.
+  return FParallelOperation->ClientConnectionFailed();
+}
+//---------------------------------------------------------------------------
 void __fastcall TParallelTransferQueueItem::DoExecute(TTerminal * Terminal)
 {
   TLocatedQueueItem::DoExecute(Terminal);
@@ -2360,6 +2682,7 @@ void __fastcall TParallelTransferQueueItem::DoExecute(TTerminal * Terminal)
     bool Continue = true;
     do
     {
+      int ChangeVersion = FParallelOperation->GetChangeVersion();
       int GotNext = Terminal->CopyToParallel(FParallelOperation, &OperationProgress);
       if (GotNext < 0)
       {
@@ -2369,6 +2692,17 @@ void __fastcall TParallelTransferQueueItem::DoExecute(TTerminal * Terminal)
       {
         Continue = false;
       }
+      // Autoscaling has found this connection not to be beneficial
+      else if (FParallelOperation->ShouldDropClient())
+      {
+        Terminal->LogEvent(L"Closing parallel transfer connection, as it does not improve throughput.");
+        Continue = false;
+      }
+      else if (GotNext == 0)
+      {
+        // Do not spin while waiting for a parent directory to be created by another connection
+        FParallelOperation->WaitForChange(ChangeVersion, 100);
+      }
     }
     while (Continue);
   }
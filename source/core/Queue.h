@@ -48,6 +48,33 @@ protected:
   virtual void __fastcall ProcessEvent() = 0;
 };
 //---------------------------------------------------------------------------
+// Bounded in-memory pipe between OnTransferOut of a download
+// and OnTransferIn of an upload running in another thread.
+// Writes block while the pipe is full, reads block until the requested length is available
+// (a shorter read means the end of the data, as the filesystems expect).
+class TTransferPipe
+{
+public:
+  TTransferPipe(size_t Capacity);
+  ~TTransferPipe();
+
+  void __fastcall Write(TObject * Sender, const unsigned char * Data, size_t Len);
+  size_t __fastcall Read(TObject * Sender, unsigned char * Data, size_t Len);
+  void CloseWrite(bool Failed);
+  void CloseRead();
+
+private:
+  std::unique_ptr<TCriticalSection> FSection;
+  HANDLE FDataEvent;
+  HANDLE FSpaceEvent;
+  std::vector<unsigned char> FBuffer;
+  size_t FStart;
+  size_t FCount;
+  bool FWriteClosed;
+  bool FWriteFailed;
+  bool FReadClosed;
+};
+//---------------------------------------------------------------------------
 class TTerminal;
 class TQueueItem;
 class TTerminalQueue;
@@ -120,6 +147,8 @@ protected:
   bool FEnabled;
   TDateTime FIdleInterval;
   TDateTime FLastIdle;
+  int FWarmingTerminals;
+  bool FWarmingFailed;
 
   inline static TQueueItem * __fastcall GetItem(TList * List, int Index);
   inline TQueueItem * __fastcall GetItem(int Index);
@@ -142,6 +171,7 @@ protected:
   virtual void __fastcall ProcessEvent();
   void __fastcall TerminalFinished(TTerminalItem * TerminalItem);
   bool __fastcall TerminalFree(TTerminalItem * TerminalItem);
+  void WarmTerminals();
   int __fastcall GetParallelDurationThreshold();
 
   void __fastcall DoQueueItemUpdate(TQueueItem * Item);
@@ -213,6 +243,7 @@ protected:
   virtual void __fastcall ProgressUpdated();
   virtual TQueueItem * __fastcall CreateParallelOperation();
   virtual bool __fastcall Complete();
+  virtual bool ConnectionFailed();
   bool IsExecutionCancelled();
 };
 //---------------------------------------------------------------------------
@@ -346,6 +377,11 @@ protected:
   bool FParallel;
   DWORD FLastParallelOperationAdded;
   std::unique_ptr<TParallelOperation> FParallelOperation;
+  bool FAutoscale;
+  int FAutoscaleConnections;
+  int FAutoscaleBestConnections;
+  unsigned int FAutoscaleCPS;
+  bool FAutoscaleSettled;
 
   virtual unsigned long __fastcall DefaultCPSLimit();
   virtual void __fastcall DoExecute(TTerminal * Terminal);
@@ -353,6 +389,7 @@ protected:
   virtual void __fastcall ProgressUpdated();
   virtual TQueueItem * __fastcall CreateParallelOperation();
   virtual bool __fastcall UpdateFileList(TQueueFileList * FileList);
+  bool Autoscale(DWORD Now, bool & Force);
 };
 //---------------------------------------------------------------------------
 class TUploadQueueItem : public TTransferQueueItem
@@ -443,6 +443,9 @@ UnicodeString S3EnvRoleArn(const UnicodeString & Profile, UnicodeString * Source
 //---------------------------------------------------------------------------
 const int TS3FileSystem::S3MinMultiPartChunkSize = 5 * 1024 * 1024;
 const int TS3FileSystem::S3MaxMultiPartChunks = 10000;
+// Limit of a single CopyObject request, larger objects have to be copied by parts
+const __int64 TS3FileSystem::S3MaxCopyObjectSize = 5LL * 1024 * 1024 * 1024;
+const __int64 TS3FileSystem::S3MinMultiPartCopyChunkSize = 512LL * 1024 * 1024;
 //---------------------------------------------------------------------------
 TS3FileSystem::TS3FileSystem(TTerminal * ATerminal) :
   TCustomFileSystem(ATerminal),
@@ -1718,6 +1721,13 @@ void __fastcall TS3FileSystem::CopyFile(
     throw Exception(LoadStr(MISSING_TARGET_BUCKET));
   }
 
+  // Objects over 5 GB cannot be copied by a single request (we would have to fall back to download+upload otherwise)
+  if ((File != NULL) && (File->Size > S3MaxCopyObjectSize))
+  {
+    CopyObjectMultipart(SourceBucketName, SourceKey, DestBucketName, DestKey, File->Size);
+    return;
+  }
+
   TLibS3BucketContext BucketContext = GetBucketContext(DestBucketName, DestKey);
   BucketContext.BucketNameBuf = SourceBucketName;
   BucketContext.bucketName = BucketContext.BucketNameBuf.c_str();
@@ -2661,6 +2671,112 @@ void __fastcall TS3FileSystem::Source(
   }
 }
 //---------------------------------------------------------------------------
+void TS3FileSystem::CopyObjectMultipart(
+  const UnicodeString & SourceBucketName, const UnicodeString & SourceKey,
+  const UnicodeString & DestBucketName, const UnicodeString & DestKey, __int64 Size)
+{
+  TLibS3BucketContext DestBucketContext = GetBucketContext(DestBucketName, DestKey);
+  // Copy requests are sent to the destination bucket, with the source bucket in the bucket context
+  TLibS3BucketContext SourceBucketContext = GetBucketContext(DestBucketName, DestKey);
+  SourceBucketContext.BucketNameBuf = SourceBucketName;
+  SourceBucketContext.bucketName = SourceBucketContext.BucketNameBuf.c_str();
+
+  __int64 ChunkSize =
+    std::max(S3MinMultiPartCopyChunkSize, (Size + S3MaxMultiPartChunks - 1) / S3MaxMultiPartChunks);
+  int Parts = static_cast<int>((Size + ChunkSize - 1) / ChunkSize);
+
+  FTerminal->LogEvent(FORMAT(L"Initiating multipart copy (%d parts - chunk size %s)", (Parts, IntToStr(ChunkSize))));
+
+  RawByteString MultipartUploadId;
+  {
+    TLibS3MultipartInitialCallbackData Data;
+    RequestInit(Data);
+
+    S3MultipartInitialHandler Handler = { CreateResponseHandler(), &LibS3MultipartInitialCallback };
+
+    S3_initiate_multipart(&DestBucketContext, StrToS3(DestKey), NULL, &Handler, FRequestContext, FTimeout, &Data);
+
+    CheckLibS3Error(Data);
+
+    MultipartUploadId = Data.UploadId;
+  }
+
+  try
+  {
+    TLibS3MultipartCommitPutObjectDataCallbackData MultipartCommitPutObjectDataCallbackData;
+    MultipartCommitPutObjectDataCallbackData.Message += "<CompleteMultipartUpload>\n";
+
+    for (int Part = 1; Part <= Parts; Part++)
+    {
+      TFileOperationProgressType * OperationProgress = FTerminal->OperationProgress;
+      if ((OperationProgress != NULL) && (OperationProgress->Cancel != csContinue))
+      {
+        Abort();
+      }
+
+      __int64 Offset = static_cast<__int64>(Part - 1) * ChunkSize;
+      __int64 PartLength = std::min(ChunkSize, Size - Offset);
+      FTerminal->LogEvent(FORMAT(L"Copying part %d [%s]", (Part, IntToStr(PartLength))));
+
+      TLibS3CallbackData Data;
+      RequestInit(Data);
+
+      S3ResponseHandler ResponseHandler = CreateResponseHandler();
+
+      char ETag[256];
+      S3_copy_object_range(
+        &SourceBucketContext, StrToS3(SourceKey), StrToS3(DestBucketName), StrToS3(DestKey),
+        Part, MultipartUploadId.c_str(), Offset, PartLength,
+        NULL, NULL, sizeof(ETag), ETag, FRequestContext, FTimeout, &ResponseHandler, &Data);
+
+      CheckLibS3Error(Data);
+
+      RawByteString PartCommitTag =
+        RawByteString::Format("  <Part><PartNumber>%d</PartNumber><ETag>%s</ETag></Part>\n", ARRAYOFCONST((Part, ETag)));
+      MultipartCommitPutObjectDataCallbackData.Message += PartCommitTag;
+    }
+
+    MultipartCommitPutObjectDataCallbackData.Message += "</CompleteMultipartUpload>\n";
+
+    FTerminal->LogEvent(FORMAT(L"Committing multipart copy (%s - %d parts)", (UnicodeString(MultipartUploadId), Parts)));
+
+    RequestInit(MultipartCommitPutObjectDataCallbackData);
+    MultipartCommitPutObjectDataCallbackData.Remaining = MultipartCommitPutObjectDataCallbackData.Message.Length();
+
+    S3MultipartCommitHandler MultipartCommitHandler =
+      { CreateResponseHandler(), &LibS3MultipartCommitPutObjectDataCallback, NULL };
+
+    S3_complete_multipart_upload(
+      &DestBucketContext, StrToS3(DestKey), &MultipartCommitHandler, MultipartUploadId.c_str(),
+      MultipartCommitPutObjectDataCallbackData.Remaining,
+      FRequestContext, FTimeout, &MultipartCommitPutObjectDataCallbackData);
+
+    CheckLibS3Error(MultipartCommitPutObjectDataCallbackData);
+  }
+  catch (Exception &)
+  {
+    FTerminal->LogEvent(FORMAT(L"Aborting multipart copy (%s - %d parts)", (UnicodeString(MultipartUploadId), Parts)));
+
+    try
+    {
+      TLibS3CallbackData Data;
+      RequestInit(Data);
+
+      S3AbortMultipartUploadHandler AbortMultipartUploadHandler = { CreateResponseHandler() };
+
+      S3_abort_multipart_upload(
+        &DestBucketContext, StrToS3(DestKey), MultipartUploadId.c_str(),
+        FTimeout, &AbortMultipartUploadHandler, FRequestContext, &Data);
+    }
+    catch (...)
+    {
+      // swallow
+    }
+
+    throw;
+  }
+}
+//---------------------------------------------------------------------------
 void __fastcall TS3FileSystem::CopyToLocal(
   TStrings * FilesToCopy, const UnicodeString TargetDir, const TCopyParamType * CopyParam,
   int Params, TFileOperationProgressType * OperationProgress, TOnceDoneOperation & OnceDoneOperation)
@@ -172,6 +172,9 @@ protected:
     const UnicodeString & Path, const TRemoteFile * File, UnicodeString & BucketName, UnicodeString & Key);
   void AssumeRole(const UnicodeString & RoleArn);
   void SetCredentials(const UnicodeString & AccessKeyId, const UnicodeString & SecretAccessKey, const UnicodeString & SessionToken);
+  void CopyObjectMultipart(
+    const UnicodeString & SourceBucketName, const UnicodeString & SourceKey,
+    const UnicodeString & DestBucketName, const UnicodeString & DestKey, __int64 Size);
 
   static TS3FileSystem * GetFileSystem(void * CallbackData);
   static void LibS3SessionCallback(ne_session_s * Session, void * CallbackData);
@@ -195,6 +198,8 @@ protected:
 
   static const int S3MinMultiPartChunkSize;
   static const int S3MaxMultiPartChunks;
+  static const __int64 S3MaxCopyObjectSize;
+  static const __int64 S3MinMultiPartCopyChunkSize;
 };
 //------------------------------------------------------------------------------
 UnicodeString __fastcall S3LibVersion();
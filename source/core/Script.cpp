@@ -5,9 +5,11 @@
 #include "Script.h"
 #include "Terminal.h"
 #include "SessionData.h"
+#include "Queue.h"
 //---------------------------------------------------------------------------
 const wchar_t * ToggleNames[] = { L"off", L"on" };
 const UnicodeString InOutParam(TraceInitStr(L"-"));
+const size_t StreamCopyPipeCapacity = 4 * 1024 * 1024;
 //---------------------------------------------------------------------------
 __fastcall TScriptProcParams::TScriptProcParams(const UnicodeString & FullCommand, const UnicodeString & ParamsStr)
 {
@@ -347,13 +349,13 @@ void __fastcall TScript::Init()
   FCommands->Register(L"!", 0, SCRIPT_CALL_HELP2, &CallProc, 1, -1, true);
   FCommands->Register(L"pwd", SCRIPT_PWD_DESC, SCRIPT_PWD_HELP, &PwdProc, 0, 0, false);
   FCommands->Register(L"cd", SCRIPT_CD_DESC, SCRIPT_CD_HELP, &CdProc, 0, 1, false);
-  FCommands->Register(L"ls", SCRIPT_LS_DESC, SCRIPT_LS_HELP2, &LsProc, 0, 1, false);
-  FCommands->Register(L"dir", 0, SCRIPT_LS_HELP2, &LsProc, 0, 1, false);
+  FCommands->Register(L"ls", SCRIPT_LS_DESC, SCRIPT_LS_HELP3, &LsProc, 0, 1, true);
+  FCommands->Register(L"dir", 0, SCRIPT_LS_HELP3, &LsProc, 0, 1, true);
   FCommands->Register(L"rm", SCRIPT_RM_DESC, SCRIPT_RM_HELP2, &RmProc, 1, -1, true);
   FCommands->Register(L"rmdir", SCRIPT_RMDIR_DESC, SCRIPT_RMDIR_HELP, &RmDirProc, 1, -1, false);
   FCommands->Register(L"mv", SCRIPT_MV_DESC, SCRIPT_MV_HELP2, &MvProc, 2, -1, false);
   FCommands->Register(L"rename", 0, SCRIPT_MV_HELP2, &MvProc, 2, -1, false);
-  FCommands->Register(L"cp", SCRIPT_CP_DESC, SCRIPT_CP_HELP, &CpProc, 2, -1, false);
+  FCommands->Register(L"cp", SCRIPT_CP_DESC, SCRIPT_CP_HELP2, &CpProc, 2, -1, false);
   FCommands->Register(L"chmod", SCRIPT_CHMOD_DESC, SCRIPT_CHMOD_HELP2, &ChModProc, 2, -1, false);
   FCommands->Register(L"ln", SCRIPT_LN_DESC, SCRIPT_LN_HELP, &LnProc, 2, 2, false);
   FCommands->Register(L"symlink", 0, SCRIPT_LN_HELP, &LnProc, 2, 2, false);
@@ -368,7 +370,7 @@ void __fastcall TScript::Init()
   FCommands->Register(L"ascii", 0, SCRIPT_OPTION_HELP7, &AsciiProc, 0, 0, false);
   FCommands->Register(L"binary", 0, SCRIPT_OPTION_HELP7, &BinaryProc, 0, 0, false);
   FCommands->Register(L"synchronize", SCRIPT_SYNCHRONIZE_DESC, SCRIPT_SYNCHRONIZE_HELP7, &SynchronizeProc, 0, -1, true);
-  FCommands->Register(L"keepuptodate", SCRIPT_KEEPUPTODATE_DESC, SCRIPT_KEEPUPTODATE_HELP5, &KeepUpToDateProc, 0, 2, true);
+  FCommands->Register(L"keepuptodate", SCRIPT_KEEPUPTODATE_DESC, SCRIPT_KEEPUPTODATE_HELP6, &KeepUpToDateProc, 0, 2, true);
   // the echo command does not have switches actually, but it must handle dashes in its arguments
   FCommands->Register(L"echo", SCRIPT_ECHO_DESC, SCRIPT_ECHO_HELP, &EchoProc, -1, -1, true);
   FCommands->Register(L"stat", SCRIPT_STAT_DESC, SCRIPT_STAT_HELP, &StatProc, 1, 1, false);
@@ -854,6 +856,12 @@ void __fastcall TScript::NoMatch(const UnicodeString & Mask, const UnicodeString
   NoMatch(Message);
 }
 //---------------------------------------------------------------------------
+TTerminal * __fastcall TScript::FindSession(const UnicodeString Index)
+{
+  // Only management script has more sessions
+  throw Exception(FMTLOAD(SCRIPT_SESSION_INDEX_INVALID, (Index)));
+}
+//---------------------------------------------------------------------------
 void __fastcall TScript::FreeFiles(TStrings * FileList)
 {
   for (int i = 0; i < FileList->Count; i++)
@@ -1275,10 +1283,109 @@ void __fastcall TScript::CdProc(TScriptProcParams * Parameters)
   PrintLine(FTerminal->CurrentDirectory);
 }
 //---------------------------------------------------------------------------
+static UnicodeString __fastcall JsonEscape(const UnicodeString & Str)
+{
+  UnicodeString Result;
+  for (int Index = 1; Index <= Str.Length(); Index++)
+  {
+    wchar_t Ch = Str[Index];
+    switch (Ch)
+    {
+      case L'"':
+        Result += L"\\\"";
+        break;
+
+      case L'\\':
+        Result += L"\\\\";
+        break;
+
+      case L'\n':
+        Result += L"\\n";
+        break;
+
+      case L'\r':
+        Result += L"\\r";
+        break;
+
+      case L'\t':
+        Result += L"\\t";
+        break;
+
+      default:
+        if (Ch < L' ')
+        {
+          Result += FORMAT(L"\\u%4.4x", (static_cast<int>(Ch)));
+        }
+        else
+        {
+          Result += Ch;
+        }
+        break;
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+static UnicodeString __fastcall JsonValue(const UnicodeString & Name, const UnicodeString & Value)
+{
+  return FORMAT(L",\"%s\":\"%s\"", (Name, JsonEscape(Value)));
+}
+//---------------------------------------------------------------------------
+// Same information as TSessionActionRecord::RecordFile logs to XML log
+static UnicodeString __fastcall RemoteFileJson(const UnicodeString & Directory, TRemoteFile * File)
+{
+  UnicodeString Result =
+    FORMAT(L"{\"path\":\"%s\"", (JsonEscape(UnixIncludeTrailingBackslash(Directory) + File->FileName)));
+  Result += JsonValue(L"type", towupper(File->Type));
+  if (!File->IsDirectory)
+  {
+    Result += FORMAT(L",\"size\":%s", (IntToStr(File->Size)));
+  }
+  if (File->ModificationFmt != mfNone)
+  {
+    Result += JsonValue(L"modification", StandardTimestamp(File->Modification));
+  }
+  if (!File->Rights->Unknown)
+  {
+    Result += JsonValue(L"permissions", File->Rights->Text);
+  }
+  if (File->Owner.IsSet)
+  {
+    Result += JsonValue(L"owner", File->Owner.DisplayText);
+  }
+  if (File->Group.IsSet)
+  {
+    Result += JsonValue(L"group", File->Group.DisplayText);
+  }
+  if (File->IsSymLink)
+  {
+    Result += JsonValue(L"linkto", File->LinkTo);
+  }
+  Result += L"}";
+  return Result;
+}
+//---------------------------------------------------------------------------
 void __fastcall TScript::LsProc(TScriptProcParams * Parameters)
 {
   CheckSession();
 
+  bool Json = false;
+  UnicodeString Value;
+  if (Parameters->FindSwitch(L"format", Value))
+  {
+    enum { Text, JsonFormat };
+    static const wchar_t * FormatNames[] = { L"text", L"json" };
+    int Format = TScriptCommands::FindCommand(FormatNames, std::size(FormatNames), Value);
+    if (Format < 0)
+    {
+      throw Exception(FMTLOAD(SCRIPT_VALUE_UNKNOWN, (Value, L"format")));
+    }
+    Json = (Format == JsonFormat);
+  }
+  bool Recursive = Parameters->FindSwitch(L"recursive");
+
+  CheckParams(Parameters);
+
   UnicodeString Directory;
   TFileMasks Mask;
   bool HaveMask = false;
@@ -1299,31 +1406,67 @@ void __fastcall TScript::LsProc(TScriptProcParams * Parameters)
     Directory = FTerminal->CurrentDirectory;
   }
 
-  TRemoteFileList * FileList = FTerminal->ReadDirectoryListing(Directory, Mask);
-  // on error user may select "skip", then we get NULL
-  if (FileList != NULL)
+  // Each directory listing is printed and released before the next one is read,
+  // only paths of directories still to be listed are kept.
+  // With recursion, the mask is applied to the entries, not to the subdirectories to descend to.
+  std::unique_ptr<TStrings> Directories(new TStringList());
+  Directories->Add(Directory);
+  bool Listed = false;
+  bool AnyFile = false;
+  while (Directories->Count > 0)
   {
-    try
+    int DirectoryIndex = Directories->Count - 1;
+    UnicodeString ADirectory = Directories->Strings[DirectoryIndex];
+    Directories->Delete(DirectoryIndex);
+
+    std::unique_ptr<TRemoteFileList> FileList(
+      FTerminal->ReadDirectoryListing(ADirectory, (Recursive ? TFileMasks() : Mask)));
+    // on error user may select "skip", then we get NULL
+    if (FileList.get() != NULL)
     {
-      if (FileList->Count > 0)
+      Listed = true;
+      UnicodeString FullDirectory = FTerminal->AbsolutePath(ADirectory, true);
+      if (Recursive && !Json && (ADirectory != Directory))
       {
-        for (int i = 0; i < FileList->Count; i++)
-        {
-          PrintLine(FileList->Files[i]->ListingStr);
-        }
+        PrintLine(UnicodeString());
+        PrintLine(FullDirectory + L":");
       }
-      else
+
+      int SubdirectoriesIndex = Directories->Count;
+      for (int i = 0; i < FileList->Count; i++)
       {
-        if (HaveMask)
+        TRemoteFile * File = FileList->Files[i];
+        bool ThisOrParent = File->IsParentDirectory || File->IsThisDirectory;
+        if (Recursive && File->IsDirectory && !ThisOrParent && !File->IsSymLink)
+        {
+          // pushed in reverse order, so that they are listed in the original order
+          Directories->Insert(SubdirectoriesIndex, UnixCombinePaths(FullDirectory, File->FileName));
+        }
+
+        bool Matches = true;
+        if (Recursive && HaveMask)
+        {
+          TFileMasks::TParams Params;
+          Params.Size = File->Resolve()->Size;
+          Params.Modification = File->Modification;
+          Matches = Mask.MatchesFileName(File->FileName, false, &Params);
+        }
+
+        // The . and .. entries are printed (in text format) for the listed directory only,
+        // not for each of its subdirectories
+        bool Skip = ThisOrParent && (Json || (ADirectory != Directory));
+        if (Matches && !Skip)
         {
-          NoMatch(Mask.Masks, UnicodeString());
+          PrintLine(Json ? RemoteFileJson(FullDirectory, File) : File->ListingStr);
+          AnyFile = true;
         }
       }
     }
-    __finally
-    {
-      delete FileList;
-    }
+  }
+
+  if (Listed && !AnyFile && HaveMask)
+  {
+    NoMatch(Mask.Masks, UnicodeString());
   }
 }
 //---------------------------------------------------------------------------
@@ -1402,9 +1545,191 @@ void __fastcall TScript::MvProc(TScriptProcParams * Parameters)
   DoMvOrCp(Parameters, fcRemoteMove, false);
 }
 //---------------------------------------------------------------------------
+// Uploads data streamed from a download in the script's thread
+class TStreamUploadThread : public TSimpleThread
+{
+public:
+  __fastcall TStreamUploadThread(
+    TTerminal * Terminal, TStrings * FileList, const UnicodeString & TargetDirectory,
+    const TCopyParamType & CopyParam, TTransferPipe * Pipe);
+  virtual __fastcall ~TStreamUploadThread();
+
+  virtual void __fastcall Terminate();
+  void __fastcall CheckResult();
+
+protected:
+  virtual void __fastcall Execute();
+
+private:
+  TTerminal * FTerminal;
+  TStrings * FFileList;
+  UnicodeString FTargetDirectory;
+  TCopyParamType FCopyParam;
+  TTransferPipe * FPipe;
+  bool FResult;
+  std::unique_ptr<Exception> FError;
+};
+//---------------------------------------------------------------------------
+__fastcall TStreamUploadThread::TStreamUploadThread(
+    TTerminal * Terminal, TStrings * FileList, const UnicodeString & TargetDirectory,
+    const TCopyParamType & CopyParam, TTransferPipe * Pipe) :
+  FTerminal(Terminal),
+  FFileList(FileList),
+  FTargetDirectory(TargetDirectory),
+  FCopyParam(CopyParam),
+  FPipe(Pipe),
+  FResult(false)
+{
+  Start();
+}
+//---------------------------------------------------------------------------
+__fastcall TStreamUploadThread::~TStreamUploadThread()
+{
+  Close();
+}
+//---------------------------------------------------------------------------
+void __fastcall TStreamUploadThread::Terminate()
+{
+  // noop, the upload ends when the pipe is closed
+}
+//---------------------------------------------------------------------------
+void __fastcall TStreamUploadThread::Execute()
+{
+  try
+  {
+    FResult = FTerminal->CopyToRemote(FFileList, FTargetDirectory, &FCopyParam, cpNoConfirmation, NULL);
+  }
+  catch (Exception & E)
+  {
+    FError.reset(CloneException(&E));
+  }
+  // If the upload ended prematurely, this stops the download
+  FPipe->CloseRead();
+}
+//---------------------------------------------------------------------------
+void __fastcall TStreamUploadThread::CheckResult()
+{
+  if (FError.get() != NULL)
+  {
+    RethrowException(FError.get());
+  }
+  else if (!FResult)
+  {
+    Abort();
+  }
+}
+//---------------------------------------------------------------------------
+// Copies a file to another open session, streaming the data through a bounded in-memory pipe,
+// with the upload running in a separate thread.
+void __fastcall TScript::CopyToSession(TScriptProcParams * Parameters, TTerminal * TargetTerminal)
+{
+  CheckSession();
+  ResetTransfer();
+
+  CheckDefaultCopyParam();
+  TCopyParamType CopyParam = FCopyParam;
+  CopyParamParams(CopyParam, Parameters);
+
+  if ((Parameters->ParamCount != 2) || (TargetTerminal == FTerminal))
+  {
+    throw Exception(LoadStr(STREAM_COPY_SCRIPT_ERROR));
+  }
+
+  TStrings * FileList =
+    CreateFileList(Parameters, 1, 1, TFileListType(fltQueryServer | fltMask | fltOnlyFile));
+  try
+  {
+    if (FileList->Count != 1)
+    {
+      throw Exception(LoadStr(STREAM_COPY_SCRIPT_ERROR));
+    }
+
+    UnicodeString Target = Parameters->Param[2];
+    UnicodeString TargetDirectory = UnixExtractFilePath(Target);
+    if (TargetDirectory.IsEmpty())
+    {
+      TargetDirectory = TargetTerminal->CurrentDirectory;
+    }
+    UnicodeString FileName = UnixExtractFileName(FileList->Strings[0]);
+    UnicodeString FileMask = UnixExtractFileName(Target);
+    if (!FileMask.IsEmpty())
+    {
+      FileName = MaskFileName(FileName, FileMask);
+    }
+
+    CheckParams(Parameters);
+
+    TTransferPipe Pipe(StreamCopyPipeCapacity);
+
+    TCopyParamType DownloadCopyParam = CopyParam;
+    DownloadCopyParam.OnTransferOut = Pipe.Write;
+
+    TCopyParamType UploadCopyParam = CopyParam;
+    UploadCopyParam.OnTransferIn = Pipe.Read;
+    UploadCopyParam.FileMask = FileName;
+    std::unique_ptr<TStrings> UploadFileList(new TStringList());
+    UploadFileList->Add(FileName);
+
+    // The script reports progress of the download only, the upload runs in other thread.
+    // None of the target session events can be safely called from that thread,
+    // so queries and prompts get aborted and the upload errors are reported via CheckResult.
+    TFileOperationProgressEvent TargetOnProgress = TargetTerminal->OnProgress;
+    TFileOperationFinished TargetOnFinished = TargetTerminal->OnFinished;
+    TQueryUserEvent TargetOnQueryUser = TargetTerminal->OnQueryUser;
+    TPromptUserEvent TargetOnPromptUser = TargetTerminal->OnPromptUser;
+    TExtendedExceptionEvent TargetOnShowExtendedException = TargetTerminal->OnShowExtendedException;
+    TInformationEvent TargetOnInformation = TargetTerminal->OnInformation;
+    TargetTerminal->OnProgress = NULL;
+    TargetTerminal->OnFinished = NULL;
+    TargetTerminal->OnQueryUser = NULL;
+    TargetTerminal->OnPromptUser = NULL;
+    TargetTerminal->OnShowExtendedException = NULL;
+    TargetTerminal->OnInformation = NULL;
+    try
+    {
+      TStreamUploadThread Thread(TargetTerminal, UploadFileList.get(), TargetDirectory, UploadCopyParam, &Pipe);
+      bool Result = false;
+      try
+      {
+        // A download error that is skipped (or ignored in batch mode) does not fail the operation
+        TFileOperationFailureMonitor Monitor(FTerminal);
+        Result = FTerminal->CopyToLocal(FileList, EmptyStr, &DownloadCopyParam, 0, NULL) && !Monitor.Failed;
+      }
+      __finally
+      {
+        // Lets the upload finish (or fail, if the download did not complete)
+        Pipe.CloseWrite(!Result);
+        Thread.WaitFor();
+      }
+      Thread.CheckResult();
+    }
+    __finally
+    {
+      TargetTerminal->OnProgress = TargetOnProgress;
+      TargetTerminal->OnFinished = TargetOnFinished;
+      TargetTerminal->OnQueryUser = TargetOnQueryUser;
+      TargetTerminal->OnPromptUser = TargetOnPromptUser;
+      TargetTerminal->OnShowExtendedException = TargetOnShowExtendedException;
+      TargetTerminal->OnInformation = TargetOnInformation;
+    }
+  }
+  __finally
+  {
+    FreeFileList(FileList);
+  }
+}
+//---------------------------------------------------------------------------
 void __fastcall TScript::CpProc(TScriptProcParams * Parameters)
 {
-  DoMvOrCp(Parameters, fcRemoteCopy, true);
+  UnicodeString TargetSession;
+  if (Parameters->FindSwitch(L"tosession", TargetSession))
+  {
+    CopyToSession(Parameters, FindSession(TargetSession));
+  }
+  else
+  {
+    DoMvOrCp(Parameters, fcRemoteCopy, true);
+  }
 }
 //---------------------------------------------------------------------------
 void __fastcall TScript::ChModProc(TScriptProcParams * Parameters)
@@ -2101,16 +2426,16 @@ void __fastcall TScript::SynchronizeProc(TScriptProcParams * Parameters)
 }
 //---------------------------------------------------------------------------
 void __fastcall TScript::Synchronize(const UnicodeString LocalDirectory,
-  const UnicodeString RemoteDirectory, const TCopyParamType & CopyParam,
-  int SynchronizeParams, TSynchronizeChecklist ** Checklist)
+  const UnicodeString RemoteDirectory, TTerminal::TSynchronizeMode Mode, const TCopyParamType & CopyParam,
+  int SynchronizeParams, TSynchronizeOptions * Options, TSynchronizeChecklist ** Checklist)
 {
   try
   {
     FKeepingUpToDate = true;
 
     TSynchronizeChecklist * AChecklist =
-      FTerminal->SynchronizeCollect(LocalDirectory, RemoteDirectory, TTerminal::smRemote,
-        &CopyParam, SynchronizeParams, NULL, NULL);
+      FTerminal->SynchronizeCollect(LocalDirectory, RemoteDirectory, Mode,
+        &CopyParam, SynchronizeParams, NULL, Options);
     try
     {
       if (AChecklist->Count > 0)
@@ -2173,12 +2498,19 @@ void __fastcall TScript::KeepUpToDateProc(TScriptProcParams * Parameters)
   {
     SynchronizeParams |= TTerminal::spDelete;
   }
+  bool RemoteChanges = Parameters->FindSwitch(L"twoway");
 
   CheckParams(Parameters);
 
+  // Without preserved timestamps, each transfer makes the file look changed on the other side
+  if (RemoteChanges && !CopyParam.PreserveTime)
+  {
+    throw Exception(LoadStr(KEEPUPTODATE_TWOWAY_PRESERVETIME));
+  }
+
   PrintLine(LoadStr(SCRIPT_KEEPING_UP_TO_DATE));
 
-  OnSynchronizeStartStop(this, LocalDirectory, RemoteDirectory, CopyParam, SynchronizeParams);
+  OnSynchronizeStartStop(this, LocalDirectory, RemoteDirectory, CopyParam, SynchronizeParams, RemoteChanges);
 }
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
@@ -29,7 +29,7 @@ public:
 typedef void __fastcall (__closure *TScriptPrintEvent)(TScript * Script, const UnicodeString Str, bool Error);
 typedef void __fastcall (__closure *TScriptSynchronizeStartStop)(TScript * Script,
   const UnicodeString LocalDirectory, const UnicodeString RemoteDirectory,
-  const TCopyParamType & CopyParam, int SynchronizeParams);
+  const TCopyParamType & CopyParam, int SynchronizeParams, bool RemoteChanges);
 typedef void __fastcall (__closure *TScriptProgressEvent)(TScript * Script, TScriptProgress & Progress);
 //---------------------------------------------------------------------------
 class TScriptProcParams : public TOptions
@@ -59,8 +59,8 @@ public:
   void __fastcall StartInteractive();
 
   void __fastcall Synchronize(const UnicodeString LocalDirectory,
-    const UnicodeString RemoteDirectory, const TCopyParamType & CopyParam,
-    int SynchronizeParams, TSynchronizeChecklist ** Checklist);
+    const UnicodeString RemoteDirectory, TTerminal::TSynchronizeMode Mode, const TCopyParamType & CopyParam,
+    int SynchronizeParams, TSynchronizeOptions * Options, TSynchronizeChecklist ** Checklist);
 
   static void __fastcall RequireParams(TScriptProcParams * Parameters, int MinParams);
 
@@ -180,6 +180,7 @@ protected:
   UnicodeString __fastcall ListingSysErrorMessage();
   void __fastcall NoMatch(const UnicodeString & Mask, const UnicodeString & Error);
   void __fastcall NoMatch(const UnicodeString & Message);
+  virtual TTerminal * __fastcall FindSession(const UnicodeString Index);
 
 private:
   void __fastcall Init();
@@ -193,6 +194,7 @@ private:
   void __fastcall CheckMultiFilesToOne(TStrings * FileList, const UnicodeString & Target, bool Unix);
   void __fastcall LogOption(const UnicodeString & LogStr);
   void __fastcall DoMvOrCp(TScriptProcParams * Parameters, TFSCapability Capability, bool Cp);
+  void __fastcall CopyToSession(TScriptProcParams * Parameters, TTerminal * TargetTerminal);
   void __fastcall DoCalculatedChecksum(
     const UnicodeString & FileName, const UnicodeString & Alg, const UnicodeString & Hash);
 };
@@ -245,7 +247,7 @@ protected:
     TOnceDoneOperation & OnceDoneOperation);
 
   void __fastcall PrintActiveSession();
-  TTerminal * __fastcall FindSession(const UnicodeString Index);
+  virtual TTerminal * __fastcall FindSession(const UnicodeString Index);
   void __fastcall FreeTerminal(TTerminal * Terminal);
   void __fastcall PrintProgress(bool First, const UnicodeString Str);
   bool __fastcall QueryCancel();
@@ -166,6 +166,7 @@ Conf * __fastcall TSecureShell::StoreToConfig(TSessionData * Data, bool Simple)
   // multi-threaded issues in putty timer list
   conf_set_int(conf, CONF_ping_interval, 0);
   conf_set_bool(conf, CONF_compression, Data->Compression);
+  conf_set_int(conf, CONF_compression_level, Data->CompressionLevel);
   conf_set_bool(conf, CONF_tryagent, Data->TryAgent);
   conf_set_bool(conf, CONF_agentfwd, Data->AgentFwd);
   conf_set_int(conf, CONF_addressfamily, Data->AddressFamily);
@@ -299,6 +300,7 @@ Conf * __fastcall TSecureShell::StoreToConfig(TSessionData * Data, bool Simple)
   {
     DebugAssert(Simple);
     conf_set_bool(conf, CONF_ssh_simple, Data->SshSimple && Simple);
+    conf_set_bool(conf, CONF_decrypt_thread, Data->SshDecryptThread);
 
     if (Data->FSProtocol == fsSCPonly)
     {
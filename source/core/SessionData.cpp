@@ -186,6 +186,8 @@ void __fastcall TSessionData::DefaultSettings()
   LogicalHostName = L"";
   ChangeUsername = false;
   Compression = false;
+  // 0 = PuTTY's original compressor, 1-9 = leveled deflate engine
+  CompressionLevel = 0;
   Ssh2DES = false;
   SshNoUserAuth = false;
   for (int Index = 0; Index < CIPHER_COUNT; Index++)
@@ -214,6 +216,7 @@ void __fastcall TSessionData::DefaultSettings()
   SourceAddress = L"";
   ProtocolFeatures = L"";
   SshSimple = true;
+  SshDecryptThread = false;
   HostKey = L"";
   FingerprintScan = false;
   FOverrideCachedHostKey = true;
@@ -335,6 +338,7 @@ void __fastcall TSessionData::DefaultSettings()
   FtpHost = asAuto;
   FtpWorkFromCwd = asAuto;
   FtpAnyCodeForPwd = false;
+  FtpModeZLevel = 0;
   SslSessionReuse = true;
   TlsCertificateFile = L"";
 
@@ -407,6 +411,7 @@ void __fastcall TSessionData::NonPersistent()
   PROPERTY(LogicalHostName); \
   PROPERTY(ChangeUsername); \
   PROPERTY(Compression); \
+  PROPERTY(CompressionLevel); \
   PROPERTY(Ssh2DES); \
   PROPERTY(SshNoUserAuth); \
   PROPERTY(CipherList); \
@@ -452,6 +457,7 @@ void __fastcall TSessionData::NonPersistent()
   PROPERTY(SourceAddress); \
   PROPERTY(ProtocolFeatures); \
   PROPERTY(SshSimple); \
+  PROPERTY(SshDecryptThread); \
   PROPERTY(AuthKI); \
   PROPERTY(AuthKIPassword); \
   PROPERTY(AuthGSSAPI); \
@@ -524,6 +530,7 @@ void __fastcall TSessionData::NonPersistent()
   PROPERTY(FtpHost); \
   PROPERTY(FtpWorkFromCwd); \
   PROPERTY(FtpAnyCodeForPwd); \
+  PROPERTY(FtpModeZLevel); \
   PROPERTY(SslSessionReuse); \
   PROPERTY(TlsCertificateFile); \
   \
@@ -758,6 +765,7 @@ void TSessionData::DoLoad(
   LogicalHostName = Storage->ReadString(L"LogicalHostName", Storage->ReadString(L"GSSAPIServerRealm", Storage->ReadString(L"KerbPrincipal", LogicalHostName)));
   ChangeUsername = Storage->ReadBool(L"ChangeUsername", ChangeUsername);
   Compression = Storage->ReadBool(L"Compression", Compression);
+  CompressionLevel = Storage->ReadInteger(L"CompressionLevel", CompressionLevel);
   Ssh2DES = Storage->ReadBool(L"Ssh2DES", Ssh2DES);
   SshNoUserAuth = Storage->ReadBool(L"SshNoUserAuth", SshNoUserAuth);
   CipherList = Storage->ReadString(L"Cipher", CipherList);
@@ -845,6 +853,7 @@ void TSessionData::DoLoad(
   SourceAddress = Storage->ReadString(L"SourceAddress", SourceAddress);
   ProtocolFeatures = Storage->ReadString(L"ProtocolFeatures", ProtocolFeatures);
   SshSimple = Storage->ReadBool(L"SshSimple", SshSimple);
+  SshDecryptThread = Storage->ReadBool(L"SshDecryptThread", SshDecryptThread);
 
   ProxyMethod = Storage->ReadEnum(L"ProxyMethod", ProxyMethod, ProxyMethodMapping);
   ProxyHost = Storage->ReadString(L"ProxyHost", ProxyHost);
@@ -956,6 +965,7 @@ void TSessionData::DoLoad(
   FtpHost = Storage->ReadEnum(L"FtpHost", FtpHost, AutoSwitchMapping);
   FtpWorkFromCwd = Storage->ReadEnum(L"FtpWorkFromCwd", Storage->ReadEnum(L"FtpDeleteFromCwd", FtpWorkFromCwd), AutoSwitchMapping);
   FtpAnyCodeForPwd = Storage->ReadBool(L"FtpAnyCodeForPwd", FtpAnyCodeForPwd);
+  FtpModeZLevel = Storage->ReadInteger(L"FtpModeZLevel", FtpModeZLevel);
   SslSessionReuse = Storage->ReadBool(L"SslSessionReuse", SslSessionReuse);
   TlsCertificateFile = Storage->ReadString(L"TlsCertificateFile", TlsCertificateFile);
 
@@ -1102,6 +1112,7 @@ void __fastcall TSessionData::DoSave(THierarchicalStorage * Storage,
 
   WRITE_DATA(Bool, ChangeUsername);
   WRITE_DATA(Bool, Compression);
+  WRITE_DATA(Integer, CompressionLevel);
   WRITE_DATA(Bool, Ssh2DES);
   WRITE_DATA(Bool, SshNoUserAuth);
   WRITE_DATA_EX(String, L"Cipher", CipherList, );
@@ -1193,6 +1204,7 @@ void __fastcall TSessionData::DoSave(THierarchicalStorage * Storage,
     WRITE_DATA(String, SourceAddress);
     WRITE_DATA(String, ProtocolFeatures);
     WRITE_DATA(Bool, SshSimple);
+    WRITE_DATA(Bool, SshDecryptThread);
   }
 
   WRITE_DATA(Integer, ProxyMethod);
@@ -1275,6 +1287,7 @@ void __fastcall TSessionData::DoSave(THierarchicalStorage * Storage,
     WRITE_DATA(Integer, FtpHost);
     WRITE_DATA(Integer, FtpWorkFromCwd);
     WRITE_DATA(Bool, FtpAnyCodeForPwd);
+    WRITE_DATA(Integer, FtpModeZLevel);
     WRITE_DATA(Bool, SslSessionReuse);
     WRITE_DATA(String, TlsCertificateFile);
 
@@ -2716,6 +2729,7 @@ TSessionData * TSessionData::CreateTunnelData(int TunnelLocalPortNumber)
 
   // inherit most SSH options of the main session (except for private key and bugs)
   TunnelData->Compression = Compression;
+  TunnelData->CompressionLevel = CompressionLevel;
   TunnelData->CipherList = CipherList;
   TunnelData->Ssh2DES = Ssh2DES;
 
@@ -3050,6 +3064,11 @@ void __fastcall TSessionData::SetCompression(bool value)
   SET_SESSION_PROPERTY(Compression);
 }
 //---------------------------------------------------------------------
+void __fastcall TSessionData::SetCompressionLevel(int value)
+{
+  SET_SESSION_PROPERTY(CompressionLevel);
+}
+//---------------------------------------------------------------------
 void __fastcall TSessionData::SetSsh2DES(bool value)
 {
   SET_SESSION_PROPERTY(Ssh2DES);
@@ -4267,6 +4286,11 @@ void __fastcall TSessionData::SetSshSimple(bool value)
   SET_SESSION_PROPERTY(SshSimple);
 }
 //---------------------------------------------------------------------
+void __fastcall TSessionData::SetSshDecryptThread(bool value)
+{
+  SET_SESSION_PROPERTY(SshDecryptThread);
+}
+//---------------------------------------------------------------------
 void __fastcall TSessionData::SetProxyMethod(TProxyMethod value)
 {
   SET_SESSION_PROPERTY(ProxyMethod);
@@ -4594,6 +4618,11 @@ void TSessionData::SetFtpAnyCodeForPwd(bool value)
   SET_SESSION_PROPERTY(FtpAnyCodeForPwd);
 }
 //---------------------------------------------------------------------
+void TSessionData::SetFtpModeZLevel(int value)
+{
+  SET_SESSION_PROPERTY(FtpModeZLevel);
+}
+//---------------------------------------------------------------------
 void __fastcall TSessionData::SetSslSessionReuse(bool value)
 {
   SET_SESSION_PROPERTY(SslSessionReuse);
@@ -4836,7 +4865,10 @@ void __fastcall TStoredSessionList::Load(THierarchicalStorage * Storage,
   bool AsModified, bool UseDefaults, bool PuttyImport)
 {
   TStringList *SubKeys = new TStringList();
-  TList * Loaded = new TList;
+  // Both lookups below would be quadratic with plain list searches,
+  // what matters with thousands of sites
+  std::set<TObject *> Loaded;
+  std::map<UnicodeString, TSessionData *> Existing;
   try
   {
     DebugAssert(AutoSort);
@@ -4845,6 +4877,13 @@ void __fastcall TStoredSessionList::Load(THierarchicalStorage * Storage,
 
     Storage->GetSubKeyNames(SubKeys);
 
+    for (int Index = 0; Index < CountIncludingHidden; Index++)
+    {
+      TSessionData * Data = static_cast<TSessionData *>(Items[Index]);
+      // Keeps the first one, as FindByName did
+      Existing.insert(std::make_pair(AnsiUpperCase(Data->Name), Data));
+    }
+
     for (int Index = 0; Index < SubKeys->Count; Index++)
     {
       UnicodeString SessionName = SubKeys->Strings[Index];
@@ -4877,7 +4916,8 @@ void __fastcall TStoredSessionList::Load(THierarchicalStorage * Storage,
           }
           else
           {
-            SessionData = static_cast<TSessionData*>(FindByName(SessionName));
+            std::map<UnicodeString, TSessionData *>::const_iterator I = Existing.find(AnsiUpperCase(SessionName));
+            SessionData = (I != Existing.end()) ? I->second : NULL;
           }
         }
 
@@ -4893,7 +4933,7 @@ void __fastcall TStoredSessionList::Load(THierarchicalStorage * Storage,
             SessionData->Name = SessionName;
             Add(SessionData);
           }
-          Loaded->Add(SessionData);
+          Loaded.insert(SessionData);
           SessionData->Load(Storage, PuttyImport);
           if (AsModified)
           {
@@ -4907,7 +4947,7 @@ void __fastcall TStoredSessionList::Load(THierarchicalStorage * Storage,
     {
       for (int Index = 0; Index < TObjectList::Count; Index++)
       {
-        if (Loaded->IndexOf(Items[Index]) < 0)
+        if (Loaded.find(Items[Index]) == Loaded.end())
         {
           Delete(Index);
           Index--;
@@ -4920,7 +4960,6 @@ void __fastcall TStoredSessionList::Load(THierarchicalStorage * Storage,
     AutoSort = true;
     AlphaSort();
     delete SubKeys;
-    delete Loaded;
   }
 }
 //---------------------------------------------------------------------
@@ -4928,11 +4967,25 @@ void __fastcall TStoredSessionList::Reload()
 {
   if (Count <= Configuration->DontReloadMoreThanSessions)
   {
-    bool SessionList = true;
-    std::unique_ptr<THierarchicalStorage> Storage(Configuration->CreateScpStorage(SessionList));
-    if (Storage->OpenSubKey(Configuration->StoredSessionsSubKey, False))
+    // Parsing a large INI file is slow, so it is not reloaded, unless it has changed since the last reload
+    UnicodeString FileName;
+    TDateTime FileTimestamp;
+    if (Configuration->Storage == stIniFile)
     {
-      Load(Storage.get());
+      FileName = Configuration->IniFileStorageName;
+      FileAge(FileName, FileTimestamp);
+    }
+
+    if (FileName.IsEmpty() || (FileName != FReloadedFileName) || (FileTimestamp != FReloadedFileTimestamp))
+    {
+      bool SessionList = true;
+      std::unique_ptr<THierarchicalStorage> Storage(Configuration->CreateScpStorage(SessionList));
+      if (Storage->OpenSubKey(Configuration->StoredSessionsSubKey, False))
+      {
+        Load(Storage.get());
+      }
+      FReloadedFileName = FileName;
+      FReloadedFileTimestamp = FileTimestamp;
     }
   }
 }
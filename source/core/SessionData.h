@@ -132,6 +132,7 @@ private:
   bool FGSSAPIFwdTGT;
   bool FChangeUsername;
   bool FCompression;
+  int FCompressionLevel;
   bool FSsh2DES;
   bool FSshNoUserAuth;
   TCipher FCiphers[CIPHER_COUNT];
@@ -174,6 +175,7 @@ private:
   UnicodeString FSourceAddress;
   UnicodeString FProtocolFeatures;
   bool FSshSimple;
+  bool FSshDecryptThread;
   TProxyMethod FProxyMethod;
   UnicodeString FProxyHost;
   int FProxyPort;
@@ -210,6 +212,7 @@ private:
   TAutoSwitch FFtpHost;
   TAutoSwitch FFtpWorkFromCwd;
   bool FFtpAnyCodeForPwd;
+  int FFtpModeZLevel;
   bool FSslSessionReuse;
   UnicodeString FTlsCertificateFile;
   TAddressFamily FAddressFamily;
@@ -292,6 +295,7 @@ private:
   void __fastcall SetGSSAPIFwdTGT(bool value);
   void __fastcall SetChangeUsername(bool value);
   void __fastcall SetCompression(bool value);
+  void __fastcall SetCompressionLevel(int value);
   void __fastcall SetSsh2DES(bool value);
   void __fastcall SetSshNoUserAuth(bool value);
   void __fastcall SetCipher(int Index, TCipher value);
@@ -357,6 +361,7 @@ private:
   void __fastcall SetSourceAddress(const UnicodeString & value);
   void __fastcall SetProtocolFeatures(const UnicodeString & value);
   void __fastcall SetSshSimple(bool value);
+  void __fastcall SetSshDecryptThread(bool value);
   bool __fastcall GetUsesSsh();
   void __fastcall SetCipherList(UnicodeString value);
   UnicodeString __fastcall GetCipherList() const;
@@ -399,6 +404,7 @@ private:
   void __fastcall SetFtpHost(TAutoSwitch value);
   void __fastcall SetFtpWorkFromCwd(TAutoSwitch value);
   void SetFtpAnyCodeForPwd(bool value);
+  void SetFtpModeZLevel(int value);
   void __fastcall SetSslSessionReuse(bool value);
   void __fastcall SetTlsCertificateFile(UnicodeString value);
   UnicodeString __fastcall GetStorageKey();
@@ -605,6 +611,7 @@ public:
   __property bool GSSAPIFwdTGT = { read=FGSSAPIFwdTGT, write=SetGSSAPIFwdTGT };
   __property bool ChangeUsername  = { read=FChangeUsername, write=SetChangeUsername };
   __property bool Compression  = { read=FCompression, write=SetCompression };
+  __property int CompressionLevel = { read=FCompressionLevel, write=SetCompressionLevel };
   __property bool UsesSsh = { read = GetUsesSsh };
   __property bool Ssh2DES  = { read=FSsh2DES, write=SetSsh2DES };
   __property bool SshNoUserAuth  = { read=FSshNoUserAuth, write=SetSshNoUserAuth };
@@ -663,6 +670,7 @@ public:
   __property UnicodeString SourceAddress = { read=FSourceAddress, write=SetSourceAddress };
   __property UnicodeString ProtocolFeatures = { read=FProtocolFeatures, write=SetProtocolFeatures };
   __property bool SshSimple  = { read=FSshSimple, write=SetSshSimple };
+  __property bool SshDecryptThread = { read=FSshDecryptThread, write=SetSshDecryptThread };
   __property UnicodeString CipherList  = { read=GetCipherList, write=SetCipherList };
   __property UnicodeString KexList  = { read=GetKexList, write=SetKexList };
   __property UnicodeString HostKeyList  = { read=GetHostKeyList, write=SetHostKeyList };
@@ -697,6 +705,7 @@ public:
   __property TAutoSwitch FtpHost = { read = FFtpHost, write = SetFtpHost };
   __property TAutoSwitch FtpWorkFromCwd = { read = FFtpWorkFromCwd, write = SetFtpWorkFromCwd };
   __property bool FtpAnyCodeForPwd = { read = FFtpAnyCodeForPwd, write = SetFtpAnyCodeForPwd };
+  __property int FtpModeZLevel = { read = FFtpModeZLevel, write = SetFtpModeZLevel };
   __property bool SslSessionReuse = { read = FSslSessionReuse, write = SetSslSessionReuse };
   __property UnicodeString TlsCertificateFile = { read=FTlsCertificateFile, write=SetTlsCertificateFile };
   __property TDSTMode DSTMode = { read = FDSTMode, write = SetDSTMode };
@@ -824,6 +833,8 @@ private:
   TSessionData * FDefaultSettings;
   bool FReadOnly;
   std::unique_ptr<TStrings> FPendingRemovals;
+  UnicodeString FReloadedFileName;
+  TDateTime FReloadedFileTimestamp;
   void __fastcall SetDefaultSettings(TSessionData * value);
   void __fastcall DoSave(THierarchicalStorage * Storage, bool All,
     bool RecryptPasswordOnly, TStrings * RecryptPasswordErrors);
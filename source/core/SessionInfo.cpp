@@ -1294,6 +1294,10 @@ void __fastcall TSessionLog::DoAddStartupInfo(TSessionData * Data)
     if (Data->UsesSsh)
     {
       ADF(L"Compression: %s", (BooleanToEngStr(Data->Compression)));
+      if (Data->CompressionLevel > 0)
+      {
+        ADF(L"Compression level: %d", (Data->CompressionLevel));
+      }
       ADF(L"Bypass authentication: %s",
        (BooleanToEngStr(Data->SshNoUserAuth)));
       ADF(L"Try agent: %s; Agent forwarding: %s; KI: %s; GSSAPI: %s",
@@ -1313,7 +1317,8 @@ void __fastcall TSessionLog::DoAddStartupInfo(TSessionData * Data)
         AddToList(Bugs, EnumName(Data->Bug[static_cast<TSshBug>(Index)], AutoSwitchNames), L",");
       }
       ADF(L"SSH Bugs: %s", (Bugs));
-      ADF(L"Simple channel: %s", (BooleanToEngStr(Data->SshSimple)));
+      ADF(L"Simple channel: %s; Decryption thread: %s",
+        (BooleanToEngStr(Data->SshSimple), BooleanToEngStr(Data->SshDecryptThread)));
       ADF(L"Return code variable: %s; Lookup user groups: %s",
         ((Data->DetectReturnVar ? UnicodeString(L"Autodetect") : Data->ReturnVar),
          EnumName(Data->LookupUserGroups, AutoSwitchNames)));
@@ -1390,6 +1395,10 @@ void __fastcall TSessionLog::DoAddStartupInfo(TSessionData * Data)
       {
         ADF(L"FTP: Relative paths: %s", (EnumName(Data->FtpWorkFromCwd, AutoSwitchNames)));
       }
+      if (Data->FtpModeZLevel > 0)
+      {
+        ADF(L"FTP: MODE Z compression level: %d", (Data->FtpModeZLevel));
+      }
     }
     if (Data->FSProtocol == fsWebDAV)
     {
@@ -1524,6 +1533,7 @@ void __fastcall TActionLog::Init(TSessionUI * UI, TDateTime Started, TSessionDat
   FSessionData = SessionData;
   FStarted = Started;
   FFile = NULL;
+  FEvent = NULL;
   FCurrentLogFileName = L"";
   FCurrentFileName = L"";
   FLogging = false;
@@ -1575,6 +1585,11 @@ void __fastcall TActionLog::Add(const UnicodeString & Line)
         {
           throw ECRTExtException(L"");
         }
+        // The file is unbuffered, so the reader can process the line straight away
+        if (FEvent != NULL)
+        {
+          SetEvent(FEvent);
+        }
       }
       catch (Exception &E)
       {
@@ -1687,6 +1702,13 @@ void __fastcall TActionLog::CloseLogFile()
     fclose(static_cast<FILE *>(FFile));
     FFile = NULL;
   }
+  if (FEvent != NULL)
+  {
+    // wake up the reader to let it see the end of the log
+    SetEvent(FEvent);
+    CloseHandle(FEvent);
+    FEvent = NULL;
+  }
   FCurrentLogFileName = L"";
   FCurrentFileName = L"";
 }
@@ -1699,6 +1721,13 @@ void __fastcall TActionLog::OpenLogFile()
     DebugAssert(FConfiguration != NULL);
     FCurrentLogFileName = FConfiguration->ActionsLogFileName;
     FFile = OpenFile(FCurrentLogFileName, FStarted, FSessionData, false, FCurrentFileName);
+    UnicodeString EventName = FConfiguration->ActionsLogEventName;
+    if (!EventName.IsEmpty())
+    {
+      DebugAssert(FEvent == NULL);
+      // Optional, the event does not exist, when the reader does not support it
+      FEvent = OpenEvent(EVENT_MODIFY_STATE, false, EventName.c_str());
+    }
   }
   catch (Exception & E)
   {
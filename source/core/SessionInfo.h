@@ -346,6 +346,7 @@ private:
   TCriticalSection * FCriticalSection;
   bool FLogging;
   void * FFile;
+  HANDLE FEvent;
   UnicodeString FCurrentLogFileName;
   UnicodeString FCurrentFileName;
   TSessionUI * FUI;
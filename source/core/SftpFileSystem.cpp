@@ -161,6 +161,9 @@ const int asOpUnsupported = 1 << SSH_FX_OP_UNSUPPORTED;
 const int asNoSuchFile =    1 << SSH_FX_NO_SUCH_FILE;
 const int asAll = 0xFFFF;
 //---------------------------------------------------------------------------
+const __int64 CopyDataChunkSize = 256 * 1024 * 1024;
+const int CopyDataQueueLen = 4;
+//---------------------------------------------------------------------------
 #define GET_32BITC(cp, i) static_cast<unsigned long>(static_cast<unsigned char>((cp)[i]))
 #define GET_32BIT(cp) \
     ((GET_32BITC(cp, 0) << 24) | \
@@ -1523,6 +1526,7 @@ public:
     OperationProgress = NULL;
     FLastBlockSize = 0;
     FEnd = false;
+    FEndPosition = -1;
     FConvertToken = false;
     FQueueMaxLen = QueueMaxLen;
   }
@@ -1534,10 +1538,11 @@ public:
 
   bool __fastcall Init(const UnicodeString & AFileName,
     HANDLE AFile, TTransferInEvent OnTransferIn, TFileOperationProgressType * AOperationProgress,
-    const RawByteString AHandle, __int64 ATransferred,
+    const RawByteString AHandle, __int64 ATransferred, __int64 AEndPosition,
     int ConvertParams)
   {
     FFileName = AFileName;
+    FEndPosition = AEndPosition;
     if (OnTransferIn == NULL)
     {
       FStream = new TSafeHandleStream(reinterpret_cast<THandle>(AFile));
@@ -1564,6 +1569,14 @@ protected:
     TFileBuffer BlockBuf;
 
     unsigned long BlockSize = FFileSystem->UploadBlockSize(FHandle, OperationProgress);
+    // Part of a parallel upload
+    if ((FEndPosition >= 0) && DebugAlwaysTrue(FStream != NULL) &&
+        (FEndPosition - FStream->Position < static_cast<__int64>(BlockSize)))
+    {
+      BlockSize = static_cast<unsigned long>(std::max(FEndPosition - FStream->Position, 0LL));
+      // The part is complete, the same as when reaching the end of the file below
+      FEnd = (BlockSize == 0);
+    }
     bool Result = (BlockSize > 0);
 
     if (Result)
@@ -1581,7 +1594,9 @@ protected:
           BlockBuf.LoadStream(FStream, BlockSize, false);
         }
         FILE_OPERATION_LOOP_END(FMTLOAD(READ_ERROR, (FFileName)));
-        Last = (FStream->Position >= FStream->Size);
+        Last =
+          (FStream->Position >= FStream->Size) ||
+          ((FEndPosition >= 0) && (FStream->Position >= FEndPosition));
       }
 
       FEnd = (BlockBuf.Size == 0);
@@ -1698,6 +1713,7 @@ private:
   unsigned long FLastBlockSize;
   bool FEnd;
   __int64 FTransferred;
+  __int64 FEndPosition;
   RawByteString FHandle;
   bool FConvertToken;
   int FConvertParams;
@@ -1785,6 +1801,95 @@ private:
   int FIndex;
 };
 //---------------------------------------------------------------------------
+// Pipelines simple per-file requests (SSH_FXP_SETSTAT, SSH_FXP_REMOVE)
+class TSFTPFilesQueue : public TSFTPFixedLenQueue
+{
+public:
+  TSFTPFilesQueue(TSFTPFileSystem * AFileSystem) :
+    TSFTPFixedLenQueue(AFileSystem)
+  {
+    FIndex = 0;
+  }
+  virtual __fastcall ~TSFTPFilesQueue(){}
+
+  bool __fastcall Init(
+    int QueueLen, unsigned char Type, const TRemoteProperties * Properties, TFileOperation Operation,
+    TStrings * FileList)
+  {
+    FType = Type;
+    FProperties = Properties;
+    FOperation = Operation;
+    FFileList = FileList;
+
+    return TSFTPFixedLenQueue::Init(QueueLen);
+  }
+
+  // Unlike other queues, errors do not break the pipeline,
+  // the caller gets the failed file (with Error set) and moves on
+  bool __fastcall ReceivePacket(int & Index, Exception *& Error)
+  {
+    void * Token = NULL;
+    bool Result;
+    Error = NULL;
+    try
+    {
+      Result = TSFTPFixedLenQueue::ReceivePacket(NULL, SSH_FXP_STATUS, asOK, &Token);
+    }
+    catch (Exception & E)
+    {
+      // Cancellation (from StartOperationWithFile in InitRequest) or a lost connection
+      if (!FFileSystem->FTerminal->Active ||
+          (dynamic_cast<EAbort *>(&E) != NULL) ||
+          (dynamic_cast<ESkipFile *>(&E) != NULL) ||
+          (dynamic_cast<EFatal *>(&E) != NULL))
+      {
+        throw;
+      }
+      Error = CloneException(&E);
+      // The failed request was removed already, refill its slot
+      SendRequests();
+      Result = (FRequests->Count > 0);
+    }
+    Index = static_cast<int>(reinterpret_cast<intptr_t>(Token));
+    return Result;
+  }
+
+protected:
+  virtual bool __fastcall InitRequest(TSFTPQueuePacket * Request)
+  {
+    bool Result = (FIndex < FFileList->Count);
+    if (Result)
+    {
+      UnicodeString FileName = FFileList->Strings[FIndex];
+      const TRemoteFile * File = static_cast<TRemoteFile *>(FFileList->Objects[FIndex]);
+      FFileSystem->InitFilesQueueRequest(*Request, FType, FileName, File, FProperties, FOperation);
+      Request->Token = reinterpret_cast<void *>(static_cast<intptr_t>(FIndex));
+      FIndex++;
+    }
+    return Result;
+  }
+
+  virtual bool __fastcall SendRequest()
+  {
+    bool Result =
+      (FIndex < FFileList->Count) &&
+      TSFTPFixedLenQueue::SendRequest();
+    return Result;
+  }
+
+  virtual bool __fastcall End(TSFTPPacket * /*Response*/)
+  {
+    return (FRequests->Count == 0);
+  }
+
+private:
+  unsigned char FType;
+  const TRemoteProperties * FProperties;
+  TFileOperation FOperation;
+  TStrings * FFileList;
+  int FIndex;
+};
+//---------------------------------------------------------------------------
 class TSFTPCalculateFilesChecksumQueue : public TSFTPFixedLenQueue
 {
 public:
@@ -3865,8 +3970,24 @@ void __fastcall TSFTPFileSystem::DoDeleteFile(const UnicodeString FileName, unsi
 void __fastcall TSFTPFileSystem::DeleteFile(const UnicodeString FileName,
   const TRemoteFile * File, int Params, TRmSessionAction & Action)
 {
+  // As TTerminal::DeleteContentsIfDirectory, just with the files deleted in a pipeline
+  // (the directory itself is removed only after all its contents)
+  bool Dir = (File != NULL) && File->IsDirectory && FTerminal->CanRecurseToDirectory(File);
+  if (Dir && FLAGCLEAR(Params, dfNoRecursive))
+  {
+    try
+    {
+      ProcessDirectoryPipelined(FileName, SSH_FXP_REMOVE, NULL, FTerminal->DeleteFile, &Params);
+    }
+    catch(...)
+    {
+      Action.Cancel();
+      throw;
+    }
+  }
+
   unsigned char Type;
-  if (FTerminal->DeleteContentsIfDirectory(FileName, File, Params, Action))
+  if (Dir && !File->IsSymLink)
   {
     Type = SSH_FXP_RMDIR;
   }
@@ -3878,6 +3999,203 @@ void __fastcall TSFTPFileSystem::DeleteFile(const UnicodeString FileName,
   DoDeleteFile(FileName, Type);
 }
 //---------------------------------------------------------------------------
+void TSFTPFileSystem::InitFilesQueueRequest(
+  TSFTPPacket & Packet, unsigned char Type, const UnicodeString & FileName, const TRemoteFile * File,
+  const TRemoteProperties * Properties, TFileOperation Operation)
+{
+  // Checks for cancellation
+  FTerminal->StartOperationWithFile(FileName, Operation);
+  // Logged as by TTerminal::ChangeFileProperties and TTerminal::DoDeleteFile
+  if (Type == SSH_FXP_SETSTAT)
+  {
+    FTerminal->LogChangeFileProperties(FileName, Properties);
+  }
+  else
+  {
+    FTerminal->LogEvent(FORMAT(L"Deleting file \"%s\".", (FileName)));
+  }
+  FTerminal->FileModified(File, FileName, (Type == SSH_FXP_REMOVE) || (Type == SSH_FXP_RMDIR));
+
+  Packet.ChangeType(Type);
+  AddPathString(Packet, LocalCanonify(FileName));
+  if (Type == SSH_FXP_SETSTAT)
+  {
+    AddSetStatProperties(Packet, File, Properties, NULL);
+  }
+}
+//---------------------------------------------------------------------------
+// Sends Type request for all Files with the requests pipelined.
+// Files, for which the request fails, are added to Failed.
+void TSFTPFileSystem::ProcessFilesPipelined(
+  unsigned char Type, const TRemoteProperties * Properties, TStrings * Files, TStrings * Failed)
+{
+  TFileOperation Operation = (Type == SSH_FXP_SETSTAT) ? foSetProperties : foDelete;
+  static int FilesQueueLen = 32;
+  TSFTPFilesQueue Queue(this);
+  try
+  {
+    if (Queue.Init(FilesQueueLen, Type, Properties, Operation, Files))
+    {
+      bool Next;
+      do
+      {
+        int Index;
+        Exception * Error;
+        Next = Queue.ReceivePacket(Index, Error);
+        std::unique_ptr<Exception> ErrorOwner(Error);
+        UnicodeString FileName = Files->Strings[Index];
+        const TRemoteFile * File = static_cast<TRemoteFile *>(Files->Objects[Index]);
+        if (Error != NULL)
+        {
+          FTerminal->LogEvent(FORMAT(L"Pipelined request for \"%s\" failed, will retry individually: %s", (FileName, Error->Message)));
+          Failed->AddObject(FileName, const_cast<TRemoteFile *>(File));
+        }
+        else if (Type == SSH_FXP_SETSTAT)
+        {
+          FTerminal->LogEvent(FORMAT(L"Changed properties of \"%s\".", (FileName)));
+          TChmodSessionAction Action(FTerminal->ActionLog, FTerminal->AbsolutePath(FileName, true));
+          if (Properties->Valid.Contains(vpRights))
+          {
+            TRights Rights = TRights(*File->Rights).Combine(Properties->Rights);
+            Action.Rights(Rights);
+          }
+        }
+        else
+        {
+          FTerminal->LogEvent(
+            FORMAT((Type == SSH_FXP_RMDIR) ? L"Deleted directory \"%s\"." : L"Deleted file \"%s\".", (FileName)));
+          UnicodeString AbsoluteFileName = FTerminal->AbsolutePath(FileName, true);
+          TRmSessionAction Action(FTerminal->ActionLog, AbsoluteFileName);
+          TFileOperationProgressType * OperationProgress = FTerminal->OperationProgress;
+          if ((OperationProgress != NULL) && (OperationProgress->Operation == foDelete))
+          {
+            OperationProgress->Succeeded();
+          }
+          // Forget if file was or was not encrypted, as TTerminal::DoDeleteFile does
+          FTerminal->FEncryptedFileNames.erase(AbsoluteFileName);
+        }
+      }
+      while (Next);
+    }
+  }
+  __finally
+  {
+    Queue.DisposeSafe();
+  }
+  FTerminal->ReactOnCommand((Type == SSH_FXP_SETSTAT) ? fsChangeProperties : fsDeleteFile);
+}
+//---------------------------------------------------------------------------
+// Applies Type request to all files of the directory, with the requests pipelined.
+// Subdirectories (and files, for which the request fails) are processed one by one
+// using the CallBackFunc, as with TTerminal::ProcessDirectory,
+// what takes care of recursion and of error handling (retry/skip).
+// When deleting, subdirectories are emptied here directly (bottom-up)
+// and then removed by a single pipelined batch of RMDIR requests.
+// Returns true, when all files were processed by the pipelined requests,
+// i.e. when none had to be processed one by one (what possibly included a skip).
+bool TSFTPFileSystem::ProcessDirectoryPipelined(
+  const UnicodeString & DirName, unsigned char Type, const TRemoteProperties * Properties,
+  TProcessFileEvent CallBackFunc, void * Param)
+{
+  bool Result = false;
+  // skip if directory listing fails and user selects "skip"
+  std::unique_ptr<TRemoteFileList> FileList(FTerminal->CustomReadDirectoryListing(DirName, false));
+  if (FileList.get() != NULL)
+  {
+    UnicodeString Directory = UnixIncludeTrailingBackslash(DirName);
+    std::unique_ptr<TStringList> Files(new TStringList());
+    std::unique_ptr<TStringList> Directories(new TStringList());
+    std::unique_ptr<TStringList> Others(new TStringList());
+    std::unique_ptr<TStringList> Undrained(new TStringList());
+    for (int Index = 0; Index < FileList->Count; Index++)
+    {
+      TRemoteFile * File = FileList->Files[Index];
+      if (IsRealFile(File->FileName))
+      {
+        UnicodeString FullFileName = Directory + File->FileName;
+        if (File->IsDirectory)
+        {
+          if ((Type == SSH_FXP_REMOVE) && !File->IsSymLink && FTerminal->CanRecurseToDirectory(File))
+          {
+            Directories->AddObject(FullFileName, File);
+          }
+          else
+          {
+            Others->AddObject(FullFileName, File);
+          }
+        }
+        else
+        {
+          Files->AddObject(FullFileName, File);
+        }
+      }
+    }
+
+    if (Files->Count > 0)
+    {
+      ProcessFilesPipelined(Type, Properties, Files.get(), Others.get());
+    }
+
+    if (Directories->Count > 0)
+    {
+      std::unique_ptr<TStringList> Drained(new TStringList());
+      for (int Index = 0; Index < Directories->Count; Index++)
+      {
+        UnicodeString FileName = Directories->Strings[Index];
+        try
+        {
+          // Checks for cancellation
+          FTerminal->StartOperationWithFile(FileName, foDelete);
+          if (ProcessDirectoryPipelined(FileName, Type, Properties, CallBackFunc, Param))
+          {
+            Drained->AddObject(FileName, Directories->Objects[Index]);
+          }
+          else
+          {
+            Undrained->AddObject(FileName, Directories->Objects[Index]);
+          }
+        }
+        catch (Exception & E)
+        {
+          if (!FTerminal->Active ||
+              (dynamic_cast<EAbort *>(&E) != NULL) ||
+              (dynamic_cast<ESkipFile *>(&E) != NULL) ||
+              (dynamic_cast<EFatal *>(&E) != NULL))
+          {
+            throw;
+          }
+          // Let the CallBackFunc redo the directory and report the error
+          FTerminal->LogEvent(FORMAT(L"Emptying directory \"%s\" failed, will retry individually: %s", (FileName, E.Message)));
+          Others->AddObject(FileName, Directories->Objects[Index]);
+        }
+      }
+
+      if (Drained->Count > 0)
+      {
+        ProcessFilesPipelined(SSH_FXP_RMDIR, Properties, Drained.get(), Others.get());
+      }
+
+      // Some contents of these were processed one by one already (and possibly skipped),
+      // so only try to remove the directory itself, not to ask about the contents again.
+      int Params = (Param != NULL) ? *static_cast<int *>(Param) : 0;
+      for (int Index = 0; Index < Undrained->Count; Index++)
+      {
+        UnicodeString FileName = Undrained->Strings[Index];
+        const TRemoteFile * File = static_cast<TRemoteFile *>(Undrained->Objects[Index]);
+        FTerminal->DoDeleteFile(this, FileName, File, Params | dfNoRecursive);
+      }
+    }
+
+    Result = (Undrained->Count == 0) && (Others->Count == 0);
+
+    for (int Index = 0; Index < Others->Count; Index++)
+    {
+      CallBackFunc(Others->Strings[Index], static_cast<TRemoteFile *>(Others->Objects[Index]), Param);
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
 void __fastcall TSFTPFileSystem::RenameFile(
   const UnicodeString & FileName, const TRemoteFile *, const UnicodeString & NewName, bool DebugUsedArg(Overwrite))
 {
@@ -3950,13 +4268,20 @@ void __fastcall TSFTPFileSystem::CopyFile(
       DestRemoteHandle = SFTPOpenRemoteFile(NewNameCanonical, SSH_FXF_WRITE | SSH_FXF_CREAT | SSH_FXF_EXCL, Encrypted, Size);
 
       TSFTPPacket Packet(SSH_FXP_EXTENDED);
-      Packet.AddString(SFTP_EXT_COPY_DATA);
-      Packet.AddString(SourceRemoteHandle);
-      Packet.AddInt64(0);
-      Packet.AddInt64(0); // until EOF
-      Packet.AddString(DestRemoteHandle);
-      Packet.AddInt64(0);
-      SendPacketAndReceiveResponse(&Packet, &Packet, SSH_FXP_STATUS);
+      if (Size > CopyDataChunkSize)
+      {
+        CopyDataRanges(SourceRemoteHandle, DestRemoteHandle, Size);
+      }
+      else
+      {
+        Packet.AddString(SFTP_EXT_COPY_DATA);
+        Packet.AddString(SourceRemoteHandle);
+        Packet.AddInt64(0);
+        Packet.AddInt64(0); // until EOF
+        Packet.AddString(DestRemoteHandle);
+        Packet.AddInt64(0);
+        SendPacketAndReceiveResponse(&Packet, &Packet, SSH_FXP_STATUS);
+      }
 
       if (DebugAlwaysTrue(File != NULL))
       {
@@ -3981,6 +4306,73 @@ void __fastcall TSFTPFileSystem::CopyFile(
   }
 }
 //---------------------------------------------------------------------------
+// Copies large file by ranges, with several copy-data requests outstanding,
+// so that servers that process requests concurrently can copy the ranges in parallel.
+// This also allows cancelling the copy between the ranges.
+// The Size is only an estimate (the listed size of an encrypted file does not include the encryption overhead
+// and the file may have grown since listed), so the last range goes until EOF.
+void TSFTPFileSystem::CopyDataRanges(
+  const RawByteString & SourceRemoteHandle, const RawByteString & DestRemoteHandle, __int64 Size)
+{
+  int Ranges = static_cast<int>((Size + CopyDataChunkSize - 1) / CopyDataChunkSize);
+  FTerminal->LogEvent(FORMAT(L"Copying data by %d ranges", (Ranges)));
+
+  std::vector<TSFTPPacket *> Requests;
+  try
+  {
+    __int64 Offset = 0;
+    while ((Offset < Size) || !Requests.empty())
+    {
+      if ((Offset < Size) && (static_cast<int>(Requests.size()) < CopyDataQueueLen))
+      {
+        TFileOperationProgressType * OperationProgress = FTerminal->OperationProgress;
+        if ((OperationProgress != NULL) && (OperationProgress->Cancel != csContinue))
+        {
+          Abort();
+        }
+
+        bool Last = (Size - Offset <= CopyDataChunkSize);
+        std::unique_ptr<TSFTPPacket> Request(new TSFTPPacket(SSH_FXP_EXTENDED));
+        Request->AddString(SFTP_EXT_COPY_DATA);
+        Request->AddString(SourceRemoteHandle);
+        Request->AddInt64(Offset);
+        Request->AddInt64(Last ? 0 : CopyDataChunkSize); // 0 = until EOF
+        Request->AddString(DestRemoteHandle);
+        Request->AddInt64(Offset);
+        SendPacket(Request.get());
+        ReserveResponse(Request.get(), Request.get());
+        Requests.push_back(Request.release());
+        Offset = Last ? Size : (Offset + CopyDataChunkSize);
+      }
+      else
+      {
+        std::unique_ptr<TSFTPPacket> Request(Requests.front());
+        Requests.erase(Requests.begin());
+        ReceiveResponse(Request.get(), Request.get(), SSH_FXP_STATUS);
+      }
+    }
+  }
+  __finally
+  {
+    // After an error, process the remaining responses, ignoring other errors
+    while (!Requests.empty())
+    {
+      std::unique_ptr<TSFTPPacket> Request(Requests.front());
+      Requests.erase(Requests.begin());
+      if (FTerminal->Active)
+      {
+        try
+        {
+          ReceiveResponse(Request.get(), Request.get());
+        }
+        catch (...)
+        {
+        }
+      }
+    }
+  }
+}
+//---------------------------------------------------------------------------
 void __fastcall TSFTPFileSystem::CreateDirectory(const UnicodeString & DirName, bool Encrypt)
 {
   TSFTPPacket Packet(SSH_FXP_MKDIR);
@@ -4111,7 +4503,8 @@ void __fastcall TSFTPFileSystem::ChangeFileProperties(const UnicodeString FileNa
     {
       try
       {
-        FTerminal->ProcessDirectory(FileName, FTerminal->ChangeFileProperties,
+        ProcessDirectoryPipelined(
+          FileName, SSH_FXP_SETSTAT, AProperties, FTerminal->ChangeFileProperties,
           const_cast<TRemoteProperties *>(AProperties));
       }
       catch(...)
@@ -4121,26 +4514,9 @@ void __fastcall TSFTPFileSystem::ChangeFileProperties(const UnicodeString FileNa
       }
     }
 
-    // SFTP can change owner and group at the same time only, not individually.
-    // Fortunately we know current owner/group, so if only one is present,
-    // we can supplement the other.
-    TRemoteProperties Properties(*AProperties);
-    if (Properties.Valid.Contains(vpGroup) &&
-        !Properties.Valid.Contains(vpOwner))
-    {
-      Properties.Owner = File->Owner;
-      Properties.Valid << vpOwner;
-    }
-    else if (Properties.Valid.Contains(vpOwner) &&
-             !Properties.Valid.Contains(vpGroup))
-    {
-      Properties.Group = File->Group;
-      Properties.Valid << vpGroup;
-    }
-
     TSFTPPacket Packet(SSH_FXP_SETSTAT);
     AddPathString(Packet, RealFileName);
-    Packet.AddProperties(&Properties, *File->Rights, File->IsDirectory, FVersion, FUtfStrings, &Action);
+    AddSetStatProperties(Packet, File, AProperties, &Action);
     SendPacketAndReceiveResponse(&Packet, &Packet, SSH_FXP_STATUS);
   }
   __finally
@@ -4149,6 +4525,29 @@ void __fastcall TSFTPFileSystem::ChangeFileProperties(const UnicodeString FileNa
   }
 }
 //---------------------------------------------------------------------------
+void TSFTPFileSystem::AddSetStatProperties(
+  TSFTPPacket & Packet, const TRemoteFile * File, const TRemoteProperties * AProperties, TChmodSessionAction * Action)
+{
+  // SFTP can change owner and group at the same time only, not individually.
+  // Fortunately we know current owner/group, so if only one is present,
+  // we can supplement the other.
+  TRemoteProperties Properties(*AProperties);
+  if (Properties.Valid.Contains(vpGroup) &&
+      !Properties.Valid.Contains(vpOwner))
+  {
+    Properties.Owner = File->Owner;
+    Properties.Valid << vpOwner;
+  }
+  else if (Properties.Valid.Contains(vpOwner) &&
+           !Properties.Valid.Contains(vpGroup))
+  {
+    Properties.Group = File->Group;
+    Properties.Valid << vpGroup;
+  }
+
+  Packet.AddProperties(&Properties, *File->Rights, File->IsDirectory, FVersion, FUtfStrings, Action);
+}
+//---------------------------------------------------------------------------
 bool __fastcall TSFTPFileSystem::LoadFilesProperties(TStrings * FileList)
 {
   bool Result = false;
@@ -4643,7 +5042,8 @@ void __fastcall TSFTPFileSystem::Source(
     CopyParam->AllowResume(OperationProgress->LocalSize, DestFileName) &&
     IsCapable(fcRename) &&
     !FTerminal->IsEncryptingFiles() &&
-    (CopyParam->OnTransferIn == NULL);
+    (CopyParam->OnTransferIn == NULL) &&
+    (CopyParam->PartOffset < 0);
 
   TOpenRemoteFileParams OpenParams;
   OpenParams.OverwriteMode = omOverwrite;
@@ -4771,7 +5171,10 @@ void __fastcall TSFTPFileSystem::Source(
   OpenParams.CopyParam = CopyParam;
   OpenParams.Params = Params;
   OpenParams.FileParams = &FileParams;
-  OpenParams.Confirmed = (CopyParam->OnTransferIn != NULL) && FLAGCLEAR(Params, cpAppend);
+  OpenParams.Confirmed =
+    ((CopyParam->OnTransferIn != NULL) && FLAGCLEAR(Params, cpAppend)) ||
+    // Confirmed by TTerminal::CheckParallelFileUpload already
+    (CopyParam->PartOffset >= 0);
   OpenParams.DontRecycle = false;
   OpenParams.Recycled = false;
 
@@ -4800,10 +5203,19 @@ void __fastcall TSFTPFileSystem::Source(
   bool TransferFinished = false;
   __int64 DestWriteOffset = 0;
   TSFTPPacket CloseRequest;
-  bool PreserveRights = CopyParam->PreserveRights && (CopyParam->OnTransferIn == NULL);
+  // Properties of a file uploaded in parallel are set only once all its parts are done
+  bool PartUpload = (CopyParam->PartOffset >= 0);
+  // A part reaching the end of the local file may be overwriting a longer file in place
+  // (see TTerminal::CopyRangesToRemote), so it sets the file size too.
+  // The last part of a parallel upload goes "until the EOF" instead.
+  bool PartTruncate =
+    PartUpload && (CopyParam->PartSize >= 0) && (CopyParam->PartOffset + CopyParam->PartSize == Handle.Size);
+  TSFTPPacket SizeRequest(SSH_FXP_FSETSTAT);
+  TSFTPPacket SizeResponse;
+  bool PreserveRights = CopyParam->PreserveRights && (CopyParam->OnTransferIn == NULL) && !PartUpload;
   bool PreserveExistingRights = (DoResume && DestFileExists) || OpenParams.Recycled;
   bool SetRights = (PreserveExistingRights || PreserveRights);
-  bool PreserveTime = CopyParam->PreserveTime && (CopyParam->OnTransferIn == NULL);
+  bool PreserveTime = CopyParam->PreserveTime && (CopyParam->OnTransferIn == NULL) && !PartUpload;
   bool SetProperties = (PreserveTime || SetRights);
   TSFTPPacket PropertiesRequest(SSH_FXP_SETSTAT);
   TSFTPPacket PropertiesResponse;
@@ -4840,7 +5252,12 @@ void __fastcall TSFTPFileSystem::Source(
 
   try
   {
-    if (OpenParams.OverwriteMode == omAppend)
+    if (PartUpload)
+    {
+      FileSeek(reinterpret_cast<THandle>(Handle.Handle), CopyParam->PartOffset, soBeginning);
+      DestWriteOffset = CopyParam->PartOffset;
+    }
+    else if (OpenParams.OverwriteMode == omAppend)
     {
       FTerminal->LogEvent(L"Appending file.");
       DestWriteOffset = OpenParams.DestFileSize;
@@ -4865,9 +5282,10 @@ void __fastcall TSFTPFileSystem::Source(
       int ConvertParams =
         FLAGMASK(CopyParam->RemoveCtrlZ, cpRemoveCtrlZ) |
         FLAGMASK(CopyParam->RemoveBOM, cpRemoveBOM);
+      __int64 EndPosition = (PartUpload && (CopyParam->PartSize >= 0)) ? (CopyParam->PartOffset + CopyParam->PartSize) : -1;
       Queue.Init(Handle.FileName, Handle.Handle, CopyParam->OnTransferIn, OperationProgress,
         OpenParams.RemoteFileHandle,
-        DestWriteOffset + OperationProgress->TransferredSize,
+        DestWriteOffset + OperationProgress->TransferredSize, EndPosition,
         ConvertParams);
 
       while (Queue.Continue())
@@ -4885,6 +5303,21 @@ void __fastcall TSFTPFileSystem::Source(
         }
       }
 
+      if (PartTruncate)
+      {
+        FTerminal->LogEvent(FORMAT(L"Setting file size to %s.", (IntToStr(Handle.Size))));
+        SizeRequest.AddString(OpenParams.RemoteFileHandle);
+        // Not using AddProperties as with SFTP-6 it would set the allocation size
+        SizeRequest.AddCardinal(SSH_FILEXFER_ATTR_SIZE);
+        if (FVersion >= 4)
+        {
+          SizeRequest.AddByte(SSH_FILEXFER_TYPE_REGULAR);
+        }
+        SizeRequest.AddInt64(Handle.Size);
+        SendPacket(&SizeRequest);
+        ReserveResponse(&SizeRequest, &SizeResponse);
+      }
+
       // send close request before waiting for pending read responses
       SFTPCloseRemote(OpenParams.RemoteFileHandle, DestFileName,
         OperationProgress, false, true, &CloseRequest);
@@ -4899,6 +5332,11 @@ void __fastcall TSFTPFileSystem::Source(
       }
       // No error so far, processes pending responses and throw on first error
       Queue.DisposeSafeWithErrorHandling();
+
+      if (PartTruncate)
+      {
+        ReceiveResponse(&SizeRequest, &SizeResponse, SSH_FXP_STATUS);
+      }
     }
     __finally
     {
@@ -4927,7 +5365,8 @@ void __fastcall TSFTPFileSystem::Source(
       // delete file if transfer was not completed, resuming was not allowed and
       // we were not appending (incl. alternate resume),
       // shortly after plain transfer completes (eq. !ResumeAllowed)
-      if (!TransferFinished && !DoResume && (OpenParams.OverwriteMode == omOverwrite))
+      // (the partial file of a parallel upload is shared by all parts)
+      if (!TransferFinished && !DoResume && (OpenParams.OverwriteMode == omOverwrite) && !PartUpload)
       {
         DoDeleteFile(OpenParams.RemoteFileName, SSH_FXP_REMOVE);
       }
@@ -5126,15 +5565,18 @@ int __fastcall TSFTPFileSystem::SFTPOpenRemote(void * AOpenParams, void * /*Para
         !OpenParams->Confirmed && !OpenParams->Resume &&
         FTerminal->CheckRemoteFile(OpenParams->FileName, OpenParams->CopyParam, OpenParams->Params, OperationProgress);
       OpenType = SSH_FXF_WRITE | SSH_FXF_CREAT;
+      // All parts of a parallel upload write to the same file,
+      // so it must be opened neither exclusively, nor truncated
+      bool Part = (OpenParams->CopyParam->PartOffset >= 0);
       // when we want to preserve overwritten files, we need to find out that
       // they exist first... even if overwrite confirmation is disabled.
       // but not when we already know we are not going to overwrite (but e.g. to append)
       if ((ConfirmOverwriting || (FTerminal->SessionData->OverwrittenToRecycleBin && !OpenParams->DontRecycle)) &&
-          (OpenParams->OverwriteMode == omOverwrite))
+          (OpenParams->OverwriteMode == omOverwrite) && !Part)
       {
         OpenType |= SSH_FXF_EXCL;
       }
-      else if (!OpenParams->Resuming && (OpenParams->OverwriteMode == omOverwrite))
+      else if (!OpenParams->Resuming && (OpenParams->OverwriteMode == omOverwrite) && !Part)
       {
         OpenType |= SSH_FXF_TRUNC;
       }
@@ -5525,7 +5967,8 @@ void __fastcall TSFTPFileSystem::Sink(
       }
     }
 
-    if ((Attrs >= 0) && !ResumeTransfer)
+    // The preallocated target of a parallel transfer exists by definition
+    if ((Attrs >= 0) && !ResumeTransfer && !CopyParam->PartPreallocated)
     {
       __int64 DestFileSize;
       __int64 MTime;
@@ -5595,8 +6038,25 @@ void __fastcall TSFTPFileSystem::Sink(
 
     if (CopyParam->OnTransferOut == NULL)
     {
+      if (CopyParam->PartPreallocated)
+      {
+        DebugAssert(!LocalHandle && (CopyParam->PartOffset >= 0));
+        // Other parts are being written to the same file in parallel
+        FILE_OPERATION_LOOP_BEGIN
+        {
+          LocalHandle = CreateFile(ApiPath(LocalFileName).c_str(), GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, 0);
+          if (LocalHandle == INVALID_HANDLE_VALUE)
+          {
+            LocalHandle = NULL;
+            RaiseLastOSError();
+          }
+        }
+        FILE_OPERATION_LOOP_END(FMTLOAD(CREATE_FILE_ERROR, (LocalFileName)));
+        FileSeek(reinterpret_cast<THandle>(LocalHandle), CopyParam->PartOffset, soBeginning);
+      }
       // if not already opened (resume, append...), create new empty file
-      if (!LocalHandle)
+      else if (!LocalHandle)
       {
         if (!FTerminal->CreateLocalFile(LocalFileName, OperationProgress,
                &LocalHandle, FLAGSET(Params, cpNoConfirmation)))
@@ -5606,7 +6066,8 @@ void __fastcall TSFTPFileSystem::Sink(
       }
       DebugAssert(LocalHandle);
 
-      DeleteLocalFile = true;
+      // Never delete the shared target, the parallel operation takes care of it
+      DeleteLocalFile = !CopyParam->PartPreallocated;
 
       FileStream = new TSafeHandleStream(reinterpret_cast<THandle>(LocalHandle));
     }
@@ -5781,7 +6242,14 @@ void __fastcall TSFTPFileSystem::Sink(
     if (CopyParam->OnTransferOut == NULL)
     {
       DebugAssert(LocalHandle);
-      if (CopyParam->PreserveTime)
+      if (CopyParam->PartPreallocated)
+      {
+        // The part gets recorded as complete in the resume map once we return,
+        // so make sure its data are really on the disk.
+        // The timestamp is set only once all parts are done.
+        FlushFileBuffers(LocalHandle);
+      }
+      else if (CopyParam->PreserveTime)
       {
         FTerminal->UpdateTargetTime(LocalHandle, Modification, ModificationFmt, FTerminal->SessionData->DSTMode);
       }
@@ -5805,7 +6273,10 @@ void __fastcall TSFTPFileSystem::Sink(
 
       DeleteLocalFile = false;
 
-      FTerminal->UpdateTargetAttrs(DestFullName, File, CopyParam, Attrs);
+      if (!CopyParam->PartPreallocated)
+      {
+        FTerminal->UpdateTargetAttrs(DestFullName, File, CopyParam, Attrs);
+      }
     }
 
   }
@@ -21,6 +21,7 @@ friend class TSFTPUploadQueue;
 friend class TSFTPDownloadQueue;
 friend class TSFTPLoadFilesPropertiesQueue;
 friend class TSFTPCalculateFilesChecksumQueue;
+friend class TSFTPFilesQueue;
 friend class TSFTPBusy;
 public:
   __fastcall TSFTPFileSystem(TTerminal * ATerminal, TSecureShell * SecureShell);
@@ -165,6 +166,17 @@ protected:
   void __fastcall ResetConnection();
   void __fastcall RegisterChecksumAlg(const UnicodeString & Alg, const UnicodeString & SftpAlg);
   void __fastcall DoDeleteFile(const UnicodeString FileName, unsigned char Type);
+  void AddSetStatProperties(
+    TSFTPPacket & Packet, const TRemoteFile * File, const TRemoteProperties * AProperties, TChmodSessionAction * Action);
+  void InitFilesQueueRequest(
+    TSFTPPacket & Packet, unsigned char Type, const UnicodeString & FileName, const TRemoteFile * File,
+    const TRemoteProperties * Properties, TFileOperation Operation);
+  void CopyDataRanges(const RawByteString & SourceRemoteHandle, const RawByteString & DestRemoteHandle, __int64 Size);
+  void ProcessFilesPipelined(
+    unsigned char Type, const TRemoteProperties * Properties, TStrings * Files, TStrings * Failed);
+  bool ProcessDirectoryPipelined(
+    const UnicodeString & DirName, unsigned char Type, const TRemoteProperties * Properties,
+    TProcessFileEvent CallBackFunc, void * Param);
 
   RawByteString __fastcall SFTPOpenRemoteFile(const UnicodeString & FileName,
     unsigned int OpenType, bool EncryptNewFiles = false, __int64 Size = -1);
@@ -577,6 +577,33 @@ bool TRobustOperationLoop::Retry()
   return Result;
 }
 //---------------------------------------------------------------------------
+TFileOperationFailureMonitor::TFileOperationFailureMonitor(TTerminal * Terminal)
+{
+  FTerminal = Terminal;
+  FFailed = false;
+  FOnFinished = FTerminal->OnFinished;
+  FTerminal->OnFinished = Finished;
+}
+//---------------------------------------------------------------------------
+TFileOperationFailureMonitor::~TFileOperationFailureMonitor()
+{
+  FTerminal->OnFinished = FOnFinished;
+}
+//---------------------------------------------------------------------------
+void __fastcall TFileOperationFailureMonitor::Finished(
+  TFileOperation Operation, TOperationSide Side, bool Temp, const UnicodeString & FileName, bool Success,
+  bool NotCancelled, TOnceDoneOperation & OnceDoneOperation)
+{
+  if (!Success)
+  {
+    FFailed = true;
+  }
+  if (FOnFinished != NULL)
+  {
+    FOnFinished(Operation, Side, Temp, FileName, Success, NotCancelled, OnceDoneOperation);
+  }
+}
+//---------------------------------------------------------------------------
 class TRetryOperationLoop
 {
 public:
@@ -767,16 +794,23 @@ void TCollectedFileList::SetState(int Index, int State)
 }
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
+static const int ParallelClientRetryDelay = 30 * MSecsPerSec;
+//---------------------------------------------------------------------------
 TParallelOperation::TParallelOperation(TOperationSide Side)
 {
   FCopyParam = NULL;
   FParams = 0;
   FProbablyEmpty = false;
   FClients = 0;
+  FClientsToDrop = 0;
+  FClientConnectionFailed = TDateTime();
   FMainOperationProgress = NULL;
   DebugAssert((Side == osLocal) || (Side == osRemote));
   FSide = Side;
   FVersion = 0;
+  // Manual reset, so that all connections waiting for a change are woken up
+  FChangeEvent = CreateEvent(NULL, true, false, NULL);
+  FChangeVersion = 0;
 }
 //---------------------------------------------------------------------------
 void TParallelOperation::Init(
@@ -803,11 +837,17 @@ void TParallelOperation::Init(
   FParallelFileCount = 0;
   FParallelFileMerging = false;
   FParallelFileMerged = 0;
+  FParallelFilePreallocate = FIsParallelFileTransfer && (FSide == osRemote) && Configuration->ParallelTransferPreallocate;
+  FParallelFilePartSize = -1;
+  FParallelFileResumed.clear();
+  FParallelFile = NULL;
+  FParallelFileSourceName = EmptyStr;
 }
 //---------------------------------------------------------------------------
 TParallelOperation::~TParallelOperation()
 {
   WaitFor();
+  CloseHandle(FChangeEvent);
 }
 //---------------------------------------------------------------------------
 bool TParallelOperation::IsInitialized()
@@ -826,7 +866,11 @@ bool TParallelOperation::ShouldAddClient()
   else
   {
     TGuard Guard(FSection.get());
-    Result = !FProbablyEmpty && (FMainOperationProgress->Cancel < csCancel);
+    Result =
+      !FProbablyEmpty && (FMainOperationProgress->Cancel < csCancel) &&
+      // Back off for a while after a client has failed to connect
+      ((FClientConnectionFailed == TDateTime()) ||
+       !WithinPastMilliSeconds(Now(), FClientConnectionFailed, ParallelClientRetryDelay));
   }
   return Result;
 }
@@ -841,6 +885,74 @@ void TParallelOperation::RemoveClient()
 {
   TGuard Guard(FSection.get());
   FClients--;
+  NotifyChange();
+}
+//---------------------------------------------------------------------------
+void TParallelOperation::DropClient()
+{
+  TGuard Guard(FSection.get());
+  // Any client can pick this, the one that completes its current file first
+  if (FClientsToDrop < FClients)
+  {
+    FClientsToDrop++;
+  }
+}
+//---------------------------------------------------------------------------
+bool TParallelOperation::ClientConnectionFailed()
+{
+  TGuard Guard(FSection.get());
+  // Only while the main operation goes on, the failure is likely caused by a server limit
+  // on a number of connections and the work gets done even without the client
+  bool Result = DebugAlwaysTrue(IsInitialized()) && (FMainOperationProgress->Cancel == csContinue);
+  if (Result)
+  {
+    // The client was added (AddClient), but it will never get to run and remove itself
+    FClients--;
+    FClientConnectionFailed = Now();
+    NotifyChange();
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+bool TParallelOperation::ShouldDropClient()
+{
+  TGuard Guard(FSection.get());
+  bool Result = (FClientsToDrop > 0);
+  if (Result)
+  {
+    FClientsToDrop--;
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+void TParallelOperation::NotifyChange()
+{
+  // Called with FSection acquired
+  FChangeVersion++;
+  SetEvent(FChangeEvent);
+}
+//---------------------------------------------------------------------------
+int TParallelOperation::GetChangeVersion()
+{
+  TGuard Guard(FSection.get());
+  return FChangeVersion;
+}
+//---------------------------------------------------------------------------
+void TParallelOperation::WaitForChange(int ChangeVersion, unsigned int Timeout)
+{
+  {
+    TGuard Guard(FSection.get());
+    if (FChangeVersion != ChangeVersion)
+    {
+      // Something has changed since the caller looked last, no need to wait
+      return;
+    }
+    ResetEvent(FChangeEvent);
+  }
+
+  // The timeout is only a safety net (and allows the caller to check for cancellation),
+  // normally we get woken up as soon as a directory is created or a client finishes
+  WaitForSingleObject(FChangeEvent, Timeout);
 }
 //---------------------------------------------------------------------------
 void TParallelOperation::WaitFor()
@@ -853,16 +965,18 @@ void TParallelOperation::WaitFor()
 
     do
     {
+      int ChangeVersion;
       {
         TGuard Guard(FSection.get());
         Done = (FClients == 0);
+        ChangeVersion = FChangeVersion;
       }
 
       if (!Done)
       {
         // propagate the total progress incremented by the parallel operations
         FMainOperationProgress->Progress();
-        Sleep(200);
+        WaitForChange(ChangeVersion, 200);
       }
     }
     while (!Done);
@@ -890,6 +1004,8 @@ void TParallelOperation::Done(
       {
         DebugAssert(!DirectoryIterator->second.Exists);
         DirectoryIterator->second.Exists = true;
+        // Wake up connections waiting for the directory to be created
+        NotifyChange();
       }
       else
       {
@@ -924,6 +1040,7 @@ void TParallelOperation::Done(
             }
           }
         }
+        NotifyChange();
       }
     }
   }
@@ -935,7 +1052,7 @@ void TParallelOperation::Done(
 
       try
       {
-        if (Success && DebugAlwaysTrue(FSide == osRemote))
+        if (Success)
         {
           TParallelFileOffsets::const_iterator I = std::find(FParallelFileOffsets.begin(), FParallelFileOffsets.end(), CopyParam->PartOffset);
           if (DebugAlwaysTrue(I != FParallelFileOffsets.end()))
@@ -944,7 +1061,53 @@ void TParallelOperation::Done(
             DebugAssert(!FParallelFileDones[Index]);
             FParallelFileDones[Index] = true;
 
-            if (!FParallelFileMerging)
+            if (FSide == osLocal)
+            {
+              if (IsParallelFileComplete())
+              {
+                // Only the last part to complete can get here
+                TUnguard Unguard(FSection.get());
+                try
+                {
+                  FinishParallelFileUpload(Terminal, TargetDir);
+                }
+                catch (...)
+                {
+                  Success = false;
+                  throw;
+                }
+              }
+            }
+            else if (FParallelFilePreallocate)
+            {
+              try
+              {
+                if ((CopyParam->PartSize >= 0) && (Terminal->OperationProgress->TransferredSize != CopyParam->PartSize))
+                {
+                  UnicodeString TransferredSizeStr = IntToStr(Terminal->OperationProgress->TransferredSize);
+                  UnicodeString PartSizeStr = IntToStr(CopyParam->PartSize);
+                  UnicodeString TargetNamePartial = CombinePaths(TargetDir, FParallelFileTargetName) + PartialExt;
+                  UnicodeString Message =
+                    FMTLOAD(INCONSISTENT_SIZE, (TargetNamePartial, TransferredSizeStr, PartSizeStr));
+                  Terminal->TerminalError(NULL, Message);
+                }
+
+                SaveParallelFileMap(TargetDir);
+
+                if (IsParallelFileComplete())
+                {
+                  // Only the last part to complete can get here
+                  TUnguard Unguard(FSection.get());
+                  FinishPreallocatedParallelFile(Terminal, TargetDir);
+                }
+              }
+              catch (...)
+              {
+                Success = false;
+                throw;
+              }
+            }
+            else if (!FParallelFileMerging)
             {
               // Once we obtain "merging" semaphore, we won't leave until everything is merged
               TAutoFlag MergingFlag(FParallelFileMerging);
@@ -1078,6 +1241,258 @@ UnicodeString TParallelOperation::GetPartPrefix(const UnicodeString & FileName)
   return FORMAT(L"%s%s.", (FileName, PartialExt));
 }
 //---------------------------------------------------------------------------
+UnicodeString TParallelOperation::GetParallelFileMapName(const UnicodeString & TargetName)
+{
+  return GetPartPrefix(TargetName) + L"map";
+}
+//---------------------------------------------------------------------------
+bool TParallelOperation::IsLastParallelFilePart(__int64 Remaining, __int64 PartSize)
+{
+  // Do not leave a tiny part for the end
+  return (PartSize >= Remaining) || (Remaining - PartSize < PartSize / 10);
+}
+//---------------------------------------------------------------------------
+int TParallelOperation::GetParallelFilePartCount()
+{
+  int Result = 1;
+  __int64 Offset = 0;
+  while (!IsLastParallelFilePart(FParallelFileSize - Offset, FParallelFilePartSize))
+  {
+    Offset += FParallelFilePartSize;
+    Result++;
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+bool TParallelOperation::IsParallelFileComplete()
+{
+  return
+    (FParallelFileOffset == FParallelFileSize) &&
+    (std::find(FParallelFileDones.begin(), FParallelFileDones.end(), false) == FParallelFileDones.end());
+}
+//---------------------------------------------------------------------------
+// Resume map (.filepart.map) layout: file size, part size, source timestamp (all __int64)
+// and then a bitmap of completed parts.
+static const int ParallelFileMapHeaderSize = 3 * sizeof(__int64);
+static const __int64 ParallelFilePreallocatedMaxPartSize = 1024 * 1024 * 1024;
+static const __int64 ParallelFileMaxParts = 1024 * 1024;
+//---------------------------------------------------------------------------
+__int64 TParallelOperation::GetParallelFileTimestamp()
+{
+  // Without a known source timestamp, the parts from a previous transfer cannot be trusted to belong to the same file
+  __int64 Result = -1;
+  if ((FParallelFile != NULL) && (FParallelFile->ModificationFmt != mfNone))
+  {
+    double Modification = FParallelFile->Modification.Val;
+    memcpy(&Result, &Modification, sizeof(Result));
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+void TParallelOperation::PreallocateParallelFile(TTerminal * Terminal, const UnicodeString & TargetDir)
+{
+  UnicodeString TargetName = CombinePaths(TargetDir, FParallelFileTargetName);
+  UnicodeString TargetNamePartial = TargetName + PartialExt;
+  UnicodeString MapName = GetParallelFileMapName(TargetName);
+  // With no merging, the parts can be smaller than a share of each connection,
+  // what balances the connections better and makes the resume more granular.
+  FParallelFilePartSize =
+    std::max(1LL, std::min(FParallelFileSize / std::max(Configuration->QueueTransfersLimit, 1), ParallelFilePreallocatedMaxPartSize));
+  try
+  {
+    __int64 Timestamp = GetParallelFileTimestamp();
+    if (FCopyParam->AllowResume(FParallelFileSize, FParallelFileTargetName) &&
+        (Timestamp != -1) &&
+        ::FileExists(ApiPath(MapName)) && ::FileExists(ApiPath(TargetNamePartial)))
+    {
+      std::unique_ptr<THandleStream> MapStream(TSafeHandleStream::CreateFromFile(MapName, fmOpenRead | fmShareDenyWrite));
+      std::unique_ptr<THandleStream> PartialStream(TSafeHandleStream::CreateFromFile(TargetNamePartial, fmOpenRead | fmShareDenyNone));
+      __int64 MapSize = MapStream->Size;
+      __int64 Header[3];
+      if ((MapSize >= ParallelFileMapHeaderSize) &&
+          (MapStream->Read(Header, ParallelFileMapHeaderSize) == ParallelFileMapHeaderSize) &&
+          (Header[0] == FParallelFileSize) && (Header[1] > 0) &&
+          // The source file may have changed without changing its size
+          (Header[2] == Timestamp) &&
+          (FParallelFileSize / Header[1] < ParallelFileMaxParts) &&
+          (PartialStream->Size == FParallelFileSize))
+      {
+        __int64 PartSize = FParallelFilePartSize;
+        FParallelFilePartSize = Header[1];
+        int Count = GetParallelFilePartCount();
+        int BitmapSize = (Count + 7) / 8;
+        RawByteString Bitmap;
+        Bitmap.SetLength(BitmapSize);
+        if ((MapSize == ParallelFileMapHeaderSize + BitmapSize) &&
+            (MapStream->Read(Bitmap.c_str(), BitmapSize) == BitmapSize))
+        {
+          FParallelFileResumed.resize(Count);
+          int Resumed = 0;
+          for (int Index = 0; Index < Count; Index++)
+          {
+            FParallelFileResumed[Index] = FLAGSET(static_cast<unsigned char>(Bitmap[(Index / 8) + 1]), 1 << (Index % 8));
+            if (FParallelFileResumed[Index])
+            {
+              Resumed++;
+            }
+          }
+          Terminal->LogEvent(FORMAT(L"Resuming transfer of \"%s\", %d of %d parts were already transferred.", (FParallelFileTargetName, Resumed, Count)));
+        }
+        else
+        {
+          FParallelFilePartSize = PartSize;
+        }
+      }
+    }
+
+    if (FParallelFileResumed.empty())
+    {
+      Terminal->LogEvent(FORMAT(L"Preallocating \"%s\" for parallel transfer of %s bytes.", (TargetNamePartial, IntToStr(FParallelFileSize))));
+      HANDLE Handle =
+        CreateFile(ApiPath(TargetNamePartial).c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+      if (Handle == INVALID_HANDLE_VALUE)
+      {
+        RaiseLastOSError();
+      }
+      try
+      {
+        // As the parts are written out of order, make the file sparse,
+        // so that NTFS does not have to zero-fill the gap in front of each write.
+        // Where not supported, the file gets just extended.
+        DWORD BytesReturned;
+        if (!DeviceIoControl(Handle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &BytesReturned, NULL))
+        {
+          Terminal->LogEvent(FORMAT(L"Cannot make the file sparse: %s", (SysErrorMessageForError(GetLastError()))));
+        }
+        LARGE_INTEGER Size;
+        Size.QuadPart = FParallelFileSize;
+        if (!SetFilePointerEx(Handle, Size, NULL, FILE_BEGIN) ||
+            !SetEndOfFile(Handle))
+        {
+          RaiseLastOSError();
+        }
+      }
+      __finally
+      {
+        CloseHandle(Handle);
+      }
+
+      FParallelFileResumed.resize(GetParallelFilePartCount(), false);
+      SaveParallelFileMap(TargetDir);
+    }
+  }
+  catch (Exception & E)
+  {
+    Terminal->LogEvent(FORMAT(L"Cannot preallocate \"%s\", will merge part files instead: %s", (TargetNamePartial, E.Message)));
+    FParallelFilePreallocate = false;
+    FParallelFileResumed.clear();
+  }
+}
+//---------------------------------------------------------------------------
+void TParallelOperation::SkipResumedParallelFileParts(TTerminal * Terminal)
+{
+  // The last part is always transferred, as its completion finalizes the file
+  while ((FParallelFileCount < static_cast<int>(FParallelFileResumed.size())) &&
+         FParallelFileResumed[FParallelFileCount] &&
+         !IsLastParallelFilePart(FParallelFileSize - FParallelFileOffset, FParallelFilePartSize))
+  {
+    Terminal->LogEvent(FORMAT(L"Skipping already transferred part %d of \"%s\".", (FParallelFileCount, FParallelFileTargetName)));
+    FParallelFileOffsets.push_back(FParallelFileOffset);
+    FParallelFileDones.push_back(true);
+    FParallelFileCount++;
+    FParallelFileOffset += FParallelFilePartSize;
+    FMainOperationProgress->AddSkipped(FParallelFilePartSize);
+  }
+}
+//---------------------------------------------------------------------------
+void TParallelOperation::SaveParallelFileMap(const UnicodeString & TargetDir)
+{
+  int Count = static_cast<int>(FParallelFileResumed.size());
+  RawByteString Buf;
+  Buf.SetLength(ParallelFileMapHeaderSize + (Count + 7) / 8);
+  memset(Buf.c_str(), 0, Buf.Length());
+  __int64 * Header = reinterpret_cast<__int64 *>(Buf.c_str());
+  Header[0] = FParallelFileSize;
+  Header[1] = FParallelFilePartSize;
+  Header[2] = GetParallelFileTimestamp();
+  unsigned char * Bitmap = reinterpret_cast<unsigned char *>(Buf.c_str()) + ParallelFileMapHeaderSize;
+  for (int Index = 0; Index < Count; Index++)
+  {
+    bool Done =
+      FParallelFileResumed[Index] ||
+      ((Index < static_cast<int>(FParallelFileDones.size())) && FParallelFileDones[Index]);
+    if (Done)
+    {
+      Bitmap[Index / 8] |= static_cast<unsigned char>(1 << (Index % 8));
+    }
+  }
+
+  UnicodeString MapName = GetParallelFileMapName(CombinePaths(TargetDir, FParallelFileTargetName));
+  std::unique_ptr<THandleStream> MapStream(TSafeHandleStream::CreateFromFile(MapName, fmCreate | fmShareDenyWrite));
+  MapStream->WriteBuffer(Buf.c_str(), Buf.Length());
+  FlushFileBuffers(reinterpret_cast<HANDLE>(MapStream->Handle));
+}
+//---------------------------------------------------------------------------
+void TParallelOperation::FinishPreallocatedParallelFile(TTerminal * Terminal, const UnicodeString & TargetDir)
+{
+  UnicodeString TargetName = CombinePaths(TargetDir, FParallelFileTargetName);
+  UnicodeString TargetNamePartial = TargetName + PartialExt;
+
+  HANDLE Handle;
+  Terminal->OpenLocalFile(TargetNamePartial, GENERIC_WRITE, NULL, &Handle, NULL, NULL, NULL, NULL);
+  try
+  {
+    // Nothing is missing now, so there's no point keeping the file sparse
+    FILE_SET_SPARSE_BUFFER SparseBuffer;
+    SparseBuffer.SetSparse = FALSE;
+    DWORD BytesReturned;
+    DeviceIoControl(Handle, FSCTL_SET_SPARSE, &SparseBuffer, sizeof(SparseBuffer), NULL, 0, &BytesReturned, NULL);
+
+    if (FCopyParam->PreserveTime && DebugAlwaysTrue(FParallelFile != NULL))
+    {
+      Terminal->UpdateTargetTime(Handle, FParallelFile->Modification, FParallelFile->ModificationFmt, Terminal->SessionData->DSTMode);
+    }
+  }
+  __finally
+  {
+    CloseHandle(Handle);
+  }
+
+  Terminal->LogEvent(FORMAT(L"Renaming completed \"%s\" to \"%s\"...", (ExtractFileName(TargetNamePartial), FParallelFileTargetName)));
+  Terminal->DoRenameLocalFileForce(TargetNamePartial, TargetName);
+  Terminal->DoDeleteLocalFile(GetParallelFileMapName(TargetName));
+  if (DebugAlwaysTrue(FParallelFile != NULL))
+  {
+    Terminal->UpdateTargetAttrs(TargetName, FParallelFile, FCopyParam, -1);
+  }
+}
+//---------------------------------------------------------------------------
+void TParallelOperation::FinishParallelFileUpload(TTerminal * Terminal, const UnicodeString & TargetDir)
+{
+  UnicodeString TargetName = UnixCombinePaths(TargetDir, FParallelFileTargetName);
+  UnicodeString TargetNamePartial = TargetName + PartialExt;
+
+  // Overwrite was confirmed already before the transfer started (see CheckParallelFileUpload)
+  std::unique_ptr<TRemoteFile> File(Terminal->TryReadFile(TargetName));
+  if (File.get() != NULL)
+  {
+    if (Terminal->SessionData->OverwrittenToRecycleBin &&
+        !Terminal->SessionData->RecycleBinPath.IsEmpty())
+    {
+      Terminal->RecycleFile(TargetName, NULL);
+    }
+    else
+    {
+      Terminal->DoDeleteFile(Terminal->FFileSystem, TargetName, NULL, dfNoRecursive);
+    }
+  }
+
+  Terminal->LogEvent(FORMAT(L"Renaming completed \"%s\" to \"%s\"...", (UnixExtractFileName(TargetNamePartial), FParallelFileTargetName)));
+  Terminal->DoRenameFile(TargetNamePartial, NULL, TargetName, false, false);
+
+  Terminal->UpdateUploadedFileAttrs(FParallelFileSourceName, TargetName, FCopyParam);
+}
+//---------------------------------------------------------------------------
 int TParallelOperation::GetNext(
   TTerminal * Terminal, UnicodeString & FileName, TObject *& Object, UnicodeString & TargetDir, bool & Dir,
   bool & Recursed, TCopyParamType *& CustomCopyParam)
@@ -1176,25 +1591,50 @@ int TParallelOperation::GetNext(
       bool Processed = true;
       if (IsParallelFileTransfer)
       {
-        CustomCopyParam = new TCopyParamType(*FCopyParam);
-        CustomCopyParam->PartOffset = FParallelFileOffset;
-        __int64 Remaining = FParallelFileSize - CustomCopyParam->PartOffset;
-        CustomCopyParam->PartSize = FParallelFileSize / Configuration->QueueTransfersLimit;
         DebugAssert(!OnlyFileName.IsEmpty());
         if (FParallelFileTargetName.IsEmpty())
         {
           FParallelFileTargetName = OnlyFileName;
+          FParallelFileSourceName = FileName;
+          if (FParallelFilePreallocate)
+          {
+            FParallelFile = static_cast<TRemoteFile *>(Object);
+            PreallocateParallelFile(Terminal, TargetDir);
+          }
         }
         DebugAssert(FParallelFileTargetName == OnlyFileName);
+        if (FParallelFilePreallocate)
+        {
+          SkipResumedParallelFileParts(Terminal);
+        }
+        CustomCopyParam = new TCopyParamType(*FCopyParam);
+        CustomCopyParam->PartOffset = FParallelFileOffset;
+        __int64 Remaining = FParallelFileSize - CustomCopyParam->PartOffset;
         int Index = FParallelFileCount;
-        UnicodeString PartFileName = GetPartPrefix(OnlyFileName) + IntToStr(Index);
+        UnicodeString PartFileName;
+        if (FParallelFilePreallocate)
+        {
+          CustomCopyParam->PartSize = FParallelFilePartSize;
+          CustomCopyParam->PartPreallocated = true;
+          PartFileName = OnlyFileName + PartialExt;
+        }
+        else if (FSide == osLocal)
+        {
+          // All parts of an upload are written to the same remote partial file
+          CustomCopyParam->PartSize = FParallelFileSize / Configuration->QueueTransfersLimit;
+          PartFileName = OnlyFileName + PartialExt;
+        }
+        else
+        {
+          CustomCopyParam->PartSize = FParallelFileSize / Configuration->QueueTransfersLimit;
+          PartFileName = GetPartPrefix(OnlyFileName) + IntToStr(Index);
+        }
         FParallelFileCount++;
         FParallelFileOffsets.push_back(CustomCopyParam->PartOffset);
         FParallelFileDones.push_back(false);
         DebugAssert(FParallelFileOffsets.size() == static_cast<size_t>(FParallelFileCount));
         CustomCopyParam->FileMask = DelimitFileNameMask(PartFileName);
-        if ((CustomCopyParam->PartSize >= Remaining) ||
-            (Remaining - CustomCopyParam->PartSize < CustomCopyParam->PartSize / 10))
+        if (IsLastParallelFilePart(Remaining, CustomCopyParam->PartSize))
         {
           CustomCopyParam->PartSize = -1; // Until the end
           FParallelFileOffset = FParallelFileSize;
@@ -4584,38 +5024,43 @@ void __fastcall TTerminal::ChangeFileProperties(UnicodeString FileName,
     FileName = File->FileName;
   }
   StartOperationWithFile(FileName, foSetProperties);
+  LogChangeFileProperties(FileName, RProperties);
+  FileModified(File, FileName);
+  DoChangeFileProperties(FileName, File, RProperties);
+  ReactOnCommand(fsChangeProperties);
+}
+//---------------------------------------------------------------------------
+void TTerminal::LogChangeFileProperties(const UnicodeString & FileName, const TRemoteProperties * Properties)
+{
   if (Log->Logging)
   {
     LogEvent(FORMAT(L"Changing properties of \"%s\" (%s)",
-      (FileName, BooleanToEngStr(RProperties->Recursive))));
-    if (RProperties->Valid.Contains(vpRights))
+      (FileName, BooleanToEngStr(Properties->Recursive))));
+    if (Properties->Valid.Contains(vpRights))
     {
-      LogEvent(FORMAT(L" - mode: \"%s\"", (RProperties->Rights.ModeStr)));
+      LogEvent(FORMAT(L" - mode: \"%s\"", (Properties->Rights.ModeStr)));
     }
-    if (RProperties->Valid.Contains(vpGroup))
+    if (Properties->Valid.Contains(vpGroup))
     {
-      LogEvent(FORMAT(L" - group: %s", (RProperties->Group.LogText)));
+      LogEvent(FORMAT(L" - group: %s", (Properties->Group.LogText)));
     }
-    if (RProperties->Valid.Contains(vpOwner))
+    if (Properties->Valid.Contains(vpOwner))
     {
-      LogEvent(FORMAT(L" - owner: %s", (RProperties->Owner.LogText)));
+      LogEvent(FORMAT(L" - owner: %s", (Properties->Owner.LogText)));
     }
-    if (RProperties->Valid.Contains(vpModification))
+    if (Properties->Valid.Contains(vpModification))
     {
       LogEvent(FORMAT(L" - modification: \"%s\"",
         (FormatDateTime(L"dddddd tt",
-           UnixToDateTime(RProperties->Modification, SessionData->DSTMode)))));
+           UnixToDateTime(Properties->Modification, SessionData->DSTMode)))));
     }
-    if (RProperties->Valid.Contains(vpLastAccess))
+    if (Properties->Valid.Contains(vpLastAccess))
     {
       LogEvent(FORMAT(L" - last access: \"%s\"",
         (FormatDateTime(L"dddddd tt",
-           UnixToDateTime(RProperties->LastAccess, SessionData->DSTMode)))));
+           UnixToDateTime(Properties->LastAccess, SessionData->DSTMode)))));
     }
   }
-  FileModified(File, FileName);
-  DoChangeFileProperties(FileName, File, RProperties);
-  ReactOnCommand(fsChangeProperties);
 }
 //---------------------------------------------------------------------------
 void __fastcall TTerminal::DoChangeFileProperties(const UnicodeString FileName,
@@ -7521,6 +7966,7 @@ void __fastcall TTerminal::CopyParallel(TParallelOperation * ParallelOperation,
     bool Continue = true;
     do
     {
+      int ChangeVersion = ParallelOperation->GetChangeVersion();
       int GotNext = CopyToParallel(ParallelOperation, OperationProgress);
       if (GotNext < 0)
       {
@@ -7528,7 +7974,7 @@ void __fastcall TTerminal::CopyParallel(TParallelOperation * ParallelOperation,
       }
       else if (GotNext == 0)
       {
-        Sleep(100);
+        ParallelOperation->WaitForChange(ChangeVersion, 100);
       }
     }
     while (Continue && !OperationProgress->Cancel);
@@ -7653,9 +8099,21 @@ bool __fastcall TTerminal::CopyToRemote(
 
         if (Parallel)
         {
-          // OnceDoneOperation is not supported
-          ParallelOperation->Init(Files.release(), TargetDir, CopyParam, Params, &OperationProgress, Log->Name, -1);
-          CopyParallel(ParallelOperation, &OperationProgress);
+          __int64 ParallelFileSize = -1;
+          CheckParallelFileUpload(TargetDir, Files.get(), CopyParam, Params, ParallelFileSize, &OperationProgress);
+
+          if (OperationProgress.Cancel == csContinue)
+          {
+            if (ParallelFileSize >= 0)
+            {
+              DebugAssert(ParallelFileSize == Size);
+              Params |= cpNoConfirmation;
+            }
+
+            // OnceDoneOperation is not supported
+            ParallelOperation->Init(Files.release(), TargetDir, CopyParam, Params, &OperationProgress, Log->Name, ParallelFileSize);
+            CopyParallel(ParallelOperation, &OperationProgress);
+          }
         }
         else
         {
@@ -8049,7 +8507,8 @@ void __fastcall TTerminal::Source(
     {
       LogEvent(FORMAT(L"Copying \"%s\" to remote directory started.", (FileName)));
 
-      OperationProgress->SetLocalSize(Handle.Size);
+      __int64 LocalSize = (CopyParam->PartSize >= 0) ? CopyParam->PartSize : (Handle.Size - std::max(0LL, CopyParam->PartOffset));
+      OperationProgress->SetLocalSize(LocalSize);
 
       // Suppose same data size to transfer as to read
       // (not true with ASCII transfer)
@@ -8129,6 +8588,180 @@ void TTerminal::CheckParallelFileTransfer(
   }
 }
 //---------------------------------------------------------------------------
+void TTerminal::CheckParallelFileUpload(
+  const UnicodeString & TargetDir, TStringList * Files, const TCopyParamType * CopyParam, int Params,
+  __int64 & ParallelFileSize, TFileOperationProgressType * OperationProgress)
+{
+  UnicodeString ParallelFileName;
+  TObject * ParallelObject = NULL;
+  if ((Configuration->ParallelTransferThreshold > 0) &&
+      FFileSystem->IsCapable(fcParallelFileTransfers) &&
+      IsCapable[fcRename] &&
+      (CopyParam->OnTransferIn == NULL) &&
+      TParallelOperation::GetOnlyFile(Files, ParallelFileName, ParallelObject))
+  {
+    TLocalFileHandle Handle;
+    OpenLocalFile(ParallelFileName, GENERIC_READ, Handle);
+    Handle.Close();
+
+    if (Handle.Size >= static_cast<__int64>(Configuration->ParallelTransferThreshold) * 1024)
+    {
+      UnicodeString BaseFileName = GetBaseFileName(ParallelFileName);
+      TFileMasks::TParams MaskParams;
+      MaskParams.Size = Handle.Size;
+      MaskParams.Modification = Handle.Modification;
+      if (!UseAsciiTransfer(BaseFileName, osLocal, CopyParam, MaskParams))
+      {
+        UnicodeString TargetFileName = CopyParam->ChangeFileName(ExtractFileName(ParallelFileName), osLocal, true);
+        UnicodeString DestFullName = UnixCombinePaths(TargetDir, TargetFileName);
+
+        std::unique_ptr<TRemoteFile> File(TryReadFile(DestFullName));
+        if (File.get() != NULL)
+        {
+          TSuspendFileOperationProgress Suspend(OperationProgress);
+
+          TOverwriteFileParams FileParams;
+          FileParams.SourceSize = Handle.Size;
+          FileParams.SourceTimestamp = Handle.Modification;
+          FileParams.DestSize = File->Size;
+          FileParams.DestTimestamp = File->Modification;
+          FileParams.DestPrecision = File->ModificationFmt;
+          int Answers = qaYes | qaNo | qaCancel;
+          TQueryParams QueryParams(qpNeverAskAgainCheck);
+          unsigned int Answer =
+            ConfirmFileOverwrite(
+              ParallelFileName, TargetFileName, &FileParams, Answers, &QueryParams, osLocal,
+              CopyParam, Params, OperationProgress, EmptyStr);
+          switch (Answer)
+          {
+            case qaCancel:
+            case qaNo:
+              OperationProgress->SetCancelAtLeast(csCancel);
+              break;
+          }
+        }
+
+        if (OperationProgress->Cancel == csContinue)
+        {
+          ParallelFileSize = Handle.Size;
+
+          // The parts open the partial file without truncating it, so it must not contain any leftovers
+          UnicodeString DestPartialFullName = DestFullName + PartialExt;
+          if (FileExists(DestPartialFullName))
+          {
+            DoDeleteFile(FFileSystem, DestPartialFullName, NULL, dfNoRecursive);
+          }
+        }
+      }
+    }
+  }
+}
+//---------------------------------------------------------------------------
+void TTerminal::UpdateUploadedFileAttrs(
+  const UnicodeString & SourceFileName, const UnicodeString & TargetName, const TCopyParamType * CopyParam)
+{
+  TRemoteProperties Properties;
+  int Attrs;
+  OpenLocalFile(
+    SourceFileName, GENERIC_READ, &Attrs, NULL, NULL, &Properties.Modification, &Properties.LastAccess, NULL);
+  if (CopyParam->PreserveTime)
+  {
+    Properties.Valid << vpModification;
+  }
+  if (CopyParam->PreserveRights)
+  {
+    Properties.Valid << vpRights;
+    Properties.Rights = CopyParam->RemoteFileRights(Attrs);
+  }
+  if (!Properties.Valid.Empty())
+  {
+    try
+    {
+      ChangeFileProperties(TargetName, NULL, &Properties);
+    }
+    catch (Exception & E)
+    {
+      if (Active && CopyParam->IgnorePermErrors)
+      {
+        LogEvent(FORMAT(L"Ignoring error preserving properties of \"%s\": %s", (TargetName, E.Message)));
+      }
+      else
+      {
+        throw;
+      }
+    }
+  }
+}
+//---------------------------------------------------------------------------
+bool TTerminal::CopyRangesToRemote(
+  const UnicodeString & FileName, const UnicodeString & TargetDir, const TCopyParamType * CopyParam, int Params,
+  const TFileRanges & Ranges, __int64 DestSize, const TDateTime & DestModification)
+{
+  std::unique_ptr<TStrings> FilesToCopy(new TStringList());
+  FilesToCopy->Add(FileName);
+
+  bool InPlace = false;
+  UnicodeString DestFullName;
+  // Parts are written in place without truncating the file, what only the parallel upload support allows
+  // (see TSFTPFileSystem::Source).
+  // Unlike with the whole file upload via a temporary file, if the connection is lost while writing the parts,
+  // the remote file is left with a mix of the old and the new contents (until the next successful upload).
+  // So this is not done, when the temporary file is explicitly requested for all files.
+  if (FFileSystem->IsCapable(fcParallelFileTransfers) &&
+      (CopyParam->OnTransferIn == NULL) &&
+      (CopyParam->ResumeSupport != rsOn))
+  {
+    TLocalFileHandle Handle;
+    OpenLocalFile(FileName, GENERIC_READ, Handle);
+    Handle.Close();
+
+    TFileMasks::TParams MaskParams;
+    MaskParams.Size = Handle.Size;
+    MaskParams.Modification = Handle.Modification;
+    if (!UseAsciiTransfer(GetBaseFileName(FileName), osLocal, CopyParam, MaskParams))
+    {
+      UnicodeString TargetFileName = CopyParam->ChangeFileName(ExtractFileName(FileName), osLocal, true);
+      DestFullName = UnixCombinePaths(TargetDir, TargetFileName);
+
+      // The ranges are relative to the previous upload, so the remote file must not have changed since
+      std::unique_ptr<TRemoteFile> File(TryReadFile(DestFullName));
+      InPlace =
+        (File.get() != NULL) && !File->IsSymLink &&
+        (File->Size == DestSize) && (File->Modification == DestModification);
+      if (!InPlace)
+      {
+        LogEvent(FORMAT(L"Remote file \"%s\" differs from the one previously uploaded, uploading whole file.", (DestFullName)));
+      }
+    }
+  }
+
+  bool Result;
+  if (!InPlace)
+  {
+    Result = CopyToRemote(FilesToCopy.get(), TargetDir, CopyParam, Params, NULL);
+  }
+  else
+  {
+    Result = true;
+    for (TFileRanges::const_iterator I = Ranges.begin(); Result && (I != Ranges.end()); ++I)
+    {
+      LogEvent(FORMAT(L"Uploading changed part of \"%s\" at %s of size %s.", (FileName, IntToStr(I->first), IntToStr(I->second))));
+      TCopyParamType PartCopyParam(*CopyParam);
+      PartCopyParam.PartOffset = I->first;
+      PartCopyParam.PartSize = I->second;
+      PartCopyParam.Size = I->second;
+      Result = CopyToRemote(FilesToCopy.get(), TargetDir, &PartCopyParam, Params, NULL);
+    }
+
+    // Properties are not set by the part uploads (and there are no parts, when only the timestamp has changed)
+    if (Result)
+    {
+      UpdateUploadedFileAttrs(FileName, DestFullName, CopyParam);
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
 bool __fastcall TTerminal::CopyToLocal(
   TStrings * FilesToCopy, const UnicodeString & TargetDir, const TCopyParamType * CopyParam, int Params,
   TParallelOperation * ParallelOperation)
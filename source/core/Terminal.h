@@ -35,6 +35,8 @@ class TQueueItem;
 class TTerminalUI;
 struct TSynchronizeFileData;
 typedef std::vector<__int64> TCalculatedSizes;
+// Offsets and sizes of file parts
+typedef std::vector<std::pair<__int64, __int64> > TFileRanges;
 //---------------------------------------------------------------------------
 typedef void __fastcall (__closure *TQueryUserEvent)
   (TObject * Sender, const UnicodeString Query, TStrings * MoreMessages, unsigned int Answers,
@@ -297,6 +299,7 @@ protected:
   bool __fastcall DoMoveFile(const UnicodeString & FileName, const TRemoteFile * File, /*const TMoveFileParams*/ void * Param);
   void __fastcall DoCopyFile(
     const UnicodeString & FileName, const TRemoteFile * File, const UnicodeString & NewName, bool DontOverwrite);
+  void LogChangeFileProperties(const UnicodeString & FileName, const TRemoteProperties * Properties);
   void __fastcall DoChangeFileProperties(const UnicodeString FileName,
     const TRemoteFile * File, const TRemoteProperties * Properties);
   void __fastcall DoChangeDirectory();
@@ -530,6 +533,11 @@ protected:
   void CheckParallelFileTransfer(
     const UnicodeString & TargetDir, TStringList * Files, const TCopyParamType * CopyParam, int Params,
     UnicodeString & ParallelFileName, __int64 & ParallelFileSize, TFileOperationProgressType * OperationProgress);
+  void CheckParallelFileUpload(
+    const UnicodeString & TargetDir, TStringList * Files, const TCopyParamType * CopyParam, int Params,
+    __int64 & ParallelFileSize, TFileOperationProgressType * OperationProgress);
+  void UpdateUploadedFileAttrs(
+    const UnicodeString & SourceFileName, const UnicodeString & TargetName, const TCopyParamType * CopyParam);
   TRemoteFile * CheckRights(const UnicodeString & EntryType, const UnicodeString & FileName, bool & WrongRights);
   bool IsValidFile(TRemoteFile * File);
   void __fastcall CalculateSubFoldersChecksum(
@@ -581,6 +589,9 @@ public:
   bool __fastcall CopyToRemote(
     TStrings * FilesToCopy, const UnicodeString & TargetDir, const TCopyParamType * CopyParam, int Params,
     TParallelOperation * ParallelOperation);
+  bool CopyRangesToRemote(
+    const UnicodeString & FileName, const UnicodeString & TargetDir, const TCopyParamType * CopyParam, int Params,
+    const TFileRanges & Ranges, __int64 DestSize, const TDateTime & DestModification);
   int __fastcall CopyToParallel(TParallelOperation * ParallelOperation, TFileOperationProgressType * OperationProgress);
   void __fastcall LogParallelTransfer(TParallelOperation * ParallelOperation);
   void __fastcall CreateDirectory(const UnicodeString & DirName, const TRemoteProperties * Properties);
@@ -871,6 +882,25 @@ private:
   bool FCanRetry;
 };
 //---------------------------------------------------------------------------
+// The result of the file operations does not tell if some files were skipped on error
+class TFileOperationFailureMonitor
+{
+public:
+  TFileOperationFailureMonitor(TTerminal * Terminal);
+  ~TFileOperationFailureMonitor();
+
+  __property bool Failed = { read = FFailed };
+
+private:
+  TTerminal * FTerminal;
+  TFileOperationFinished FOnFinished;
+  bool FFailed;
+
+  void __fastcall Finished(
+    TFileOperation Operation, TOperationSide Side, bool Temp, const UnicodeString & FileName, bool Success,
+    bool NotCancelled, TOnceDoneOperation & OnceDoneOperation);
+};
+//---------------------------------------------------------------------------
 class TCollectedFileList : public TObject
 {
 public:
@@ -921,6 +951,11 @@ public:
   bool ShouldAddClient();
   void AddClient();
   void RemoveClient();
+  void DropClient();
+  bool ShouldDropClient();
+  bool ClientConnectionFailed();
+  int GetChangeVersion();
+  void WaitForChange(int ChangeVersion, unsigned int Timeout);
   int GetNext(
     TTerminal * Terminal, UnicodeString & FileName, TObject *& Object, UnicodeString & TargetDir, bool & Dir,
     bool & Recursed, TCopyParamType *& CustomCopyParam);
@@ -957,7 +992,11 @@ private:
   int FParams;
   bool FProbablyEmpty;
   int FClients;
+  int FClientsToDrop;
+  TDateTime FClientConnectionFailed;
   std::unique_ptr<TCriticalSection> FSection;
+  HANDLE FChangeEvent;
+  int FChangeVersion;
   TFileOperationProgressType * FMainOperationProgress;
   TOperationSide FSide;
   UnicodeString FMainName;
@@ -972,9 +1011,25 @@ private:
   std::vector<bool> FParallelFileDones;
   bool FParallelFileMerging;
   int FParallelFileMerged;
+  bool FParallelFilePreallocate;
+  __int64 FParallelFilePartSize;
+  std::vector<bool> FParallelFileResumed;
+  const TRemoteFile * FParallelFile;
+  UnicodeString FParallelFileSourceName;
 
   bool CheckEnd(TCollectedFileList * Files);
   TCollectedFileList * GetFileList(int Index);
+  void NotifyChange();
+  void PreallocateParallelFile(TTerminal * Terminal, const UnicodeString & TargetDir);
+  void SkipResumedParallelFileParts(TTerminal * Terminal);
+  void SaveParallelFileMap(const UnicodeString & TargetDir);
+  __int64 GetParallelFileTimestamp();
+  void FinishPreallocatedParallelFile(TTerminal * Terminal, const UnicodeString & TargetDir);
+  void FinishParallelFileUpload(TTerminal * Terminal, const UnicodeString & TargetDir);
+  bool IsParallelFileComplete();
+  int GetParallelFilePartCount();
+  static bool IsLastParallelFilePart(__int64 Remaining, __int64 PartSize);
+  static UnicodeString GetParallelFileMapName(const UnicodeString & TargetName);
 };
 //---------------------------------------------------------------------------
 struct TLocalFileHandle
@@ -50,5 +50,6 @@
 #define OPTION_MPEXT_CERT_STORAGE 1013
 #define OPTION_MPEXT_WORK_FROM_CWD 1014
 #define OPTION_MPEXT_TRANSFER_SIZE 1015
+#define OPTION_MPEXT_MODEZ_LEVEL 1016
 //---------------------------------------------------------------------------
 #endif // FileZillaOptH
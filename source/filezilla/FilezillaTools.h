@@ -9,6 +9,15 @@
 #include <openssl/ssl.h>
 #pragma clang diagnostic pop
 //---------------------------------------------------------------------------
+class CZlibStream
+{
+public:
+  virtual ~CZlibStream() {}
+  virtual bool Process(const char * Data, int Len, std::string & Output) = 0;
+  virtual void Finish(std::string & Output) = 0;
+  virtual bool IsComplete() = 0;
+};
+//---------------------------------------------------------------------------
 class CFileZillaTools
 {
 public:
@@ -18,6 +27,7 @@ public:
   virtual std::wstring GetClientString() = 0;
   virtual void SetupSsl(ssl_st * Ssl) = 0;
   virtual std::wstring CustomReason(int Err) = 0;
+  virtual CZlibStream * CreateZlibStream(bool Compress, int Level) = 0;
 };
 //---------------------------------------------------------------------------
 #endif // FileZillaToolsH
@@ -139,8 +139,6 @@ __int64 CFtpControlSocket::m_CurrentTransferLimit[2] = {0, 0};
 
 CCriticalSectionWrapper CFtpControlSocket::m_SpeedLimitSync;
 
-#define BUFSIZE 16384
-
 CFtpControlSocket::CFtpControlSocket(CMainThread *pMainThread, CFileZillaTools * pTools)
 {
   DebugAssert(pMainThread);
@@ -173,11 +171,15 @@ CFtpControlSocket::CFtpControlSocket(CMainThread *pMainThread, CFileZillaTools *
 
   m_awaitsReply = false;
   m_skipReply = false;
+  m_sendTicks = 0;
+  m_minRtt = -1;
 
   m_sendBuffer = 0;
   m_sendBufferLen = 0;
 
   m_bProtP = false;
+  m_useZlib = false;
+  m_zlibLevel = 0;
 
   m_mayBeMvsFilesystem = false;
   m_mayBeBS2000Filesystem = false;
@@ -1309,6 +1311,12 @@ void CFtpControlSocket::ProcessReply()
     if (m_sendBuffer)
       TriggerEvent(FD_WRITE);
     m_awaitsReply = false;
+
+    int rtt = static_cast<int>(GetTickCount() - m_sendTicks);
+    if ((m_minRtt < 0) || (rtt < m_minRtt))
+    {
+      m_minRtt = rtt;
+    }
   }
 
   CString reply = GetReply();
@@ -1477,6 +1485,7 @@ BOOL CFtpControlSocket::Send(CString str)
   {
     m_awaitsReply = true;
     m_LastSendTime = Now();
+    m_sendTicks = GetTickCount();
     // Count timeout since the last request, not only since the last received data
     // otherwise we may happen to timeout immediately after sending request if
     // CheckForTimeout occurs in between and we haven't received any data for a while
@@ -1538,12 +1547,16 @@ void CFtpControlSocket::DoClose(int nError /*=0*/)
 
   m_awaitsReply = false;
   m_skipReply = false;
+  m_sendTicks = 0;
+  m_minRtt = -1;
 
   delete [] m_sendBuffer;
   m_sendBuffer = 0;
   m_sendBufferLen = 0;
 
   m_bProtP = false;
+  m_useZlib = false;
+  m_zlibLevel = 0;
 
   m_mayBeMvsFilesystem = false;
   m_mayBeBS2000Filesystem = false;
@@ -1849,6 +1862,8 @@ void CFtpControlSocket::List(BOOL bFinish, int nError /*=FALSE*/, CServerPath pa
   #define LIST_PWD2  2
   #define LIST_CWD2  3
   #define LIST_PWD3  4
+  #define LIST_MODE  5
+  #define LIST_OPTS  6
   #define LIST_PORT_PASV  7
   #define LIST_TYPE  8
   #define LIST_LIST  9
@@ -2057,6 +2072,19 @@ void CFtpControlSocket::List(BOOL bFinish, int nError /*=FALSE*/, CServerPath pa
     case LIST_TYPE:
       if (code!=2 && code!=3)
         error=TRUE;
+      if (NeedModeCommand())
+        m_Operation.nOpState = LIST_MODE;
+      else if (NeedOptsCommand())
+        m_Operation.nOpState = LIST_OPTS;
+      else
+        m_Operation.nOpState = LIST_PORT_PASV;
+      break;
+    case LIST_MODE:
+      HandleModeReply(code);
+      m_Operation.nOpState = NeedOptsCommand() ? LIST_OPTS : LIST_PORT_PASV;
+      break;
+    case LIST_OPTS:
+      HandleOptsReply(code);
       m_Operation.nOpState = LIST_PORT_PASV;
       break;
     case LIST_PORT_PASV:
@@ -2234,6 +2262,10 @@ void CFtpControlSocket::List(BOOL bFinish, int nError /*=FALSE*/, CServerPath pa
   }
   else if (m_Operation.nOpState==LIST_TYPE)
     cmd=L"TYPE A";
+  else if (m_Operation.nOpState==LIST_MODE)
+    cmd=GetModeCmd();
+  else if (m_Operation.nOpState==LIST_OPTS)
+    cmd=GetOptsCmd();
   else if (m_Operation.nOpState==LIST_LIST)
   {
     if (!m_pTransferSocket)
@@ -2648,6 +2680,8 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
   #define FILETRANSFER_MKD      2
   #define FILETRANSFER_CWD2      3
   #define FILETRANSFER_PWD2      4
+  #define FILETRANSFER_LIST_MODE    5
+  #define FILETRANSFER_LIST_OPTS    6
   #define FILETRANSFER_LIST_PORTPASV  7
   #define FILETRANSFER_LIST_TYPE    8
   #define FILETRANSFER_LIST_LIST    9
@@ -2656,6 +2690,8 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
   #define FILETRANSFER_NOLIST_MDTM  12
   #define FILETRANSFER_TYPE      13
   #define FILETRANSFER_REST      14
+  #define FILETRANSFER_MODE      15
+  #define FILETRANSFER_OPTS      16
   #define FILETRANSFER_PORTPASV    17
   #define FILETRANSFER_RETRSTOR    18
   #define FILETRANSFER_WAITFINISH    19
@@ -3167,9 +3203,21 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
     case FILETRANSFER_LIST_TYPE:
       if (code != 2 && code != 3)
         nReplyError = FZ_REPLY_ERROR;
+      else if (NeedModeCommand())
+        m_Operation.nOpState = FILETRANSFER_LIST_MODE;
+      else if (NeedOptsCommand())
+        m_Operation.nOpState = FILETRANSFER_LIST_OPTS;
       else
         m_Operation.nOpState = FILETRANSFER_LIST_PORTPASV;
       break;
+    case FILETRANSFER_LIST_MODE:
+      HandleModeReply(code);
+      m_Operation.nOpState = NeedOptsCommand() ? FILETRANSFER_LIST_OPTS : FILETRANSFER_LIST_PORTPASV;
+      break;
+    case FILETRANSFER_LIST_OPTS:
+      HandleOptsReply(code);
+      m_Operation.nOpState = FILETRANSFER_LIST_PORTPASV;
+      break;
     case FILETRANSFER_LIST_PORTPASV:
       ParseResult = ParsePasvPort(code, pData->bTriedPortPasvOnce, pData->bPasv, GetReply(), pData->host, pData->port);
       if (ParseResult < 0)
@@ -3278,6 +3326,22 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
     case FILETRANSFER_TYPE:
       if (code!=2 && code!=3)
         nReplyError = FZ_REPLY_ERROR;
+      if (NeedModeCommand())
+        m_Operation.nOpState = FILETRANSFER_MODE;
+      else if (NeedOptsCommand())
+        m_Operation.nOpState = FILETRANSFER_OPTS;
+      else
+        m_Operation.nOpState = !pData->transferfile.get && pData->transferdata.bResume ? FILETRANSFER_OPTS_REST : FILETRANSFER_PORTPASV;
+      break;
+    case FILETRANSFER_MODE:
+      HandleModeReply(code);
+      if (NeedOptsCommand())
+        m_Operation.nOpState = FILETRANSFER_OPTS;
+      else
+        m_Operation.nOpState = !pData->transferfile.get && pData->transferdata.bResume ? FILETRANSFER_OPTS_REST : FILETRANSFER_PORTPASV;
+      break;
+    case FILETRANSFER_OPTS:
+      HandleOptsReply(code);
       m_Operation.nOpState = !pData->transferfile.get && pData->transferdata.bResume ? FILETRANSFER_OPTS_REST : FILETRANSFER_PORTPASV;
       break;
     case FILETRANSFER_WAIT:
@@ -3686,6 +3750,16 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
     if (!Send(L"TYPE A"))
       bError=TRUE;
     break;
+  case FILETRANSFER_LIST_MODE:
+  case FILETRANSFER_MODE:
+    if (!Send(GetModeCmd()))
+      bError=TRUE;
+    break;
+  case FILETRANSFER_LIST_OPTS:
+  case FILETRANSFER_OPTS:
+    if (!Send(GetOptsCmd()))
+      bError=TRUE;
+    break;
   case FILETRANSFER_LIST_LIST:
     {
       if (!m_pTransferSocket)
@@ -5360,12 +5434,12 @@ __int64 CFtpControlSocket::GetSpeedLimit(enum transferDirection direction)
     return GetSpeedLimit(OPTION_SPEEDLIMIT_UPLOAD_TYPE, OPTION_SPEEDLIMIT_UPLOAD_VALUE);
 }
 
-__int64 CFtpControlSocket::GetAbleToUDSize( bool &beenWaiting, CTime &curTime, __int64 &curLimit, std::list<CFtpControlSocket::t_ActiveList>::iterator &iter, enum transferDirection direction)
+__int64 CFtpControlSocket::GetAbleToUDSize( bool &beenWaiting, CTime &curTime, __int64 &curLimit, std::list<CFtpControlSocket::t_ActiveList>::iterator &iter, enum transferDirection direction, int bufferSize)
 {
   beenWaiting = false;
 
   CTime nowTime = CTime::CreateForCurrentTime();
-  __int64 ableToRead = BUFSIZE;
+  __int64 ableToRead = bufferSize;
 
   if ( nowTime == curTime)
   {
@@ -5445,12 +5519,12 @@ __int64 CFtpControlSocket::GetAbleToUDSize( bool &beenWaiting, CTime &curTime, _
 
   curTime = nowTime;
 
-  ableToRead = std::min(ableToRead, static_cast<__int64>(BUFSIZE));
+  ableToRead = std::min(ableToRead, static_cast<__int64>(bufferSize));
 
   return ableToRead;
 }
 
-__int64 CFtpControlSocket::GetAbleToTransferSize(enum transferDirection direction, bool &beenWaiting)
+__int64 CFtpControlSocket::GetAbleToTransferSize(enum transferDirection direction, bool &beenWaiting, int bufferSize)
 {
   m_SpeedLimitSync.Lock();
   std::list<t_ActiveList>::iterator iter;
@@ -5467,11 +5541,17 @@ __int64 CFtpControlSocket::GetAbleToTransferSize(enum transferDirection directio
     iter = m_InstanceList[direction].end();
     iter--;
   }
-  __int64 limit = GetAbleToUDSize(beenWaiting, m_CurrentTransferTime[direction], m_CurrentTransferLimit[direction], iter, direction);
+  __int64 limit = GetAbleToUDSize(beenWaiting, m_CurrentTransferTime[direction], m_CurrentTransferLimit[direction], iter, direction, bufferSize);
   m_SpeedLimitSync.Unlock();
   return limit;
 }
 
+// Minimal observed command round-trip time in milliseconds, -1 if not known yet
+int CFtpControlSocket::GetRtt() const
+{
+  return m_minRtt;
+}
+
 BOOL CFtpControlSocket::RemoveActiveTransfer()
 {
   BOOL bFound = FALSE;
@@ -5608,6 +5688,10 @@ void CFtpControlSocket::DiscardLine(RawByteString line)
     {
       m_serverCapabilities.SetCapability(mfmt_command, yes);
     }
+    else if (line == "MODE Z" || line.SubString(1, 7) == "MODE Z ")
+    {
+      m_serverCapabilities.SetCapability(mode_z_support, yes);
+    }
   }
   else if (m_Operation.nOpMode == CSMODE_LISTFILE)
   {
@@ -5620,6 +5704,57 @@ int CFtpControlSocket::FileTransferListState()
   return GetOptionVal(OPTION_MPEXT_NOLIST) ? FILETRANSFER_TYPE : FILETRANSFER_LIST_TYPE;
 }
 
+bool CFtpControlSocket::NeedModeCommand()
+{
+  bool useZlib =
+    (GetOptionVal(OPTION_MPEXT_MODEZ_LEVEL) > 0) &&
+    (m_serverCapabilities.GetCapability(mode_z_support) == yes);
+  return (useZlib != m_useZlib);
+}
+
+bool CFtpControlSocket::NeedOptsCommand()
+{
+  return m_useZlib && (m_zlibLevel != GetOptionVal(OPTION_MPEXT_MODEZ_LEVEL));
+}
+
+CString CFtpControlSocket::GetModeCmd()
+{
+  return m_useZlib ? L"MODE S" : L"MODE Z";
+}
+
+CString CFtpControlSocket::GetOptsCmd()
+{
+  CString cmd;
+  cmd.Format(L"OPTS MODE Z LEVEL %d", GetOptionVal(OPTION_MPEXT_MODEZ_LEVEL));
+  return cmd;
+}
+
+void CFtpControlSocket::HandleModeReply(int code)
+{
+  if (code == 2 || code == 3)
+  {
+    m_useZlib = !m_useZlib;
+    // The server starts with its own default level
+    m_zlibLevel = 0;
+  }
+  else if (!m_useZlib)
+  {
+    // Do not retry with every transfer
+    LogMessage(FZ_LOG_WARNING, L"Server refused MODE Z, transferring uncompressed");
+    m_serverCapabilities.SetCapability(mode_z_support, no);
+  }
+}
+
+void CFtpControlSocket::HandleOptsReply(int code)
+{
+  if (code != 2 && code != 3)
+  {
+    LogMessage(FZ_LOG_INFO, L"Server refused to change MODE Z level, using its default");
+  }
+  // Remember even the refused level, so that we do not retry it with every transfer
+  m_zlibLevel = GetOptionVal(OPTION_MPEXT_MODEZ_LEVEL);
+}
+
 CString CFtpControlSocket::GetReply()
 {
   if (m_RecvBuffer.empty())
@@ -5667,6 +5802,7 @@ void CFtpControlSocket::OnSend(int nErrorCode)
 
   m_awaitsReply = true;
   m_LastSendTime = Now();
+  m_sendTicks = GetTickCount();
 
   if (res == m_sendBufferLen)
   {
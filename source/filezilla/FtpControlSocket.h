@@ -95,7 +95,8 @@ public:
 
   __int64 GetSpeedLimit(enum transferDirection direction);
 
-  __int64 GetAbleToTransferSize(enum transferDirection direction, bool &beenWaiting);
+  __int64 GetAbleToTransferSize(enum transferDirection direction, bool &beenWaiting, int bufferSize);
+  int GetRtt() const;
 
   t_server GetCurrentServer();
   CFtpListResult * CreateListResult(bool mlst);
@@ -138,7 +139,12 @@ protected:
 
   void DiscardLine(RawByteString line);
   int FileTransferListState();
+  bool NeedModeCommand();
   bool NeedOptsCommand();
+  CString GetModeCmd();
+  CString GetOptsCmd();
+  void HandleModeReply(int code);
+  void HandleOptsReply(int code);
   CString GetListingCmd();
 
   bool InitConnect();
@@ -173,7 +179,7 @@ protected:
   static CTime m_CurrentTransferTime[2];
   static __int64 m_CurrentTransferLimit[2];
   static CCriticalSectionWrapper m_SpeedLimitSync;
-  __int64 GetAbleToUDSize(bool & beenWaiting, CTime & curTime, __int64 & curLimit, std::list<t_ActiveList>::iterator & iter, enum transferDirection direction);
+  __int64 GetAbleToUDSize(bool & beenWaiting, CTime & curTime, __int64 & curLimit, std::list<t_ActiveList>::iterator & iter, enum transferDirection direction, int bufferSize);
   __int64 GetSpeedLimit(int valType, int valValue);
 
   void SetDirectoryListing(t_directory * pDirectory, bool bSetWorkingDir = true);
@@ -207,12 +213,16 @@ protected:
   bool m_isFileZilla;
 
   bool m_awaitsReply;
+  DWORD m_sendTicks;
+  int m_minRtt;
   bool m_skipReply;
 
   char * m_sendBuffer;
   int m_sendBufferLen;
 
   bool m_bProtP;
+  bool m_useZlib;
+  int m_zlibLevel;
 
   bool m_mayBeMvsFilesystem;
   bool m_mayBeBS2000Filesystem;
@@ -9,6 +9,8 @@
 #include <DateUtils.hpp>
 
 #define BUFSIZE 16384
+#define MAXBUFSIZE (4 * 1024 * 1024)
+#define MAXSOCKBUF (16 * 1024 * 1024)
 
 #define STATE_WAITING    0
 #define STATE_STARTING    1
@@ -39,6 +41,17 @@ CTransferSocket::CTransferSocket(CFtpControlSocket *pOwner, int nMode)
   m_nNotifyWaiting = 0;
   m_bActivationPending = false;
   m_LastSendBufferUpdate = 0;
+  m_RcvBuf = 0;
+  m_bufferSize = BUFSIZE;
+  m_adaptBytes = 0;
+  m_adaptTicks = 0;
+  m_bufferFilled = false;
+  m_pZlibStream = NULL;
+  m_bZlibFinished = false;
+  if (m_pOwner->m_useZlib)
+  {
+    m_pZlibStream = m_pOwner->m_pTools->CreateZlibStream(FLAGSET(m_nMode, CSMODE_UPLOAD), m_pOwner->m_zlibLevel);
+  }
 
   UpdateStatusBar(true);
 
@@ -61,6 +74,7 @@ CTransferSocket::CTransferSocket(CFtpControlSocket *pOwner, int nMode)
 CTransferSocket::~CTransferSocket()
 {
   delete [] m_pBuffer;
+  delete m_pZlibStream;
   GetIntern()->PostMessage(FZ_MSG_MAKEMSG(FZ_MSG_TRANSFERSTATUS, 0), 0);
   Close();
   RemoveAllLayers();
@@ -77,9 +91,9 @@ CTransferSocket::~CTransferSocket()
 __int64 CTransferSocket::GetTransferSize(CFtpControlSocket::transferDirection direction, bool & beenWaiting)
 {
   if (GetState() != closed)
-    return m_pOwner->GetAbleToTransferSize(direction, beenWaiting);
+    return m_pOwner->GetAbleToTransferSize(direction, beenWaiting, m_bufferSize);
   else
-    return BUFSIZE;
+    return m_bufferSize;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -105,12 +119,26 @@ void CTransferSocket::OnReceive(int nErrorCode)
     if (m_nTransferState == STATE_STARTING)
       OnConnect(0);
 
-    std::vector<char> Buffer(BUFSIZE);
+    std::vector<char> Buffer(m_bufferSize);
     int numread = CAsyncSocketEx::Receive(&Buffer[0], SizeToIntChecked(Buffer.size()));
     if (numread != SOCKET_ERROR && numread)
     {
       m_LastActiveTime = Now();
-      m_pListResult->AddData(&Buffer[0], numread);
+      if (m_pZlibStream != NULL)
+      {
+        std::string decompressed;
+        if (!m_pZlibStream->Process(&Buffer[0], numread, decompressed))
+        {
+          m_pOwner->ShowStatus(L"Decompression of the listing failed", FZ_LOG_ERROR);
+          CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
+          return;
+        }
+        m_pListResult->AddData(decompressed.data(), static_cast<int>(decompressed.size()));
+      }
+      else
+      {
+        m_pListResult->AddData(&Buffer[0], numread);
+      }
       m_transferdata.transfersize += numread;
       t_ffam_transferstatus *status = new t_ffam_transferstatus;
       status->bFileTransfer = FALSE;
@@ -147,71 +175,174 @@ void CTransferSocket::OnReceive(int nErrorCode)
     if (m_nTransferState == STATE_STARTING)
       OnConnect(0);
 
-    bool beenWaiting = false;
-    __int64 ableToRead = GetTransferSize(CFtpControlSocket::download, beenWaiting);
-
-    if (!beenWaiting)
-      DebugAssert(ableToRead);
-    else if (!ableToRead)
+    // Drain as much as the kernel has buffered, rather than a single buffer per FD_READ
+    while (TRUE)
     {
-      TriggerEvent(FD_READ);
-      return;
-    }
+      bool beenWaiting = false;
+      __int64 ableToRead = GetTransferSize(CFtpControlSocket::download, beenWaiting);
 
-    if (!m_pBuffer)
-      m_pBuffer = new char[BUFSIZE];
+      if (!beenWaiting)
+        DebugAssert(ableToRead);
+      else if (!ableToRead)
+      {
+        TriggerEvent(FD_READ);
+        return;
+      }
 
-    int numread = CAsyncSocketEx::Receive(m_pBuffer, static_cast<int>(ableToRead));
-    if (numread!=SOCKET_ERROR)
-    {
-      m_pOwner->SpeedLimitAddTransferredBytes(CFtpControlSocket::download, numread);
-    }
+      if (!m_pBuffer)
+        m_pBuffer = new char[m_bufferSize];
 
-    if (!numread)
-    {
-      CloseAndEnsureSendClose(0);
-      return;
-    }
+      int numread = CAsyncSocketEx::Receive(m_pBuffer, static_cast<int>(ableToRead));
+      if (numread!=SOCKET_ERROR)
+      {
+        m_pOwner->SpeedLimitAddTransferredBytes(CFtpControlSocket::download, numread);
+      }
 
-    if (numread == SOCKET_ERROR)
-    {
-      int nError = GetLastError();
-      if (nError == WSAENOTCONN)
+      if (!numread)
       {
-        //Not yet connected
+        CloseAndEnsureSendClose(0);
         return;
       }
-      else if (m_pSslLayer && nError == WSAESHUTDOWN)
+
+      if (numread == SOCKET_ERROR)
       {
-        // Do nothing, wait for shutdown complete notification.
+        int nError = GetLastError();
+        if (nError == WSAENOTCONN)
+        {
+          //Not yet connected
+          return;
+        }
+        else if (m_pSslLayer && nError == WSAESHUTDOWN)
+        {
+          // Do nothing, wait for shutdown complete notification.
+          return;
+        }
+        else if (nError != WSAEWOULDBLOCK)
+        {
+          LogError(nError);
+          CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
+        }
+
+        UpdateStatusBar(true);
         return;
       }
-      else if (nError != WSAEWOULDBLOCK)
+
+      int written = 0;
+      m_LastActiveTime = Now();
+      try
       {
-        LogError(nError);
+        if (m_pZlibStream != NULL)
+        {
+          if (!WriteDecompressedData(m_pBuffer, numread, written))
+          {
+            return;
+          }
+        }
+        else
+        {
+          WriteData(m_pBuffer, numread);
+          written = numread;
+        }
+      }
+      catch (EOSError & E)
+      {
+        m_pOwner->ShowStatus(CString(E.Message), FZ_LOG_ERROR);
         CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
+        return;
       }
+      m_transferdata.transferleft -= written;
 
-      UpdateStatusBar(true);
-      return;
+      bool filled = (numread == ableToRead);
+      AdaptBuffers(numread, filled);
+      UpdateStatusBar(false);
+
+      if (!filled)
+      {
+        // Kernel buffer drained, wait for the next FD_READ
+        return;
+      }
+
+      //Check if there are other commands in the command queue.
+      MSG msg;
+      if (PeekMessage(&msg, 0, m_nInternalMessageID, m_nInternalMessageID, PM_NOREMOVE))
+      {
+        TriggerEvent(FD_READ);
+        return;
+      }
     }
+  }
+}
 
-    int written = 0;
-    m_LastActiveTime = Now();
-    try
+// Grows the transfer buffer (and the socket buffers) with the observed throughput,
+// so that each socket event moves as much data as possible on fast links.
+// The buffers never shrink within a transfer.
+void CTransferSocket::AdaptBuffers(int transferred, bool filled)
+{
+  m_adaptBytes += transferred;
+  m_bufferFilled = m_bufferFilled || filled;
+  DWORD Ticks = GetTickCount();
+  if (m_adaptTicks == 0)
+  {
+    m_adaptTicks = Ticks;
+  }
+  else if (Ticks - m_adaptTicks >= 1000)
+  {
+    __int64 throughput = (m_adaptBytes * 1000) / (Ticks - m_adaptTicks);
+
+    // Buffer for about 100 ms worth of data, but grow only when the buffer was actually filled up,
+    // i.e. when there was more data available than we were able to process at once
+    if (m_bufferFilled && (m_bufferSize < MAXBUFSIZE))
     {
-      WriteData(m_pBuffer, numread);
-      written = numread;
+      int bufferSize = m_bufferSize;
+      while ((bufferSize < MAXBUFSIZE) && (bufferSize < throughput / 10))
+      {
+        bufferSize *= 2;
+      }
+      if (bufferSize > m_bufferSize)
+      {
+        LogMessage(FZ_LOG_INFO, L"Increasing transfer buffer from %d to %d", m_bufferSize, bufferSize);
+        char * buffer = new char[bufferSize];
+        if (m_pBuffer != NULL)
+        {
+          // Upload can have unsent data in the buffer
+          memcpy(buffer, m_pBuffer, m_bufferpos);
+          delete [] m_pBuffer;
+        }
+        m_pBuffer = buffer;
+        m_bufferSize = bufferSize;
+      }
     }
-    catch (EOSError & E)
+
+    // Size the socket buffers to twice the bandwidth-delay product,
+    // with the round-trip time estimated from the control connection
+    int rtt = m_pOwner->GetRtt();
+    if (rtt > 0)
     {
-      m_pOwner->ShowStatus(CString(E.Message), FZ_LOG_ERROR);
-      CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
-      return;
+      __int64 bdp = std::min((2 * throughput * rtt) / 1000, static_cast<__int64>(MAXSOCKBUF));
+      DWORD value = static_cast<DWORD>(bdp);
+      if (FLAGSET(m_nMode, CSMODE_UPLOAD))
+      {
+        if ((m_SendBuf > 0) && (value > m_SendBuf))
+        {
+          LogMessage(FZ_LOG_PROGRESS, L"Increasing send buffer from %d to %d", m_SendBuf, value);
+          m_SendBuf = value;
+          SetSockOpt(SO_SNDBUF, &m_SendBuf, sizeof(m_SendBuf));
+        }
+      }
+      else
+      {
+        if ((m_RcvBuf > 0) && (value > m_RcvBuf))
+        {
+          LogMessage(FZ_LOG_PROGRESS, L"Increasing receive buffer from %d to %d", m_RcvBuf, value);
+          m_RcvBuf = value;
+          SetSockOpt(SO_RCVBUF, &m_RcvBuf, sizeof(m_RcvBuf));
+        }
+      }
     }
-    m_transferdata.transferleft -= written;
 
-    UpdateStatusBar(false);
+    m_adaptTicks = Ticks;
+    m_adaptBytes = 0;
+    m_bufferFilled = false;
   }
 }
 
@@ -242,6 +373,7 @@ void CTransferSocket::SetBuffers()
       value = rcvbuf;
       SetSockOpt(SO_RCVBUF, &value, sizeof(value));
     }
+    m_RcvBuf = value;
   }
 }
 
@@ -485,7 +617,13 @@ void CTransferSocket::OnSend(int nErrorCode)
     return;
   }
   if (!m_pBuffer)
-    m_pBuffer = new char[BUFSIZE];
+    m_pBuffer = new char[m_bufferSize];
+
+  if (m_pZlibStream != NULL)
+  {
+    SendCompressed();
+    return;
+  }
 
   bool firstPass = true;
 
@@ -528,7 +666,7 @@ void CTransferSocket::OnSend(int nErrorCode)
     // Just to make the change noop, but the test should probably be done everytime
     if (firstPass)
     {
-      DebugAssert(bufferlen <= BUFSIZE);
+      DebugAssert(bufferlen <= m_bufferSize);
 
       if (bufferlen <= 0)
       {
@@ -579,7 +717,7 @@ void CTransferSocket::OnSend(int nErrorCode)
     {
       int pos = bufferlen - numsent;
 
-      if (pos < 0 || (numsent + pos) > BUFSIZE)
+      if (pos < 0 || (numsent + pos) > m_bufferSize)
       {
         LogMessage(FZ_LOG_WARNING, L"Index out of range");
         CloseOnShutDownOrError(CSMODE_TRANSFERERROR);
@@ -606,6 +744,7 @@ void CTransferSocket::OnSend(int nErrorCode)
         m_bufferpos=pos;
       }
     }
+    AdaptBuffers(numsent, (numsent == bufferlen) && (bufferlen == currentBufferSize));
     //Check if there are other commands in the command queue.
     MSG msg;
     if (PeekMessage(&msg, 0, m_nInternalMessageID, m_nInternalMessageID, PM_NOREMOVE))
@@ -859,6 +998,110 @@ void CTransferSocket::WriteData(const char * buffer, int len)
   }
 }
 
+bool CTransferSocket::WriteDecompressedData(const char * buffer, int len, int & written)
+{
+  std::string decompressed;
+  if (!m_pZlibStream->Process(buffer, len, decompressed))
+  {
+    m_pOwner->ShowStatus(L"Decompression of the transferred data failed", FZ_LOG_ERROR);
+    CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
+    return false;
+  }
+  written = static_cast<int>(decompressed.size());
+  if (written > 0)
+  {
+    WriteData(decompressed.data(), written);
+  }
+  return true;
+}
+
+// The compressed size is not known in advance, so unlike the plain transfer in OnSend,
+// the progress is reported in terms of the uncompressed data read from the file,
+// while the speed limit applies to the compressed data actually sent.
+void CTransferSocket::SendCompressed()
+{
+  while (TRUE)
+  {
+    if (m_zlibBuffer.empty())
+    {
+      if (m_bZlibFinished)
+      {
+        CloseOnShutDownOrError(0);
+        return;
+      }
+
+      int numread = ReadDataFromFile(m_pBuffer, m_bufferSize);
+      if (numread < 0)
+      {
+        return;
+      }
+      else if (numread == 0)
+      {
+        m_pZlibStream->Finish(m_zlibBuffer);
+        m_bZlibFinished = true;
+      }
+      else
+      {
+        m_pZlibStream->Process(m_pBuffer, numread, m_zlibBuffer);
+        m_transferdata.transferleft -= numread;
+        m_uploaded += numread;
+      }
+      if (m_zlibBuffer.empty())
+      {
+        continue;
+      }
+    }
+
+    bool beenWaiting = false;
+    __int64 ableToSend = GetTransferSize(CFtpControlSocket::upload, beenWaiting);
+    if (ableToSend == 0)
+    {
+      // Not allowed to send yet, try later
+      TriggerEvent(FD_WRITE);
+      return;
+    }
+
+    int tosend = static_cast<int>(std::min(ableToSend, static_cast<__int64>(m_zlibBuffer.size())));
+    int numsent = Send(m_zlibBuffer.data(), tosend);
+    if (numsent == SOCKET_ERROR || !numsent)
+    {
+      int nError = GetLastError();
+      if ((nError == WSAENOTCONN) || (nError == WSAEWOULDBLOCK))
+      {
+        // wait for the next FD_WRITE
+      }
+      else if (m_pSslLayer && nError == WSAESHUTDOWN)
+      {
+        // Do nothing, wait for shutdown complete notification.
+      }
+      else
+      {
+        LogError(nError);
+        CloseOnShutDownOrError(CSMODE_TRANSFERERROR);
+      }
+      UpdateStatusBar(true);
+      return;
+    }
+
+    m_pOwner->SpeedLimitAddTransferredBytes(CFtpControlSocket::upload, numsent);
+    m_LastActiveTime = Now();
+    m_zlibBuffer.erase(0, numsent);
+    AdaptBuffers(numsent, (numsent == tosend) && (tosend == ableToSend));
+
+    //Check if there are other commands in the command queue.
+    MSG msg;
+    if (PeekMessage(&msg, 0, m_nInternalMessageID, m_nInternalMessageID, PM_NOREMOVE))
+    {
+      //Send resume message
+      LogMessage(FZ_LOG_DEBUG, L"Message waiting in queue, resuming later");
+      TriggerEvent(FD_WRITE);
+      UpdateStatusBar(false);
+      return;
+    }
+    UpdateStatusBar(false);
+  }
+}
+
 int CTransferSocket::ReadData(char * buffer, int len)
 {
   int result;
@@ -918,6 +1161,12 @@ void CTransferSocket::EnsureSendClose(int Mode)
 {
   if (!m_bSentClose)
   {
+    // A compressed download or listing that has ended without the end of the compressed stream is truncated
+    if ((Mode == 0) && (m_pZlibStream != NULL) && FLAGCLEAR(m_nMode, CSMODE_UPLOAD) && !m_pZlibStream->IsComplete())
+    {
+      m_pOwner->ShowStatus(L"Compressed data stream ended prematurely", FZ_LOG_ERROR);
+      Mode = CSMODE_TRANSFERERROR;
+    }
     if (Mode != 0)
     {
       m_pOwner->ShowStatus(L"Data connection failed", FZ_LOG_INFO);
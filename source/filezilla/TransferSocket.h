@@ -52,6 +52,8 @@ protected:
   int ReadDataFromFile(char * buffer, int len);
   int ReadData(char * buffer, int len);
   void WriteData(const char * buffer, int len);
+  bool WriteDecompressedData(const char * buffer, int len, int & written);
+  void SendCompressed();
   virtual void LogSocketMessageRaw(int nMessageType, const wchar_t * pMsg);
   virtual int GetSocketOptionVal(int OptionID) const;
   virtual void ConfigureSocket();
@@ -68,6 +70,9 @@ protected:
   BOOL m_bSentClose;
   int m_bufferpos;
   char * m_pBuffer;
+  CZlibStream * m_pZlibStream;
+  std::string m_zlibBuffer;
+  bool m_bZlibFinished;
   BOOL m_bCheckTimeout;
   TDateTime m_LastActiveTime;
   int m_nTransferState;
@@ -79,11 +84,17 @@ protected:
   void EnsureSendClose(int Mode);
   void CloseOnShutDownOrError(int Mode);
   void SetBuffers();
+  void AdaptBuffers(int transferred, bool filled);
   __int64 GetTransferSize(CFtpControlSocket::transferDirection direction, bool & beenWaiting);
 
   LARGE_INTEGER m_LastUpdateTime;
   unsigned int m_LastSendBufferUpdate;
   DWORD m_SendBuf;
+  DWORD m_RcvBuf;
+  int m_bufferSize;
+  __int64 m_adaptBytes;
+  DWORD m_adaptTicks;
+  bool m_bufferFilled;
 };
 //---------------------------------------------------------------------------
 #endif // TransferSocketH
@@ -81,6 +81,11 @@ void __fastcall TCleanupDialog::FindData()
   {
     AddLocation(CLEANUP_TEMP_FOLDERS, WinConfiguration->TemporaryDir(true), WinConfiguration->CleanupTemporaryFolders);
   }
+
+  if (WinConfiguration->AnyThumbnailCache())
+  {
+    AddLocation(CLEANUP_THUMBNAILS, WinConfiguration->ThumbnailCacheDirectory(), WinConfiguration->CleanupThumbnailCache);
+  }
 }
 //---------------------------------------------------------------------
 void __fastcall TCleanupDialog::InitControls()
@@ -3912,26 +3912,111 @@ bool TCustomScpExplorerForm::EditorCheckNotModified(const TEditedFileData * Data
   return WinConfiguration->EditorCheckNotModified && (Data->SourceTimestamp != TDateTime());
 }
 //---------------------------------------------------------------------------
+static bool UploadEditedFile(
+  TTerminal * Terminal, TStrings * FileList, const UnicodeString & TargetDir, const TCopyParamType * CopyParam, int Params,
+  const TEditedFileBlocks & PrevBlocks, TEditedFileBlocks & Blocks)
+{
+  UnicodeString FileName = FileList->Strings[0];
+  // Only where the changed blocks can be written in place
+  if (Terminal->IsCapable[fcParallelFileTransfers])
+  {
+    try
+    {
+      Blocks.Calculate(FileName);
+    }
+    catch (Exception & E)
+    {
+      Terminal->LogEvent(FORMAT(L"Cannot calculate blocks of \"%s\", uploading whole file: %s", (FileName, E.Message)));
+      Blocks = TEditedFileBlocks();
+    }
+  }
+
+  bool Result;
+  bool Failed;
+  {
+    // A file or a part skipped on error does not fail the upload
+    TFileOperationFailureMonitor Monitor(Terminal);
+    TFileRanges Ranges;
+    if (Blocks.ChangedRanges(PrevBlocks, Ranges))
+    {
+      Result =
+        Terminal->CopyRangesToRemote(
+          FileName, TargetDir, CopyParam, Params, Ranges, PrevBlocks.Size, PrevBlocks.RemoteModification);
+    }
+    else
+    {
+      Result = Terminal->CopyToRemote(FileList, TargetDir, CopyParam, Params, NULL);
+    }
+    Failed = Monitor.Failed;
+  }
+
+  // The hashes can be used for the next upload, only if they match what was uploaded
+  // and if we know the state of the remote file to later check that it has not changed meanwhile
+  if (Result && (Blocks.Size >= 0))
+  {
+    std::unique_ptr<TRemoteFile> File;
+    if (Failed)
+    {
+      Terminal->LogEvent(FORMAT(L"Upload of \"%s\" was not complete, not keeping its blocks.", (FileName)));
+    }
+    else if (!Blocks.IsFileUnchanged(FileName))
+    {
+      Terminal->LogEvent(FORMAT(L"File \"%s\" has changed while uploading, not keeping its blocks.", (FileName)));
+    }
+    else
+    {
+      UnicodeString TargetFileName = Terminal->ChangeFileName(CopyParam, ExtractFileName(FileName), osLocal, true);
+      File.reset(Terminal->TryReadFile(UnixCombinePaths(TargetDir, TargetFileName)));
+    }
+    if (File.get() != NULL)
+    {
+      Blocks.RemoteModification = File->Modification;
+    }
+    else
+    {
+      Blocks = TEditedFileBlocks();
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
 class TEditorUploadQueueItem : public TUploadQueueItem
 {
 public:
   __fastcall TEditorUploadQueueItem(
       TTerminal * Terminal, TStrings * FilesToCopy, const UnicodeString & TargetDir,
-      const TCopyParamType * CopyParam, int Params) :
+      const TCopyParamType * CopyParam, int Params, const TEditedFileBlocks & PrevBlocks) :
     TUploadQueueItem(Terminal, FilesToCopy, TargetDir, CopyParam, Params, false)
   {
+    FPrevBlocks = PrevBlocks;
   }
 
 protected:
-  virtual void __fastcall DoTransferExecute(TTerminal * Terminal, TParallelOperation * ParallelOperation)
+  virtual void __fastcall DoTransferExecute(TTerminal * Terminal, TParallelOperation * /*ParallelOperation*/)
   {
-    TUploadQueueItem::DoTransferExecute(Terminal, ParallelOperation);
-    TTerminalManager::Instance()->ScpExplorer->EditedFileUploaded(Terminal, CompleteEvent);
+    // Hashing the blocks of a large file takes a while, so it is done here, rather than in the GUI thread
+    TEditedFileBlocks Blocks;
+    bool Uploaded = UploadEditedFile(Terminal, FFilesToCopy, FTargetDir, FCopyParam, FParams, FPrevBlocks, Blocks);
+    TTerminalManager::Instance()->ScpExplorer->EditedFileUploaded(Terminal, CompleteEvent, (Uploaded ? &Blocks : NULL));
   }
+
+private:
+  TEditedFileBlocks FPrevBlocks;
 };
 //---------------------------------------------------------------------------
-void TCustomScpExplorerForm::EditedFileUploaded(TTerminal * ATerminal, HANDLE UploadCompleteEvent)
+void TCustomScpExplorerForm::EditedFileUploaded(
+  TTerminal * ATerminal, HANDLE UploadCompleteEvent, const TEditedFileBlocks * Blocks)
 {
+  if (Blocks != NULL)
+  {
+    TGuard Guard(FEditorManager->Section);
+    TEditedFileData * Data = FEditorManager->FindByUploadCompleteEvent(UploadCompleteEvent);
+    if (DebugAlwaysTrue(Data != NULL))
+    {
+      Data->UploadedBlocks = *Blocks;
+    }
+  }
+
   if (WinConfiguration->EditorCheckNotModified) // optimization
   {
     UnicodeString RemoteFilePath;
@@ -4125,8 +4210,15 @@ void __fastcall TCustomScpExplorerForm::ExecutedFileChanged(
       if (Data->Terminal->IsCapable[fcBackgroundTransfers])
       {
         TTerminalQueue * AQueue = Manager->FindQueueForTerminal(Data->Terminal);
+        TEditedFileBlocks PrevBlocks;
+        {
+          TGuard Guard(FEditorManager->Section);
+          PrevBlocks = Data->UploadedBlocks;
+          // The state of the remote file is not known until the upload succeeds
+          Data->UploadedBlocks = TEditedFileBlocks();
+        }
         TQueueItem * QueueItem =
-          new TEditorUploadQueueItem(Data->Terminal, FileList, Data->RemoteDirectory, &CopyParam, Params);
+          new TEditorUploadQueueItem(Data->Terminal, FileList, Data->RemoteDirectory, &CopyParam, Params, PrevBlocks);
         QueueItem->CompleteEvent = UploadCompleteEvent;
         AddQueueItem(AQueue, QueueItem, Data->Terminal);
       }
@@ -4139,7 +4231,13 @@ void __fastcall TCustomScpExplorerForm::ExecutedFileChanged(
         else
         {
           FMoveToQueue = false;
-          Data->Terminal->CopyToRemote(FileList, Data->RemoteDirectory, &CopyParam, Params, NULL);
+          TEditedFileBlocks PrevBlocks = Data->UploadedBlocks;
+          Data->UploadedBlocks = TEditedFileBlocks();
+          TEditedFileBlocks Blocks;
+          if (UploadEditedFile(Data->Terminal, FileList, Data->RemoteDirectory, &CopyParam, Params, PrevBlocks, Blocks))
+          {
+            Data->UploadedBlocks = Blocks;
+          }
           SetEvent(UploadCompleteEvent);
         }
       }
@@ -12464,7 +12562,8 @@ void __fastcall TCustomScpExplorerForm::RemoteDirViewThumbnailNeeded(
     MaskParams.Size = File->Size;
     MaskParams.Modification = File->Modification;
 
-    if ((File->Size <= static_cast<__int64>(WinConfiguration->RemoteThumbnailSizeLimit) * 1024) &&
+    if (((File->Size <= static_cast<__int64>(WinConfiguration->RemoteThumbnailSizeLimit) * 1024) ||
+         TThumbnailDownloadQueueItem::CanUseEmbeddedThumbnail(Terminal, File)) &&
         FRemoteThumbnailMask.Matches(FileName, false, File->IsDirectory, &MaskParams))
     {
       Bitmap = TTerminalManager::Instance()->ThumbnailNeeded(Terminal, Item->Index, File, Size);
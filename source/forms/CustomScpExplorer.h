@@ -47,6 +47,7 @@ class TEditorManager;
 struct TEditorData;
 class TTransferPresetNoteData;
 struct TEditedFileData;
+struct TEditedFileBlocks;
 struct ITaskbarList3;
 struct TSynchronizeParams;
 class TBookmark;
@@ -475,7 +476,7 @@ protected:
   void __fastcall DestroyProgressForm();
   virtual void __fastcall FileOperationProgress(TFileOperationProgressType & ProgressData);
   void __fastcall OperationComplete(const TDateTime & StartTime);
-  void EditedFileUploaded(TTerminal * ATerminal, HANDLE UploadCompleteEvent);
+  void EditedFileUploaded(TTerminal * ATerminal, HANDLE UploadCompleteEvent, const TEditedFileBlocks * Blocks);
   void __fastcall ExecutedFileChanged(
     const UnicodeString & FileName, const TDateTime & Timestamp, TEditedFileData * Data,
     HANDLE UploadCompleteEvent, bool & Retry);
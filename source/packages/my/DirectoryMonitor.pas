@@ -29,6 +29,7 @@ type
     FOnDeleted: TFileChangedEvent;
     FOnModified: TFileChangedEvent;
     FOnRenamed: TFileRenamedEvent;
+    FOnOverflow: TNotifyEvent;
     FWatchSubTree: Boolean;
 
     procedure SetActive(AActive: Boolean);
@@ -41,6 +42,7 @@ type
     procedure DoDeleted(Sender: TObject; FileName: string);
     procedure DoModified(Sender: TObject; FileName: string);
     procedure DoRenamed(Sender: TObject; FromFileName: string; ToFileName: string);
+    procedure DoOverflow(Sender: TObject);
 
   public
     constructor Create(AOwner: TComponent); override;
@@ -53,6 +55,8 @@ type
     property OnDeleted: TFileChangedEvent read FOnDeleted write FOnDeleted;
     property OnModified: TFileChangedEvent read FOnModified write FOnModified;
     property OnRenamed: TFileRenamedEvent read FOnRenamed write FOnRenamed;
+    // Some changes were lost, as they did not fit into the buffer
+    property OnOverflow: TNotifyEvent read FOnOverflow write FOnOverflow;
     property WatchSubtree: Boolean read FWatchSubTree write FWatchSubtree;
     property WatchFilters: DWord read FWatchFilters write FWatchFilters;
   end;
@@ -78,6 +82,7 @@ type
     FParent: TDirectoryMonitor;
     FRenamedFrom: string;
     procedure HandleEvent;
+    procedure HandleOverflow;
 
   protected
     procedure Execute; override;
@@ -114,6 +119,11 @@ begin
   until (Offset = 0);
 end;
 
+procedure TDirectoryMonitorThread.HandleOverflow;
+begin
+  FParent.DoOverflow(FParent);
+end;
+
 procedure TDirectoryMonitorThread.Execute;
 var
   NumBytes: DWord;
@@ -124,7 +134,9 @@ begin
     GetQueuedCompletionStatus(FParent.FCompletionPort, NumBytes, CompletionKey, FParent.FPOverlapped, INFINITE);
     if CompletionKey <> 0 then
     begin
-      Synchronize(HandleEvent);
+      // Zero bytes means that the buffer overflowed and the changes are lost
+      if NumBytes = 0 then Synchronize(HandleOverflow)
+        else Synchronize(HandleEvent);
       with FParent do
       begin
         FBytesWritten := 0;
@@ -236,6 +248,11 @@ begin
   if Assigned(FOnRenamed) then FOnRenamed(Sender, FPath + FromFileName, FPath + ToFileName);
 end;
 
+procedure TDirectoryMonitor.DoOverflow(Sender: TObject);
+begin
+  if Assigned(FOnOverflow) then FOnOverflow(Sender);
+end;
+
 procedure TDirectoryMonitor.SetPath(APath: string);
 begin
   APath := IncludeTrailingPathDelimiter(APath);
@@ -1316,4 +1316,14 @@ CONF_OPTION(change_password,
     DEFAULT_BOOL(false),
     NOT_SAVED,
 )
+CONF_OPTION(compression_level,
+    VALUE_TYPE(INT),
+    DEFAULT_INT(0),
+    NOT_SAVED,
+)
+CONF_OPTION(decrypt_thread,
+    VALUE_TYPE(BOOL),
+    DEFAULT_BOOL(false),
+    NOT_SAVED,
+)
 /* WINSCP END */
@@ -2778,6 +2778,21 @@ void request_callback_notifications(toplevel_callback_notify_fn_t notify,
                                     void *ctx);
 #endif
 
+#ifdef WINSCP
+/*
+ * Facility provided by the platform to run jobs on a worker thread,
+ * one at a time. When a job finishes, done_ic is queued on the main
+ * thread, which can then check worker_thread_busy() and pick up the
+ * results. Returns NULL if the thread cannot be started.
+ */
+typedef struct WorkerThread WorkerThread;
+typedef void (*worker_thread_job_fn_t)(void *ctx);
+WorkerThread *worker_thread_new(IdempotentCallback *done_ic);
+void worker_thread_run(WorkerThread *wt, worker_thread_job_fn_t job, void *ctx);
+bool worker_thread_busy(WorkerThread *wt);
+void worker_thread_free(WorkerThread *wt);
+#endif
+
 /*
  * Facility provided by the platform to spawn a parallel subprocess
  * and present its stdio via a Socket.
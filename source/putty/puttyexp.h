@@ -62,6 +62,11 @@ void win_secur_cleanup(void);
 
 void ec_cleanup(void);
 
+// from zlib.c
+
+void zlib_compress_finish(ssh_compressor * sc, unsigned char ** outblock, int * outlen);
+bool zlib_decompress_finished(ssh_decompressor * dc);
+
 // from agent-client.c
 
 typedef enum AuthAgentImplementation {
@@ -46,6 +46,17 @@ struct ssh_channel;
  *    _packet_ we're prepared to cope with.  It must be a multiple
  *    of the cipher block size, and must be at least 35000.
  */
+/* WINSCP BEGIN */
+/*
+ *  - OUR_V2_BIGMAXPKT is the "maximum packet size" we send instead of
+ *    OUR_V2_MAXPKT, unless the remote end is known to mishandle it.
+ *    A data message of this size still fits into OUR_V2_PACKETLIMIT.
+ *
+ *  - OUR_V2_MAXWIN is the limit up to which the window of a non-simple
+ *    channel is auto-tuned. It bounds the memory each channel may hold
+ *    in flight (1 Gbit/s at 100 ms RTT needs about 12 MB).
+ */
+/* WINSCP END */
 
 #define SSH1_BUFFER_LIMIT 32768
 #define SSH_MAX_BACKLOG 32768
@@ -53,6 +64,10 @@ struct ssh_channel;
 #define OUR_V2_BIGWIN 0x7fffffff
 #define OUR_V2_MAXPKT 0x4000UL
 #define OUR_V2_PACKETLIMIT 0x9000UL
+#ifdef WINSCP
+#define OUR_V2_BIGMAXPKT 0x8000UL
+#define OUR_V2_MAXWIN 0x1000000
+#endif
 
 typedef struct PacketQueueNode PacketQueueNode;
 struct PacketQueueNode {
@@ -1125,6 +1140,10 @@ struct ssh_compression_alg {
      * userauth has completed successfully. */
     const char *delayed_name;
     ssh_compressor *(*compress_new)(void);
+#ifdef WINSCP
+    /* Optional; level 0 means the same as compress_new */
+    ssh_compressor *(*compress_new_level)(int level);
+#endif
     void (*compress_free)(ssh_compressor *);
     void (*compress)(ssh_compressor *, const unsigned char *block, int len,
                      unsigned char **outblock, int *outlen,
@@ -1139,6 +1158,12 @@ struct ssh_compression_alg {
 static inline ssh_compressor *ssh_compressor_new(
     const ssh_compression_alg *alg)
 { return alg->compress_new(); }
+#ifdef WINSCP
+static inline ssh_compressor *ssh_compressor_new_level(
+    const ssh_compression_alg *alg, int level)
+{ return alg->compress_new_level ?
+        alg->compress_new_level(level) : alg->compress_new(); }
+#endif
 static inline ssh_decompressor *ssh_decompressor_new(
     const ssh_compression_alg *alg)
 { return alg->decompress_new(); }
@@ -158,6 +158,19 @@ void ssh2_bpp_new_incoming_crypto(
  */
 bool ssh2_bpp_rekey_inadvisable(BinaryPacketProtocol *bpp);
 
+#ifdef WINSCP
+/*
+ * Compression level to create the outgoing compressor with, for
+ * algorithms that support one (0 = the algorithm's default).
+ */
+void ssh2_bpp_set_compression_level(BinaryPacketProtocol *bpp, int level);
+/*
+ * Verify and decrypt larger incoming packets on a worker thread, so that
+ * it overlaps with the processing of the previous packet.
+ */
+void ssh2_bpp_enable_decrypt_thread(BinaryPacketProtocol *bpp);
+#endif
+
 BinaryPacketProtocol *ssh2_bare_bpp_new(LogContext *logctx);
 
 /*
@@ -33,6 +33,9 @@ struct ssh2_bpp_state {
      * substructure, except that they have different types */
     ssh_decompressor *in_decomp;
     ssh_compressor *out_comp;
+#ifdef WINSCP
+    int out_comp_level;
+#endif
 
     bool is_server;
     bool pending_newkeys;
@@ -41,9 +44,22 @@ struct ssh2_bpp_state {
     unsigned nnewkeys;
     int prev_type;
 
+#ifdef WINSCP
+    /* if non-NULL, larger packets are verified and decrypted by it */
+    WorkerThread *worker;
+    bool worker_ok;
+#endif
+
     BinaryPacketProtocol bpp;
 };
 
+#ifdef WINSCP
+/*
+ * Smaller packets are not worth the thread switch.
+ */
+#define SSH2_BPP_WORKER_MIN_PACKET 4096
+#endif
+
 static void ssh2_bpp_free(BinaryPacketProtocol *bpp);
 static void ssh2_bpp_handle_input(BinaryPacketProtocol *bpp);
 static void ssh2_bpp_handle_output(BinaryPacketProtocol *bpp);
@@ -71,6 +87,55 @@ BinaryPacketProtocol *ssh2_bpp_new(
     return &s->bpp;
 }
 
+#ifdef WINSCP
+void ssh2_bpp_set_compression_level(BinaryPacketProtocol *bpp, int level)
+{
+    struct ssh2_bpp_state *s;
+    assert(bpp->vt == &ssh2_bpp_vtable);
+    s = container_of(bpp, struct ssh2_bpp_state, bpp);
+    s->out_comp_level = level;
+}
+
+void ssh2_bpp_enable_decrypt_thread(BinaryPacketProtocol *bpp)
+{
+    struct ssh2_bpp_state *s;
+    assert(bpp->vt == &ssh2_bpp_vtable);
+    s = container_of(bpp, struct ssh2_bpp_state, bpp);
+    if (!s->worker) {
+        /* the worker's completion resumes ssh2_bpp_handle_input */
+        s->worker = worker_thread_new(&s->bpp.ic_in_raw);
+        if (s->worker)
+            bpp_logevent("Incoming packets will be decrypted on a worker thread");
+    }
+}
+
+/*
+ * Worker thread jobs. They run while ssh2_bpp_handle_input waits for
+ * them, so nothing else touches the incoming cipher and MAC meanwhile.
+ */
+static void ssh2_bpp_etm_job(void *ctx)
+{
+    struct ssh2_bpp_state *s = (struct ssh2_bpp_state *)ctx;
+
+    s->worker_ok = !s->in.mac || ssh2_mac_verify(
+        s->in.mac, s->data, s->len + 4, s->in.sequence);
+    if (s->worker_ok && s->in.cipher)
+        ssh_cipher_decrypt(s->in.cipher, s->data + 4, s->packetlen - 4);
+}
+
+static void ssh2_bpp_decrypt_job(void *ctx)
+{
+    struct ssh2_bpp_state *s = (struct ssh2_bpp_state *)ctx;
+
+    if (s->in.cipher)
+        ssh_cipher_decrypt(
+            s->in.cipher,
+            s->data + s->cipherblk, s->packetlen - s->cipherblk);
+    s->worker_ok = !s->in.mac || ssh2_mac_verify(
+        s->in.mac, s->data, s->len + 4, s->in.sequence);
+}
+#endif
+
 static void ssh2_bpp_free_outgoing_crypto(struct ssh2_bpp_state *s)
 {
     if (s->out.mac)
@@ -95,6 +160,11 @@ static void ssh2_bpp_free_incoming_crypto(struct ssh2_bpp_state *s)
 static void ssh2_bpp_free(BinaryPacketProtocol *bpp)
 {
     struct ssh2_bpp_state *s = container_of(bpp, struct ssh2_bpp_state, bpp);
+#ifdef WINSCP
+    /* waits for the job in progress, which uses our incoming crypto */
+    if (s->worker)
+        worker_thread_free(s->worker);
+#endif
     sfree(s->buf);
     ssh2_bpp_free_outgoing_crypto(s);
     ssh2_bpp_free_incoming_crypto(s);
@@ -166,7 +236,11 @@ void ssh2_bpp_new_outgoing_crypto(
         /* 'compression' is always non-NULL, because no compression is
          * indicated by ssh_comp_none. But this setup call may return a
          * null out_comp. */
+#ifdef WINSCP
+        s->out_comp = ssh_compressor_new_level(compression, s->out_comp_level);
+#else
         s->out_comp = ssh_compressor_new(compression);
+#endif
 
         if (s->out_comp)
             bpp_logevent("Initialised %s compression",
@@ -264,7 +338,12 @@ static void ssh2_bpp_enable_pending_compression(struct ssh2_bpp_state *s)
         s->in.pending_compression = NULL;
     }
     if (s->out.pending_compression) {
+#ifdef WINSCP
+        s->out_comp = ssh_compressor_new_level(
+            s->out.pending_compression, s->out_comp_level);
+#else
         s->out_comp = ssh_compressor_new(s->out.pending_compression);
+#endif
         bpp_logevent("Initialised delayed %s compression",
                      ssh_compressor_alg(s->out_comp)->text_name);
         s->out.pending_compression = NULL;
@@ -430,6 +509,17 @@ static void ssh2_bpp_handle_input(BinaryPacketProtocol *bpp)
              */
             BPP_READ(s->data + 4, s->packetlen + s->maclen - 4);
 
+#ifdef WINSCP
+            if (s->worker && s->packetlen >= SSH2_BPP_WORKER_MIN_PACKET) {
+                /* Meanwhile, the previous packet gets processed. */
+                worker_thread_run(s->worker, ssh2_bpp_etm_job, s);
+                crMaybeWaitUntilV(!worker_thread_busy(s->worker));
+                if (!s->worker_ok) {
+                    ssh_sw_abort(s->bpp.ssh, "Incorrect MAC received on packet");
+                    crStopV;
+                }
+            } else {
+#endif
             /*
              * Check the MAC.
              */
@@ -443,6 +533,9 @@ static void ssh2_bpp_handle_input(BinaryPacketProtocol *bpp)
             if (s->in.cipher)
                 ssh_cipher_decrypt(
                     s->in.cipher, s->data + 4, s->packetlen - 4);
+#ifdef WINSCP
+            }
+#endif
         } else {
             if (s->bufsize < s->cipherblk) {
                 s->bufsize = s->cipherblk;
@@ -496,6 +589,16 @@ static void ssh2_bpp_handle_input(BinaryPacketProtocol *bpp)
             BPP_READ(s->data + s->cipherblk,
                      s->packetlen + s->maclen - s->cipherblk);
 
+#ifdef WINSCP
+            if (s->worker && s->packetlen >= SSH2_BPP_WORKER_MIN_PACKET) {
+                worker_thread_run(s->worker, ssh2_bpp_decrypt_job, s);
+                crMaybeWaitUntilV(!worker_thread_busy(s->worker));
+                if (!s->worker_ok) {
+                    ssh_sw_abort(s->bpp.ssh, "Incorrect MAC received on packet");
+                    crStopV;
+                }
+            } else {
+#endif
             /* Decrypt everything _except_ the MAC. */
             if (s->in.cipher)
                 ssh_cipher_decrypt(
@@ -510,6 +613,9 @@ static void ssh2_bpp_handle_input(BinaryPacketProtocol *bpp)
                 ssh_sw_abort(s->bpp.ssh, "Incorrect MAC received on packet");
                 crStopV;
             }
+#ifdef WINSCP
+            }
+#endif
         }
         /* Get and sanity-check the amount of random padding. */
         s->pad = s->data[4];
@@ -22,6 +22,10 @@ static void ssh2_connection_special_cmd(PacketProtocolLayer *ppl,
                                         SessionSpecialCode code, int arg);
 static void ssh2_connection_reconfigure(PacketProtocolLayer *ppl, Conf *conf);
 static unsigned int ssh2_connection_winscp_query(PacketProtocolLayer *ppl, int query);
+#ifdef WINSCP
+static unsigned long ssh2_our_maxpkt(struct ssh2_connection_state *s);
+static void ssh2_autotune_window(struct ssh2_channel *c);
+#endif
 
 static const PacketProtocolLayerVtable ssh2_connection_vtable = {
     .free = ssh2_connection_free,
@@ -452,7 +456,11 @@ static bool ssh2_connection_filter_queue(struct ssh2_connection_state *s)
                 put_uint32(pktout, c->remoteid);
                 put_uint32(pktout, c->localid);
                 put_uint32(pktout, c->locwindow);
+                #ifdef WINSCP
+                put_uint32(pktout, ssh2_our_maxpkt(s)); /* our max pkt size */
+                #else
                 put_uint32(pktout, OUR_V2_MAXPKT); /* our max pkt size */
+                #endif
                 pq_push(s->ppl.out_pq, pktout);
             }
 
@@ -557,6 +565,9 @@ static bool ssh2_connection_filter_queue(struct ssh2_connection_state *s)
                     int bufsize;
                     c->locwindow -= data.len;
                     c->remlocwin -= data.len;
+                    #ifdef WINSCP
+                    c->rcvd_total += data.len;
+                    #endif
                     if (ext_type != 0 && ext_type != SSH2_EXTENDED_DATA_STDERR)
                         data.len = 0; /* ignore unknown extended data */
                     bufsize = chan_send(
@@ -579,10 +590,18 @@ static bool ssh2_connection_filter_queue(struct ssh2_connection_state *s)
                      * its window, and we didn't want it to do that,
                      * think about using a larger window.
                      */
+                    #ifdef WINSCP
+                    if (c->remlocwin <= 0 &&
+                        c->throttle_state == UNTHROTTLED &&
+                        !c->autotune_pending &&
+                        c->locmaxwin < OUR_V2_MAXWIN)
+                        ssh2_autotune_window(c);
+                    #else
                     if (c->remlocwin <= 0 &&
                         c->throttle_state == UNTHROTTLED &&
                         c->locmaxwin < 0x40000000)
                         c->locmaxwin += OUR_V2_WINSIZE;
+                    #endif
 
                     /*
                      * If we are not buffering too much data, enlarge
@@ -875,10 +894,66 @@ static bool ssh2_connection_filter_queue(struct ssh2_connection_state *s)
     }
 }
 
+#ifdef WINSCP
+/*
+ * Context of an outstanding winadj request: the window increment it
+ * accompanies, plus how much data we had received when it was sent, so
+ * that its reply tells us how much data arrives within a round trip.
+ */
+struct winadj_ctx {
+    unsigned size;
+    unsigned long rcvd_total;
+};
+
+static unsigned long ssh2_our_maxpkt(struct ssh2_connection_state *s)
+{
+    /*
+     * Offer the larger maximum packet size, unless the remote end is
+     * known to ignore it, or the BPP cannot carry packets that big
+     * (e.g. a connection-sharing downstream).
+     */
+    if ((s->ppl.remote_bugs & BUG_SSH2_MAXPKT) ||
+        (OUR_V2_BIGMAXPKT > s->ppl.bpp->vt->packet_size_limit))
+        return OUR_V2_MAXPKT;
+    return OUR_V2_BIGMAXPKT;
+}
+
+static void ssh2_autotune_window(struct ssh2_channel *c)
+{
+    int newwin;
+
+    /*
+     * The remote end ran out of window. If we have no measurement yet,
+     * or if, during the last measured round trip, we received at least
+     * half a window's worth of data, it is the window that limits the
+     * throughput, so double it (the bandwidth-delay product is then at
+     * least that large). Otherwise grow it only slowly, as the
+     * bottleneck is elsewhere. We grow at most once per round trip, as
+     * the remote end does not see the new window sooner anyway. The
+     * round trip ends with the winadj reply, or in ssh2_set_window, if
+     * no winadj is going to be sent.
+     */
+    if ((c->rcvd_per_rtt == 0) ||
+        (c->rcvd_per_rtt >= (unsigned long)c->locmaxwin / 2))
+        newwin = c->locmaxwin * 2;
+    else
+        newwin = c->locmaxwin + OUR_V2_WINSIZE;
+    if (newwin > OUR_V2_MAXWIN)
+        newwin = OUR_V2_MAXWIN;
+    c->locmaxwin = newwin;
+    c->autotune_pending = true;
+}
+#endif
+
 static void ssh2_handle_winadj_response(struct ssh2_channel *c,
                                         PktIn *pktin, void *ctx)
 {
+    #ifdef WINSCP
+    struct winadj_ctx *wctx = ctx;
+    unsigned *sizep = &wctx->size;
+    #else
     unsigned *sizep = ctx;
+    #endif
 
     /*
      * Winadj responses should always be failures. However, at least
@@ -889,7 +964,17 @@ static void ssh2_handle_winadj_response(struct ssh2_channel *c,
      */
 
     c->remlocwin += *sizep;
+    #ifdef WINSCP
+    /*
+     * The data received between the request and its reply is what
+     * the remote end managed to send us in one round trip.
+     */
+    c->rcvd_per_rtt = c->rcvd_total - wctx->rcvd_total;
+    c->autotune_pending = false;
+    sfree(wctx);
+    #else
     sfree(sizep);
+    #endif
     /*
      * winadj messages are only sent when the window is fully open, so
      * if we get an ack of one, we know any pending unthrottle is
@@ -909,8 +994,12 @@ static void ssh2_set_window(struct ssh2_channel *c, int newwin)
      * sending any more data anyway. Ditto if _we've_ already sent
      * CLOSE.
      */
-    if (c->closes & (CLOSES_RCVD_EOF | CLOSES_SENT_CLOSE))
+    if (c->closes & (CLOSES_RCVD_EOF | CLOSES_SENT_CLOSE)) {
+        #ifdef WINSCP
+        c->autotune_pending = false;
+        #endif
         return;
+    }
 
     /*
      * If the client-side Channel is in an initial setup phase with a
@@ -918,8 +1007,13 @@ static void ssh2_set_window(struct ssh2_channel *c, int newwin)
      * waiting to see its initial auth and may yet hand it off to a
      * downstream, don't send any WINDOW_ADJUST either.
      */
-    if (c->chan->initial_fixed_window_size)
+    if (c->chan->initial_fixed_window_size) {
+        #ifdef WINSCP
+        /* No winadj to wait for, do not block autotuning for good */
+        c->autotune_pending = false;
+        #endif
         return;
+    }
 
     /*
      * If the remote end has a habit of ignoring maxpkt, limit the
@@ -938,7 +1032,11 @@ static void ssh2_set_window(struct ssh2_channel *c, int newwin)
      */
     if (newwin / 2 >= c->locwindow) {
         PktOut *pktout;
+        #ifdef WINSCP
+        struct winadj_ctx *up;
+        #else
         unsigned *up;
+        #endif
 
         /*
          * In order to keep track of how much window the client
@@ -952,8 +1050,14 @@ static void ssh2_set_window(struct ssh2_channel *c, int newwin)
          */
         if (newwin == c->locmaxwin &&
             !(s->ppl.remote_bugs & BUG_CHOKES_ON_WINADJ)) {
+            #ifdef WINSCP
+            up = snew(struct winadj_ctx);
+            up->size = newwin - c->locwindow;
+            up->rcvd_total = c->rcvd_total;
+            #else
             up = snew(unsigned);
             *up = newwin - c->locwindow;
+            #endif
             pktout = ssh2_chanreq_init(c, "winadj@putty.projects.tartarus.org",
                                        ssh2_handle_winadj_response, up);
             pq_push(s->ppl.out_pq, pktout);
@@ -964,6 +1068,9 @@ static void ssh2_set_window(struct ssh2_channel *c, int newwin)
             /* Pretend the WINDOW_ADJUST was acked immediately. */
             c->remlocwin = newwin;
             c->throttle_state = THROTTLED;
+            #ifdef WINSCP
+            c->autotune_pending = false;
+            #endif
         }
         pktout = ssh_bpp_new_pktout(s->ppl.bpp, SSH2_MSG_CHANNEL_WINDOW_ADJUST);
         put_uint32(pktout, c->remoteid);
@@ -1311,6 +1418,11 @@ void ssh2_channel_init(struct ssh2_channel *c)
     c->sharectx = NULL;
     c->locwindow = c->locmaxwin = c->remlocwin =
         s->ssh_is_simple ? OUR_V2_BIGWIN : OUR_V2_WINSIZE;
+    #ifdef WINSCP
+    c->rcvd_total = 0;
+    c->rcvd_per_rtt = 0;
+    c->autotune_pending = false;
+    #endif
     c->chanreq_head = NULL;
     c->throttle_state = UNTHROTTLED;
     bufchain_init(&c->outbuffer);
@@ -1333,7 +1445,11 @@ PktOut *ssh2_chanopen_init(struct ssh2_channel *c, const char *type)
     put_stringz(pktout, type);
     put_uint32(pktout, c->localid);
     put_uint32(pktout, c->locwindow);     /* our window size */
+    #ifdef WINSCP
+    put_uint32(pktout, ssh2_our_maxpkt(s)); /* our max pkt size */
+    #else
     put_uint32(pktout, OUR_V2_MAXPKT);    /* our max pkt size */
+    #endif
     return pktout;
 }
 
@@ -110,6 +110,16 @@ struct ssh2_channel {
      * last data packet or window adjust ack.
      */
     int remlocwin;
+#ifdef WINSCP
+    /*
+     * Window auto-tuning state: total data received on the channel,
+     * data received during the last measured round trip (a winadj
+     * request and its reply), and whether the window was grown and
+     * the remote end has not yet seen that.
+     */
+    unsigned long rcvd_total, rcvd_per_rtt;
+    bool autotune_pending;
+#endif
 
     /*
      * These store the list of channel requests that we're waiting for
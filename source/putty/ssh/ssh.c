@@ -210,6 +210,12 @@ static void ssh_got_ssh_version(struct ssh_version_receiver *rcv,
                 (conf_get_bool(ssh->conf, CONF_ssh_simple) && !ssh->connshare);
 
             ssh->bpp = ssh2_bpp_new(ssh->logctx, &ssh->stats, false);
+            #ifdef WINSCP
+            ssh2_bpp_set_compression_level(
+                ssh->bpp, conf_get_int(ssh->conf, CONF_compression_level));
+            if (conf_get_bool(ssh->conf, CONF_decrypt_thread))
+                ssh2_bpp_enable_decrypt_thread(ssh->bpp);
+            #endif
             ssh_connect_bpp(ssh);
 
 #ifndef NO_GSSAPI
@@ -568,18 +568,768 @@ static void zlib_match(struct LZ77Context *ectx, int distance, int len)
     }
 }
 
+#ifdef WINSCP
+/* ----------------------------------------------------------------------
+ * Alternative deflate engine, used instead of the LZ77 code above when
+ * the compressor is created with a compression level. It keeps
+ * zlib-style hash chains searched up to per-level limits, does lazy
+ * matching at the higher levels, and buffers the symbols of a whole
+ * block, so that it can send them with dynamic Huffman trees, with
+ * the static trees or as a stored block, whichever is the shortest.
+ *
+ * Every compressed packet ends with a complete block followed by an
+ * empty static block, the same as the partial flush used above.
+ */
+
+#define DF_WSIZE 32768
+#define DF_WMASK (DF_WSIZE - 1)
+#define DF_HASHBITS 15
+#define DF_HASHSIZE (1 << DF_HASHBITS)
+#define DF_HASHMASK (DF_HASHSIZE - 1)
+#define DF_MINMATCH 3
+#define DF_MAXMATCH 258
+#define DF_MINLOOKAHEAD (DF_MAXMATCH + DF_MINMATCH + 1)
+/* keeps the chain from reaching a window slot that was reused */
+#define DF_MAXDIST (DF_WSIZE - DF_MINLOOKAHEAD)
+/* a 3-byte match further than this is not worth it */
+#define DF_TOOFAR 4096
+#define DF_NIL 0
+#define DF_SYMBUFSIZE 16384
+#define DF_LITLENS 286
+/* the static tree has two more, unused, which still shift its codes */
+#define DF_STATICLITLENS 288
+#define DF_DISTS 30
+#define DF_CLENS 19
+#define DF_MAXBITS 15
+#define DF_MAXCLBITS 7
+#define DF_EOB 256
+
+struct DeflateLevel {
+    int good_length;  /* search less of the chain above this length */
+    int max_lazy;     /* lazy: do not look for a better match above this
+                       * length; greedy: insert strings of matches only
+                       * up to this length */
+    int nice_length;  /* stop searching at this length */
+    int max_chain;    /* maximum number of chain links followed */
+    bool lazy;
+};
+
+static const struct DeflateLevel deflate_levels[] = {
+    {0, 0, 0, 0, false},               /* 0: LZ77 code above is used */
+    {4, 4, 8, 4, false},
+    {4, 5, 16, 8, false},
+    {4, 6, 32, 32, false},
+    {4, 4, 16, 16, true},
+    {8, 16, 32, 32, true},
+    {8, 16, 128, 128, true},
+    {8, 32, 128, 256, true},
+    {32, 128, 258, 1024, true},
+    {32, 258, 258, 4096, true},
+};
+
+#define DF_MAXLEVEL ((int)lenof(deflate_levels) - 1)
+
+struct DeflateContext {
+    const struct DeflateLevel *level;
+
+    /*
+     * Data is appended to the window; once it is full, its upper half
+     * is moved down. Window positions (not offsets in the input) are
+     * stored in the hash chains, position 0 (DF_NIL) is never linked.
+     */
+    unsigned char window[2 * DF_WSIZE];
+    unsigned short head[DF_HASHSIZE];
+    unsigned short prev[DF_WSIZE];
+    int strstart;                      /* next position to compress */
+    int filled;                        /* end of data in window */
+
+    /* lazy matching state */
+    int match_length, match_start, prev_length;
+    bool match_available;
+
+    /*
+     * Symbols of the current block: a literal (dist == 0) or a match
+     * (len, dist), along with their frequencies, and the window data
+     * they cover, should we send the block stored.
+     */
+    unsigned short sym_litlen[DF_SYMBUFSIZE];
+    unsigned short sym_dist[DF_SYMBUFSIZE];
+    int nsyms;
+    unsigned litlen_freq[DF_LITLENS], dist_freq[DF_DISTS];
+    int block_start, block_bytes;
+
+    /* indexes to lencodes and distcodes */
+    unsigned char len_index[DF_MAXMATCH + 1];
+    unsigned char dist_index[DF_WSIZE + 1];
+};
+
+static struct DeflateContext *deflate_new(int level)
+{
+    struct DeflateContext *ctx = snew(struct DeflateContext);
+    int i, v;
+
+    if (level > DF_MAXLEVEL)
+        level = DF_MAXLEVEL;
+    ctx->level = &deflate_levels[level];
+    memset(ctx->head, 0, sizeof(ctx->head));
+    memset(ctx->prev, 0, sizeof(ctx->prev));
+    ctx->strstart = ctx->filled = 0;
+    ctx->match_length = ctx->prev_length = DF_MINMATCH - 1;
+    ctx->match_start = 0;
+    ctx->match_available = false;
+    ctx->nsyms = 0;
+    memset(ctx->litlen_freq, 0, sizeof(ctx->litlen_freq));
+    memset(ctx->dist_freq, 0, sizeof(ctx->dist_freq));
+    ctx->block_start = ctx->block_bytes = 0;
+
+    for (i = 0; i < lenof(lencodes); i++)
+        for (v = lencodes[i].min; v <= lencodes[i].max; v++)
+            ctx->len_index[v] = i;
+    for (i = 0; i < lenof(distcodes); i++)
+        for (v = distcodes[i].min; v <= distcodes[i].max; v++)
+            ctx->dist_index[v] = i;
+
+    return ctx;
+}
+
+static inline int deflate_hash(const unsigned char *p)
+{
+    return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & DF_HASHMASK;
+}
+
+/*
+ * Link the string at pos into its hash chain, returning the previous
+ * head of the chain. The caller ensures that three bytes are available.
+ */
+static inline int deflate_insert(struct DeflateContext *ctx, int pos)
+{
+    int h = deflate_hash(ctx->window + pos);
+    int head = ctx->head[h];
+    ctx->prev[pos & DF_WMASK] = head;
+    ctx->head[h] = pos;
+    return head;
+}
+
+/*
+ * Length of the common prefix of a and b, up to maxlen. The bulk of
+ * it is compared a machine word at a time.
+ */
+static inline int deflate_common_length(
+    const unsigned char *a, const unsigned char *b, int maxlen)
+{
+    int len = 0;
+    while (len + (int)sizeof(uint64_t) <= maxlen) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + len, sizeof(wa));
+        memcpy(&wb, b + len, sizeof(wb));
+        if (wa != wb)
+            break;
+        len += sizeof(uint64_t);
+    }
+    while (len < maxlen && a[len] == b[len])
+        len++;
+    return len;
+}
+
+/*
+ * Walk the hash chain from cur_match looking for a match at strstart
+ * longer than prev_length. Returns the best length found (no better
+ * than prev_length if there was none), storing its start.
+ */
+static int deflate_longest_match(struct DeflateContext *ctx, int cur_match)
+{
+    const struct DeflateLevel *lv = ctx->level;
+    const unsigned char *scan = ctx->window + ctx->strstart;
+    int chain = lv->max_chain;
+    int best_len = ctx->prev_length;
+    int nice = lv->nice_length;
+    int maxlen = ctx->filled - ctx->strstart;
+    int limit =
+        (ctx->strstart > DF_MAXDIST) ? ctx->strstart - DF_MAXDIST : DF_NIL;
+
+    if (maxlen > DF_MAXMATCH)
+        maxlen = DF_MAXMATCH;
+    if (best_len >= maxlen)
+        return best_len;
+    if (nice > maxlen)
+        nice = maxlen;
+    if (ctx->prev_length >= lv->good_length)
+        chain >>= 2;
+
+    do {
+        const unsigned char *match = ctx->window + cur_match;
+        int len;
+
+        /* cheap rejects, before comparing the strings in full */
+        if (match[best_len] != scan[best_len] ||
+            match[0] != scan[0] || match[1] != scan[1])
+            continue;
+
+        len = deflate_common_length(scan, match, maxlen);
+        if (len > best_len) {
+            ctx->match_start = cur_match;
+            best_len = len;
+            if (len >= nice)
+                break;
+        }
+    } while ((cur_match = ctx->prev[cur_match & DF_WMASK]) > limit &&
+             --chain > 0);
+
+    return best_len;
+}
+
+/*
+ * Record a literal (dist == 0) or a match. Returns true when the symbol
+ * buffer is full and the block has to be sent.
+ */
+static bool deflate_tally(struct DeflateContext *ctx, int dist, int lc)
+{
+    ctx->sym_litlen[ctx->nsyms] = lc;
+    ctx->sym_dist[ctx->nsyms] = dist;
+    ctx->nsyms++;
+    if (dist == 0) {
+        ctx->litlen_freq[lc]++;
+        ctx->block_bytes++;
+    } else {
+        ctx->litlen_freq[lencodes[ctx->len_index[lc]].code]++;
+        ctx->dist_freq[distcodes[ctx->dist_index[dist]].code]++;
+        ctx->block_bytes += lc;
+    }
+    return (ctx->nsyms == DF_SYMBUFSIZE);
+}
+
+/*
+ * Compute length-limited Huffman code lengths. At least two symbols
+ * always get a code, as some decoders cannot cope with fewer. Should a
+ * code get too long, frequencies are flattened and the tree rebuilt.
+ */
+static void deflate_build_lengths(
+    const unsigned *freq, int n, int maxbits, unsigned char *lens)
+{
+    unsigned long f[DF_LITLENS];
+    unsigned long weight[2 * DF_LITLENS];
+    int order[DF_LITLENS], parent[2 * DF_LITLENS], depth[2 * DF_LITLENS];
+    int i, m;
+
+    assert(n <= DF_LITLENS);
+    for (i = 0, m = 0; i < n; i++) {
+        f[i] = freq[i];
+        if (f[i] > 0)
+            m++;
+    }
+    for (i = 0; i < n && m < 2; i++)
+        if (f[i] == 0) {
+            f[i] = 1;
+            m++;
+        }
+
+    while (true) {
+        int leaf, node, next, maxdepth;
+
+        /* sort the used symbols by frequency (insertion sort, as the
+         * number of used symbols is mostly small) */
+        for (i = 0, m = 0; i < n; i++) {
+            if (f[i] > 0) {
+                int j = m++;
+                while (j > 0 && f[order[j - 1]] > f[i]) {
+                    order[j] = order[j - 1];
+                    j--;
+                }
+                order[j] = i;
+            }
+        }
+
+        /*
+         * Merge the two lightest nodes until one is left. The merged
+         * nodes come out in non-decreasing order, so it is enough to
+         * pick from the head of the sorted leaves and of the merged
+         * nodes.
+         */
+        for (i = 0; i < m; i++)
+            weight[i] = f[order[i]];
+        leaf = 0;
+        node = m;
+        for (next = m; next < 2 * m - 1; next++) {
+            int pick[2], k;
+            for (k = 0; k < 2; k++) {
+                if (leaf < m && (node >= next || weight[leaf] <= weight[node]))
+                    pick[k] = leaf++;
+                else
+                    pick[k] = node++;
+            }
+            weight[next] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = parent[pick[1]] = next;
+        }
+
+        /* parents always have higher indexes than their children */
+        depth[2 * m - 2] = 0;
+        maxdepth = 0;
+        for (i = 2 * m - 3; i >= 0; i--) {
+            depth[i] = depth[parent[i]] + 1;
+            if (i < m && depth[i] > maxdepth)
+                maxdepth = depth[i];
+        }
+
+        if (maxdepth <= maxbits) {
+            memset(lens, 0, n);
+            for (i = 0; i < m; i++)
+                lens[order[i]] = depth[i];
+            return;
+        }
+
+        for (i = 0; i < n; i++)
+            if (f[i] > 0)
+                f[i] = (f[i] + 1) / 2;
+    }
+}
+
+/*
+ * Assign canonical codes to the lengths, bit-reversed, as outbits()
+ * sends the least significant bit first, while Huffman codes are
+ * transmitted starting with the most significant one.
+ */
+static void deflate_make_codes(
+    const unsigned char *lens, int n, unsigned short *codes)
+{
+    int count[DF_MAXBITS + 1], next[DF_MAXBITS + 1];
+    int i, bits, code;
+
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n; i++)
+        count[lens[i]]++;
+    count[0] = 0;
+    code = 0;
+    for (bits = 1; bits <= DF_MAXBITS; bits++) {
+        code = (code + count[bits - 1]) << 1;
+        next[bits] = code;
+    }
+    for (i = 0; i < n; i++) {
+        if (lens[i] > 0) {
+            int c = next[lens[i]]++, r = 0;
+            for (bits = 0; bits < lens[i]; bits++) {
+                r = (r << 1) | (c & 1);
+                c >>= 1;
+            }
+            codes[i] = r;
+        } else {
+            codes[i] = 0;
+        }
+    }
+}
+
+/*
+ * Run-length encode the code lengths of a dynamic block header, using
+ * the repeat codes 16 (previous length), 17 and 18 (zeros).
+ */
+static int deflate_rle_lengths(
+    const unsigned char *lens, int n,
+    unsigned char *syms, unsigned char *extras)
+{
+    int i = 0, nsyms = 0;
+
+    while (i < n) {
+        int v = lens[i], run = 1, r;
+        while (i + run < n && lens[i + run] == v)
+            run++;
+        i += run;
+        r = run;
+        if (v == 0) {
+            while (r >= 11) {
+                int t = (r > 138) ? 138 : r;
+                syms[nsyms] = 18;
+                extras[nsyms++] = t - 11;
+                r -= t;
+            }
+            if (r >= 3) {
+                syms[nsyms] = 17;
+                extras[nsyms++] = r - 3;
+                r = 0;
+            }
+        } else {
+            syms[nsyms] = v;
+            extras[nsyms++] = 0;
+            r--;
+            while (r >= 3) {
+                int t = (r > 6) ? 6 : r;
+                syms[nsyms] = 16;
+                extras[nsyms++] = t - 3;
+                r -= t;
+            }
+        }
+        while (r > 0) {
+            syms[nsyms] = v;
+            extras[nsyms++] = 0;
+            r--;
+        }
+    }
+    return nsyms;
+}
+
+static void deflate_send_symbols(
+    struct DeflateContext *ctx, struct Outbuf *out,
+    const unsigned char *llens, const unsigned short *lcodes,
+    const unsigned char *dlens, const unsigned short *dcodes)
+{
+    int i;
+
+    for (i = 0; i < ctx->nsyms; i++) {
+        int lc = ctx->sym_litlen[i], dist = ctx->sym_dist[i];
+        if (dist == 0) {
+            outbits(out, lcodes[lc], llens[lc]);
+        } else {
+            const coderecord *l = &lencodes[ctx->len_index[lc]];
+            const coderecord *d = &distcodes[ctx->dist_index[dist]];
+            outbits(out, lcodes[l->code], llens[l->code]);
+            if (l->extrabits)
+                outbits(out, lc - l->min, l->extrabits);
+            outbits(out, dcodes[d->code], dlens[d->code]);
+            if (d->extrabits)
+                outbits(out, dist - d->min, d->extrabits);
+        }
+    }
+    outbits(out, lcodes[DF_EOB], llens[DF_EOB]);
+}
+
+static unsigned long deflate_data_bits(
+    struct DeflateContext *ctx,
+    const unsigned char *llens, const unsigned char *dlens)
+{
+    unsigned long bits = 0;
+    int i;
+    for (i = 0; i < DF_LITLENS; i++)
+        bits += (unsigned long)ctx->litlen_freq[i] * llens[i];
+    for (i = 0; i < DF_DISTS; i++)
+        bits += (unsigned long)ctx->dist_freq[i] * dlens[i];
+    return bits;
+}
+
+/*
+ * Send the symbols collected so far as one (non-final) block.
+ */
+static void deflate_flush_block(
+    struct DeflateContext *ctx, struct Outbuf *out)
+{
+    static const unsigned char clorder[DF_CLENS] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+    unsigned char llens[DF_LITLENS], dlens[DF_DISTS], clens[DF_CLENS];
+    unsigned short lcodes[DF_LITLENS], dcodes[DF_DISTS], clcodes[DF_CLENS];
+    unsigned char slens[DF_STATICLITLENS], sdlens[DF_DISTS];
+    unsigned short scodes[DF_STATICLITLENS], sdcodes[DF_DISTS];
+    unsigned char all[DF_LITLENS + DF_DISTS];
+    unsigned char clsyms[DF_LITLENS + DF_DISTS];
+    unsigned char clextras[DF_LITLENS + DF_DISTS];
+    unsigned clfreq[DF_CLENS];
+    unsigned long extra_bits, dyn_bits, static_bits, stored_bits;
+    int hlit, hdist, hclen, nclsyms, i;
+
+    if (ctx->nsyms == 0)
+        return;
+
+    ctx->litlen_freq[DF_EOB] = 1;
+
+    /* extra bits are the same regardless of the trees */
+    extra_bits = 0;
+    for (i = 0; i < lenof(lencodes); i++)
+        extra_bits += (unsigned long)ctx->litlen_freq[lencodes[i].code] *
+            lencodes[i].extrabits;
+    for (i = 0; i < lenof(distcodes); i++)
+        extra_bits += (unsigned long)ctx->dist_freq[distcodes[i].code] *
+            distcodes[i].extrabits;
+
+    deflate_build_lengths(ctx->litlen_freq, DF_LITLENS, DF_MAXBITS, llens);
+    deflate_build_lengths(ctx->dist_freq, DF_DISTS, DF_MAXBITS, dlens);
+    for (hlit = DF_LITLENS; hlit > 257 && llens[hlit - 1] == 0; hlit--);
+    for (hdist = DF_DISTS; hdist > 1 && dlens[hdist - 1] == 0; hdist--);
+    memcpy(all, llens, hlit);
+    memcpy(all + hlit, dlens, hdist);
+    nclsyms = deflate_rle_lengths(all, hlit + hdist, clsyms, clextras);
+    memset(clfreq, 0, sizeof(clfreq));
+    for (i = 0; i < nclsyms; i++)
+        clfreq[clsyms[i]]++;
+    deflate_build_lengths(clfreq, DF_CLENS, DF_MAXCLBITS, clens);
+    for (hclen = DF_CLENS; hclen > 4 && clens[clorder[hclen - 1]] == 0;
+         hclen--);
+
+    dyn_bits = 3 + 5 + 5 + 4 + 3 * hclen +
+        deflate_data_bits(ctx, llens, dlens) + extra_bits;
+    for (i = 0; i < nclsyms; i++)
+        dyn_bits += clens[clsyms[i]] +
+            (clsyms[i] == 16 ? 2 : clsyms[i] == 17 ? 3 :
+             clsyms[i] == 18 ? 7 : 0);
+
+    for (i = 0; i < DF_STATICLITLENS; i++)
+        slens[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    for (i = 0; i < DF_DISTS; i++)
+        sdlens[i] = 5;
+    static_bits = 3 + deflate_data_bits(ctx, slens, sdlens) + extra_bits;
+
+    /* header and padding of each stored block is at most 42 bits */
+    stored_bits = 8UL * ctx->block_bytes +
+        42UL * (ctx->block_bytes / 65535 + 1);
+
+    if (stored_bits < dyn_bits && stored_bits < static_bits) {
+        const unsigned char *data = ctx->window + ctx->block_start;
+        int left = ctx->block_bytes;
+        while (left > 0) {
+            int len = (left > 65535) ? 65535 : left;
+            outbits(out, 0, 3);        /* BFINAL=0, BTYPE=00 */
+            if (out->noutbits > 0)
+                outbits(out, 0, 8 - out->noutbits);
+            put_byte(out->outbuf, len & 0xFF);
+            put_byte(out->outbuf, (len >> 8) & 0xFF);
+            put_byte(out->outbuf, ~len & 0xFF);
+            put_byte(out->outbuf, (~len >> 8) & 0xFF);
+            put_data(out->outbuf, data, len);
+            data += len;
+            left -= len;
+        }
+    } else if (static_bits <= dyn_bits) {
+        deflate_make_codes(slens, DF_STATICLITLENS, scodes);
+        deflate_make_codes(sdlens, DF_DISTS, sdcodes);
+        outbits(out, 2, 3);            /* BFINAL=0, BTYPE=01 */
+        deflate_send_symbols(ctx, out, slens, scodes, sdlens, sdcodes);
+    } else {
+        deflate_make_codes(llens, DF_LITLENS, lcodes);
+        deflate_make_codes(dlens, DF_DISTS, dcodes);
+        deflate_make_codes(clens, DF_CLENS, clcodes);
+        outbits(out, 4, 3);            /* BFINAL=0, BTYPE=10 */
+        outbits(out, hlit - 257, 5);
+        outbits(out, hdist - 1, 5);
+        outbits(out, hclen - 4, 4);
+        for (i = 0; i < hclen; i++)
+            outbits(out, clens[clorder[i]], 3);
+        for (i = 0; i < nclsyms; i++) {
+            int s = clsyms[i];
+            outbits(out, clcodes[s], clens[s]);
+            if (s == 16)
+                outbits(out, clextras[i], 2);
+            else if (s == 17)
+                outbits(out, clextras[i], 3);
+            else if (s == 18)
+                outbits(out, clextras[i], 7);
+        }
+        deflate_send_symbols(ctx, out, llens, lcodes, dlens, dcodes);
+    }
+
+    ctx->nsyms = 0;
+    memset(ctx->litlen_freq, 0, sizeof(ctx->litlen_freq));
+    memset(ctx->dist_freq, 0, sizeof(ctx->dist_freq));
+    ctx->block_start += ctx->block_bytes;
+    ctx->block_bytes = 0;
+}
+
+/*
+ * Move the upper half of the window down to make room for more data.
+ */
+static void deflate_slide(struct DeflateContext *ctx, struct Outbuf *out)
+{
+    int i;
+
+    assert(ctx->strstart >= DF_WSIZE + DF_MAXDIST);
+    /* data of the current block must stay available for a stored block */
+    if (ctx->block_start < DF_WSIZE)
+        deflate_flush_block(ctx, out);
+
+    memcpy(ctx->window, ctx->window + DF_WSIZE, DF_WSIZE);
+    ctx->strstart -= DF_WSIZE;
+    ctx->filled -= DF_WSIZE;
+    ctx->match_start -= DF_WSIZE;
+    ctx->block_start -= DF_WSIZE;
+    for (i = 0; i < DF_HASHSIZE; i++)
+        ctx->head[i] = (ctx->head[i] >= DF_WSIZE) ?
+            ctx->head[i] - DF_WSIZE : DF_NIL;
+    for (i = 0; i < DF_WSIZE; i++)
+        ctx->prev[i] = (ctx->prev[i] >= DF_WSIZE) ?
+            ctx->prev[i] - DF_WSIZE : DF_NIL;
+}
+
+/*
+ * Find matches over the data in the window. Unless flushing, enough
+ * data is left unprocessed for the longest possible match.
+ */
+static void deflate_greedy(
+    struct DeflateContext *ctx, struct Outbuf *out, bool flush)
+{
+    int end = flush ? ctx->filled : ctx->filled - DF_MINLOOKAHEAD;
+
+    while (ctx->strstart < end) {
+        int hash_head = DF_NIL, len = 0;
+        bool full;
+
+        if (ctx->filled - ctx->strstart >= DF_MINMATCH)
+            hash_head = deflate_insert(ctx, ctx->strstart);
+        if (hash_head != DF_NIL &&
+            ctx->strstart - hash_head <= DF_MAXDIST) {
+            ctx->prev_length = DF_MINMATCH - 1;
+            len = deflate_longest_match(ctx, hash_head);
+        }
+
+        if (len >= DF_MINMATCH) {
+            full = deflate_tally(ctx, ctx->strstart - ctx->match_start, len);
+            if (len <= ctx->level->max_lazy) {
+                while (--len > 0) {
+                    ctx->strstart++;
+                    if (ctx->filled - ctx->strstart >= DF_MINMATCH)
+                        deflate_insert(ctx, ctx->strstart);
+                }
+                ctx->strstart++;
+            } else {
+                ctx->strstart += len;
+            }
+        } else {
+            full = deflate_tally(ctx, 0, ctx->window[ctx->strstart]);
+            ctx->strstart++;
+        }
+        if (full)
+            deflate_flush_block(ctx, out);
+    }
+}
+
+/*
+ * As above, but having found a match, see if there is a better one at
+ * the next position, and if so, emit a literal instead of the first.
+ */
+static void deflate_lazy(
+    struct DeflateContext *ctx, struct Outbuf *out, bool flush)
+{
+    int end = flush ? ctx->filled : ctx->filled - DF_MINLOOKAHEAD;
+
+    while (ctx->strstart < end) {
+        int hash_head = DF_NIL, prev_match;
+
+        if (ctx->filled - ctx->strstart >= DF_MINMATCH)
+            hash_head = deflate_insert(ctx, ctx->strstart);
+
+        ctx->prev_length = ctx->match_length;
+        prev_match = ctx->match_start;
+        ctx->match_length = DF_MINMATCH - 1;
+
+        if (hash_head != DF_NIL &&
+            ctx->prev_length < ctx->level->max_lazy &&
+            ctx->strstart - hash_head <= DF_MAXDIST) {
+            ctx->match_length = deflate_longest_match(ctx, hash_head);
+            if (ctx->match_length == DF_MINMATCH &&
+                ctx->strstart - ctx->match_start > DF_TOOFAR)
+                ctx->match_length = DF_MINMATCH - 1;
+        }
+
+        if (ctx->prev_length >= DF_MINMATCH &&
+            ctx->match_length <= ctx->prev_length) {
+            /* the match at the previous position is the better one */
+            int last = ctx->strstart - 1 + ctx->prev_length;
+            bool full = deflate_tally(
+                ctx, ctx->strstart - 1 - prev_match, ctx->prev_length);
+            while (++ctx->strstart < last) {
+                if (ctx->filled - ctx->strstart >= DF_MINMATCH)
+                    deflate_insert(ctx, ctx->strstart);
+            }
+            ctx->match_available = false;
+            ctx->match_length = DF_MINMATCH - 1;
+            if (full)
+                deflate_flush_block(ctx, out);
+        } else if (ctx->match_available) {
+            if (deflate_tally(ctx, 0, ctx->window[ctx->strstart - 1]))
+                deflate_flush_block(ctx, out);
+            ctx->strstart++;
+        } else {
+            ctx->match_available = true;
+            ctx->strstart++;
+        }
+    }
+
+    if (flush && ctx->match_available) {
+        deflate_tally(ctx, 0, ctx->window[ctx->strstart - 1]);
+        ctx->match_available = false;
+        ctx->match_length = DF_MINMATCH - 1;
+    }
+}
+
+static void deflate_compress(
+    struct DeflateContext *ctx, struct Outbuf *out,
+    const unsigned char *data, int len)
+{
+    bool flush;
+
+    do {
+        int n;
+
+        if (ctx->filled == 2 * DF_WSIZE)
+            deflate_slide(ctx, out);
+        n = 2 * DF_WSIZE - ctx->filled;
+        if (n > len)
+            n = len;
+        memcpy(ctx->window + ctx->filled, data, n);
+        ctx->filled += n;
+        data += n;
+        len -= n;
+
+        flush = (len == 0);
+        if (ctx->level->lazy)
+            deflate_lazy(ctx, out, flush);
+        else
+            deflate_greedy(ctx, out, flush);
+    } while (!flush);
+
+    deflate_flush_block(ctx, out);
+}
+#endif
+
 struct ssh_zlib_compressor {
     struct LZ77Context ectx;
+#ifdef WINSCP
+    /* Adler-32 of the uncompressed data, for zlib_compress_finish */
+    unsigned long adler_a, adler_b;
+    /* if non-NULL, used instead of ectx */
+    struct DeflateContext *deflate;
+#endif
     ssh_compressor sc;
 };
 
+#ifdef WINSCP
+#define ADLER_BASE 65521
+#define ADLER_NMAX 5552
+
+static void zlib_adler32(unsigned long *adler_a, unsigned long *adler_b,
+                         const unsigned char *data, int len)
+{
+    unsigned long a = *adler_a, b = *adler_b;
+    while (len > 0) {
+        int n = (len < ADLER_NMAX) ? len : ADLER_NMAX;
+        len -= n;
+        while (n-- > 0) {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    *adler_a = a;
+    *adler_b = b;
+}
+#endif
+
+#ifdef WINSCP
+static ssh_compressor *zlib_compress_init_level(int level)
+#else
 static ssh_compressor *zlib_compress_init(void)
+#endif
 {
     struct Outbuf *out;
     struct ssh_zlib_compressor *comp = snew(struct ssh_zlib_compressor);
 
+#ifdef WINSCP
+    comp->deflate = (level > 0) ? deflate_new(level) : NULL;
+    if (comp->deflate)
+        comp->ectx.ictx = NULL;
+    else
+#endif
     lz77_init(&comp->ectx);
     comp->sc.vt = &ssh_zlib;
+#ifdef WINSCP
+    comp->adler_a = 1;
+    comp->adler_b = 0;
+#endif
     comp->ectx.literal = zlib_literal;
     comp->ectx.match = zlib_match;
 
@@ -592,6 +1342,13 @@ static ssh_compressor *zlib_compress_init(void)
     return &comp->sc;
 }
 
+#ifdef WINSCP
+static ssh_compressor *zlib_compress_init(void)
+{
+    return zlib_compress_init_level(0);
+}
+#endif
+
 static void zlib_compress_cleanup(ssh_compressor *sc)
 {
     struct ssh_zlib_compressor *comp =
@@ -601,6 +1358,9 @@ static void zlib_compress_cleanup(ssh_compressor *sc)
         strbuf_free(out->outbuf);
     sfree(out);
     sfree(comp->ectx.ictx);
+#ifdef WINSCP
+    sfree(comp->deflate);
+#endif
     sfree(comp);
 }
 
@@ -629,6 +1389,27 @@ static void zlib_compress_block(
     } else
         in_block = true;
 
+#ifdef WINSCP
+    if (comp->deflate) {
+        /*
+         * The engine leaves no block open, so just follow its blocks
+         * with an empty static one, as the partial flush below does,
+         * and pad with more of those.
+         */
+        deflate_compress(comp->deflate, out, block, len);
+        zlib_adler32(&comp->adler_a, &comp->adler_b, block, len);
+        do {
+            outbits(out, 2, 3);        /* empty static block */
+            outbits(out, 0, 7);
+        } while (out->outbuf->len < minlen);
+
+        *outlen = out->outbuf->len;
+        *outblock = (unsigned char *)strbuf_to_str(out->outbuf);
+        out->outbuf = NULL;
+        return;
+    }
+#endif
+
     if (!in_block) {
         /*
          * Start a Deflate (RFC1951) fixed-trees block. We
@@ -643,6 +1424,9 @@ static void zlib_compress_block(
      * Do the compression.
      */
     lz77_compress(&comp->ectx, block, len);
+#ifdef WINSCP
+    zlib_adler32(&comp->adler_a, &comp->adler_b, block, len);
+#endif
 
     /*
      * End the block (by transmitting code 256, which is
@@ -686,6 +1470,47 @@ static void zlib_compress_block(
     out->outbuf = NULL;
 }
 
+#ifdef WINSCP
+/*
+ * Terminate the stream properly, as SSH never does, but FTP MODE Z
+ * (where the zlib stream spans the whole data connection) needs to:
+ * close the currently open block, emit an empty final static block,
+ * align to byte boundary and append the Adler-32 trailer.
+ */
+void zlib_compress_finish(
+    ssh_compressor *sc, unsigned char **outblock, int *outlen)
+{
+    struct ssh_zlib_compressor *comp =
+        container_of(sc, struct ssh_zlib_compressor, sc);
+    struct Outbuf *out = (struct Outbuf *) comp->ectx.userdata;
+    unsigned long adler;
+
+    assert(!out->outbuf);
+    out->outbuf = strbuf_new_nm();
+
+    if (out->firstblock) {
+        outbits(out, 0x9C78, 16);
+        out->firstblock = false;
+    } else if (!comp->deflate) {
+        outbits(out, 0, 7);            /* close block */
+    }
+    outbits(out, 3, 3);                /* open final static block */
+    outbits(out, 0, 7);                /* and close it */
+    if (out->noutbits > 0)
+        outbits(out, 0, 8 - out->noutbits);
+
+    adler = (comp->adler_b << 16) | comp->adler_a;
+    put_byte(out->outbuf, (adler >> 24) & 0xFF);
+    put_byte(out->outbuf, (adler >> 16) & 0xFF);
+    put_byte(out->outbuf, (adler >> 8) & 0xFF);
+    put_byte(out->outbuf, adler & 0xFF);
+
+    *outlen = out->outbuf->len;
+    *outblock = (unsigned char *)strbuf_to_str(out->outbuf);
+    out->outbuf = NULL;
+}
+#endif
+
 /* ----------------------------------------------------------------------
  * Zlib decompression. Of course, even though our compressor always
  * uses static trees, our _decompressor_ has to be capable of
@@ -844,10 +1669,21 @@ struct zlib_decompress_ctx {
         TREES_HDR, TREES_LENLEN, TREES_LEN, TREES_LENREP,
         INBLK, GOTLENSYM, GOTLEN, GOTDISTSYM,
         UNCOMP_LEN, UNCOMP_NLEN, UNCOMP_DATA
+#ifdef WINSCP
+        , TRAILER, FINISHED
+#endif
     } state;
     int sym, hlit, hdist, hclen, lenptr, lenextrabits, lenaddon, len,
         lenrep;
     int uncomplen;
+#ifdef WINSCP
+    bool lastblock;
+    /* Adler-32 of the data output so far, to verify the trailer */
+    unsigned long adler_a, adler_b;
+    size_t adlerpos;
+    unsigned long trailer;
+    int trailerlen;
+#endif
     unsigned char lenlen[19];
 
     /*
@@ -916,6 +1752,14 @@ static ssh_decompressor *zlib_decompress_init(void)
     memset(lengths, 5, 32);
     dctx->staticdisttable = zlib_mktable(lengths, 32);
     dctx->state = START;                       /* even before header */
+#ifdef WINSCP
+    dctx->lastblock = false;
+    dctx->adler_a = 1;
+    dctx->adler_b = 0;
+    dctx->adlerpos = 0;
+    dctx->trailer = 0;
+    dctx->trailerlen = 0;
+#endif
     dctx->currlentable = dctx->currdisttable = dctx->lenlentable = NULL;
     dctx->bits = 0;
     dctx->nbits = 0;
@@ -985,6 +1829,25 @@ static void zlib_emit_char(struct zlib_decompress_ctx *dctx, int c)
 
 #define EATBITS(n) ( dctx->nbits -= (n), dctx->bits >>= (n) )
 
+#ifdef WINSCP
+/*
+ * SSH never sets BFINAL, but FTP MODE Z streams do. After the final
+ * block, verify the Adler-32 trailer instead of trying to decode it
+ * as another block header, and skip anything that follows.
+ */
+#define BLOCKEND ( dctx->lastblock ? TRAILER : OUTSIDEBLK )
+
+static void zlib_decompress_adler32(struct zlib_decompress_ctx *dctx)
+{
+    zlib_adler32(&dctx->adler_a, &dctx->adler_b,
+                 dctx->outblk->u + dctx->adlerpos,
+                 (int)(dctx->outblk->len - dctx->adlerpos));
+    dctx->adlerpos = dctx->outblk->len;
+}
+#else
+#define BLOCKEND OUTSIDEBLK
+#endif
+
 static bool zlib_decompress_block(
     ssh_decompressor *dc, const unsigned char *block, int len,
     unsigned char **outblock, int *outlen)
@@ -999,6 +1862,9 @@ static bool zlib_decompress_block(
 
     assert(!dctx->outblk);
     dctx->outblk = strbuf_new_nm();
+#ifdef WINSCP
+    dctx->adlerpos = 0;
+#endif
 
     while (len > 0 || dctx->nbits > 0) {
         while (dctx->nbits < 24 && len > 0) {
@@ -1043,6 +1909,9 @@ static bool zlib_decompress_block(
             /* Expect 3-bit block header. */
             if (dctx->nbits < 3)
                 goto finished;         /* done all we can */
+#ifdef WINSCP
+            dctx->lastblock = ((dctx->bits & 1) != 0);
+#endif
             EATBITS(1);
             blktype = dctx->bits & 3;
             EATBITS(2);
@@ -1139,7 +2008,7 @@ static bool zlib_decompress_block(
             if (code < 256)
                 zlib_emit_char(dctx, code);
             else if (code == 256) {
-                dctx->state = OUTSIDEBLK;
+                dctx->state = BLOCKEND;
                 if (dctx->currlentable != dctx->staticlentable) {
                     zlib_freetable(&dctx->currlentable);
                     dctx->currlentable = NULL;
@@ -1212,7 +2081,7 @@ static bool zlib_decompress_block(
             if (dctx->uncomplen != (nlen ^ 0xFFFF))
                 goto decode_error;
             if (dctx->uncomplen == 0)
-                dctx->state = OUTSIDEBLK;       /* block is empty */
+                dctx->state = BLOCKEND;         /* block is empty */
             else
                 dctx->state = UNCOMP_DATA;
             break;
@@ -1222,12 +2091,36 @@ static bool zlib_decompress_block(
             zlib_emit_char(dctx, dctx->bits & 0xFF);
             EATBITS(8);
             if (--dctx->uncomplen == 0)
-                dctx->state = OUTSIDEBLK;       /* end of uncompressed block */
+                dctx->state = BLOCKEND;         /* end of uncompressed block */
             break;
+#ifdef WINSCP
+          case TRAILER:
+            /* The trailer starts on a byte boundary */
+            rep = dctx->nbits % 8;     /* EATBITS evaluates its argument twice */
+            EATBITS(rep);
+            if (dctx->nbits < 8)
+                goto finished;
+            /* Stored as a big-endian 32-bit integer */
+            dctx->trailer = (dctx->trailer << 8) | (dctx->bits & 0xFF);
+            EATBITS(8);
+            if (++dctx->trailerlen == 4) {
+                zlib_decompress_adler32(dctx);
+                if (dctx->trailer != ((dctx->adler_b << 16) | dctx->adler_a))
+                    goto decode_error;
+                dctx->state = FINISHED;
+            }
+            break;
+          case FINISHED:
+            EATBITS(dctx->nbits);
+            break;
+#endif
         }
     }
 
   finished:
+#ifdef WINSCP
+    zlib_decompress_adler32(dctx);
+#endif
     *outlen = dctx->outblk->len;
     *outblock = (unsigned char *)strbuf_to_str(dctx->outblk);
     dctx->outblk = NULL;
@@ -1239,10 +2132,26 @@ static bool zlib_decompress_block(
     return false;
 }
 
+#ifdef WINSCP
+/*
+ * Whether the final block and the matching Adler-32 trailer were
+ * decoded, i.e. whether the FTP MODE Z stream was not truncated.
+ */
+bool zlib_decompress_finished(ssh_decompressor *dc)
+{
+    struct zlib_decompress_ctx *dctx =
+        container_of(dc, struct zlib_decompress_ctx, dc);
+    return (dctx->state == FINISHED);
+}
+#endif
+
 const ssh_compression_alg ssh_zlib = {
     .name = "zlib",
     .delayed_name = "zlib@openssh.com", /* delayed version */
     .compress_new = zlib_compress_init,
+#ifdef WINSCP
+    .compress_new_level = zlib_compress_init_level,
+#endif
     .compress_free = zlib_compress_cleanup,
     .compress = zlib_compress_block,
     .decompress_new = zlib_decompress_init,
@@ -0,0 +1,97 @@
+/*
+ * worker-thread.c: run jobs on a separate thread, one at a time, and
+ * let the main thread know through the handle-wait mechanism when
+ * each of them is done.
+ */
+
+#include "putty.h"
+
+struct WorkerThread {
+    HANDLE thread;
+    HANDLE start_event, done_event;
+    LONG busy;
+    bool quit;
+    worker_thread_job_fn_t job;
+    void *job_ctx;
+    IdempotentCallback *done_ic;
+    HandleWait *hw;
+};
+
+static DWORD WINAPI worker_thread_main(void *param)
+{
+    WorkerThread *wt = (WorkerThread *)param;
+
+    while (true) {
+        WaitForSingleObject(wt->start_event, INFINITE);
+        if (wt->quit)
+            break;
+        wt->job(wt->job_ctx);
+        /* the interlocked operation makes the job's results visible
+         * to the main thread before it can see the job finished */
+        InterlockedExchange(&wt->busy, 0);
+        SetEvent(wt->done_event);
+    }
+
+    return 0;
+}
+
+static bool worker_thread_done_callback(
+    struct callback_set * callback_set, void *vctx)
+{
+    WorkerThread *wt = (WorkerThread *)vctx;
+    queue_idempotent_callback(wt->done_ic);
+    return true;
+}
+
+WorkerThread *worker_thread_new(IdempotentCallback *done_ic)
+{
+    WorkerThread *wt = snew(WorkerThread);
+    DWORD threadid;
+
+    wt->busy = 0;
+    wt->quit = false;
+    wt->job = NULL;
+    wt->job_ctx = NULL;
+    wt->done_ic = done_ic;
+    wt->start_event = CreateEvent(NULL, false, false, NULL);
+    wt->done_event = CreateEvent(NULL, false, false, NULL);
+    wt->thread = CreateThread(NULL, 0, worker_thread_main, wt, 0, &threadid);
+    if (!wt->thread) {
+        CloseHandle(wt->start_event);
+        CloseHandle(wt->done_event);
+        sfree(wt);
+        return NULL;
+    }
+    wt->hw = add_handle_wait(
+        done_ic->set, wt->done_event, worker_thread_done_callback, wt);
+
+    return wt;
+}
+
+void worker_thread_run(WorkerThread *wt, worker_thread_job_fn_t job, void *ctx)
+{
+    assert(!worker_thread_busy(wt));
+    wt->job = job;
+    wt->job_ctx = ctx;
+    InterlockedExchange(&wt->busy, 1);
+    SetEvent(wt->start_event);
+}
+
+bool worker_thread_busy(WorkerThread *wt)
+{
+    return (InterlockedCompareExchange(&wt->busy, 0, 0) != 0);
+}
+
+void worker_thread_free(WorkerThread *wt)
+{
+    /* lets a running job finish first */
+    wt->quit = true;
+    SetEvent(wt->start_event);
+    WaitForSingleObject(wt->thread, INFINITE);
+    CloseHandle(wt->thread);
+
+    delete_handle_wait(wt->done_ic->set, wt->hw);
+    CloseHandle(wt->start_event);
+    CloseHandle(wt->done_event);
+    sfree(wt);
+}
@@ -8,7 +8,7 @@
 #define SCRIPT_SESSION_HELP     8
 #define SCRIPT_PWD_HELP         9
 #define SCRIPT_CD_HELP          10
-#define SCRIPT_LS_HELP2         11
+#define SCRIPT_LS_HELP3         11
 #define SCRIPT_LPWD_HELP        12
 #define SCRIPT_LCD_HELP         13
 #define SCRIPT_LLS_HELP2        14
@@ -22,12 +22,12 @@
 #define SCRIPT_PUT_HELP8        22
 #define SCRIPT_OPTION_HELP7     23
 #define SCRIPT_SYNCHRONIZE_HELP7 24
-#define SCRIPT_KEEPUPTODATE_HELP5 25
+#define SCRIPT_KEEPUPTODATE_HELP6 25
 #define SCRIPT_CALL_HELP2       26
 #define SCRIPT_ECHO_HELP        27
 #define SCRIPT_STAT_HELP        28
 #define SCRIPT_CHECKSUM_HELP    29
-#define SCRIPT_CP_HELP          30
+#define SCRIPT_CP_HELP2         30
 
 #define CORE_ERROR_STRINGS      100
 #define KEY_NOT_VERIFIED        101
@@ -297,6 +297,8 @@
 #define ANCESTOR_TARGET_ERROR   786
 #define WEBDAV_CROSS_DOMAIN_REDIR 787
 #define INVALID_FILENAME        788
+#define STREAM_COPY_SCRIPT_ERROR 789
+#define KEEPUPTODATE_TWOWAY_PRESERVETIME 790
 
 #define CORE_CONFIRMATION_STRINGS 300
 #define CONFIRM_PROLONG_TIMEOUT3 301
@@ -719,6 +719,7 @@
 #define SYNCHRONIZE_PROGRESS_RIGHT_DIR 6220
 #define SYNCHRONIZE_CHECKLIST_LEFT_DIR 6221
 #define SYNCHRONIZE_CHECKLIST_RIGHT_DIR 6222
+#define CLEANUP_THUMBNAILS      6223
 
 // 2xxx is reserved for TextsFileZilla.h
 
@@ -43,6 +43,7 @@ public:
     UnicodeString Message);
   virtual bool __fastcall HasFlag(TConsoleFlag Flag) const;
   virtual bool __fastcall PendingAbort();
+  virtual void __fastcall Idle();
   virtual void __fastcall SetTitle(UnicodeString Title);
   virtual void __fastcall WaitBeforeExit();
   virtual void __fastcall Progress(TScriptProgress & Progress);
@@ -240,6 +241,11 @@ bool __fastcall TOwnConsole::PendingAbort()
   }
 }
 //---------------------------------------------------------------------------
+void __fastcall TOwnConsole::Idle()
+{
+  // noop
+}
+//---------------------------------------------------------------------------
 void __fastcall TOwnConsole::Print(UnicodeString Str, bool FromBeginning, bool /*Error*/)
 {
   if (FromBeginning)
@@ -524,6 +530,7 @@ public:
     UnicodeString Message);
   virtual bool __fastcall HasFlag(TConsoleFlag Flag) const;
   virtual bool __fastcall PendingAbort();
+  virtual void __fastcall Idle();
   virtual void __fastcall SetTitle(UnicodeString Title);
   virtual void __fastcall WaitBeforeExit();
   virtual void __fastcall Progress(TScriptProgress & Progress);
@@ -547,10 +554,17 @@ private:
   unsigned int FMaxSend;
   // Particularly FTP calls TransferOut/In from other thread
   std::unique_ptr<TCriticalSection> FSection;
+  UnicodeString FPrintBuffer;
+  int FPrintBufferSize;
+  bool FPrintBufferError;
+  unsigned int FPrintBufferStart;
 
   inline TConsoleCommStruct * __fastcall GetCommStruct();
   inline void __fastcall FreeCommStruct(TConsoleCommStruct * CommStruct);
   inline void __fastcall SendEvent(int Timeout);
+  void DoPrint(UnicodeString Str, bool FromBeginning, bool Error);
+  void FlushPrint();
+  void FlushAgedPrint();
   void __fastcall Init();
   void __fastcall CheckHandle(HANDLE Handle, const UnicodeString & Desc);
 };
@@ -565,6 +579,9 @@ __fastcall TExternalConsole::TExternalConsole(
   CheckHandle(FResponseEvent = OpenEvent(EVENT_ALL_ACCESS, false, Name.c_str()), L"Response event");
   Name = FORMAT(L"%s%s", (CONSOLE_EVENT_CANCEL, (Instance)));
   CheckHandle(FCancelEvent = OpenEvent(EVENT_ALL_ACCESS, false, Name.c_str()), L"Cancel event");
+  // Log event is created only by .NET assembly, so we do not open it here,
+  // the XML log opens it, when it is used
+  Configuration->ActionsLogEventName = FORMAT(L"%s%s", (CONSOLE_EVENT_LOG, (Instance)));
   Name = FORMAT(L"%s%s", (CONSOLE_MAPPING, (Instance)));
   CheckHandle(FFileMapping = OpenFileMapping(FILE_MAP_ALL_ACCESS, false, Name.c_str()), L"File mapping");
 
@@ -590,6 +607,8 @@ __fastcall TExternalConsole::TExternalConsole(
     }
 
     CommStruct->Version = TConsoleCommStruct::CurrentVersionConfirmed;
+    // Batched output is sent in print events of up to this size, so that it does not need to be split
+    FPrintBufferSize = static_cast<int>(std::size(CommStruct->PrintEvent.Message) - 1);
   }
   __finally
   {
@@ -604,12 +623,22 @@ __fastcall TExternalConsole::TExternalConsole(
   FStdOut = StdOut;
   FStdIn = StdIn;
   FMaxSend = 0;
+  FPrintBufferError = false;
+  FPrintBufferStart = 0;
 
   Init();
 }
 //---------------------------------------------------------------------------
 __fastcall TExternalConsole::~TExternalConsole()
 {
+  try
+  {
+    FlushPrint();
+  }
+  catch (...)
+  {
+    // the console is likely gone already
+  }
   CloseHandle(FRequestEvent);
   CloseHandle(FResponseEvent);
   CloseHandle(FCancelEvent);
@@ -673,9 +702,64 @@ UnicodeString __fastcall TExternalConsole::FinalLogMessage()
   return FORMAT(L"Max roundtrip: %d", (static_cast<int>(FMaxSend)));
 }
 //---------------------------------------------------------------------------
+// Buffered output is flushed at latest after this time (checked on the next print, abort poll or idle)
+static const unsigned int PrintBufferMaxDelay = 200;
+//---------------------------------------------------------------------------
 void __fastcall TExternalConsole::Print(UnicodeString Str, bool FromBeginning, bool Error)
 {
   TGuard Guard(FSection.get());
+  // With disk/pipe output, a round trip for every line dominates scripts that print a lot
+  // (like ls of huge directories or get/put of many files).
+  // Batch the output there, the consoles handle multiple lines in one print event.
+  // FromBeginning prints are not batched as they overwrite the last line.
+  if (!FLiveOutput && !FromBeginning)
+  {
+    if (!FPrintBuffer.IsEmpty() && (FPrintBufferError != Error))
+    {
+      FlushPrint();
+    }
+    if (FPrintBuffer.IsEmpty())
+    {
+      FPrintBufferError = Error;
+      FPrintBufferStart = GetTickCount();
+    }
+    FPrintBuffer += Str;
+    if ((FPrintBuffer.Length() >= FPrintBufferSize) ||
+        (GetTickCount() - FPrintBufferStart >= PrintBufferMaxDelay))
+    {
+      FlushPrint();
+    }
+  }
+  else
+  {
+    FlushPrint();
+    DoPrint(Str, FromBeginning, Error);
+  }
+}
+//---------------------------------------------------------------------------
+void TExternalConsole::FlushPrint()
+{
+  // Expects that FSection is already locked
+  if (!FPrintBuffer.IsEmpty())
+  {
+    UnicodeString Str = FPrintBuffer;
+    FPrintBuffer = UnicodeString();
+    DoPrint(Str, false, FPrintBufferError);
+  }
+}
+//---------------------------------------------------------------------------
+void TExternalConsole::FlushAgedPrint()
+{
+  TGuard Guard(FSection.get());
+  if (!FPrintBuffer.IsEmpty() &&
+      (GetTickCount() - FPrintBufferStart >= PrintBufferMaxDelay))
+  {
+    FlushPrint();
+  }
+}
+//---------------------------------------------------------------------------
+void TExternalConsole::DoPrint(UnicodeString Str, bool FromBeginning, bool Error)
+{
   // need to do at least one iteration, even when Str is empty (new line)
   do
   {
@@ -712,6 +796,7 @@ void __fastcall TExternalConsole::Print(UnicodeString Str, bool FromBeginning, b
 bool __fastcall TExternalConsole::Input(UnicodeString & Str, bool Echo, unsigned int Timer)
 {
   TGuard Guard(FSection.get());
+  FlushPrint();
   TConsoleCommStruct * CommStruct = GetCommStruct();
   try
   {
@@ -749,6 +834,7 @@ int __fastcall TExternalConsole::Choice(
   UnicodeString Message)
 {
   TGuard Guard(FSection.get());
+  FlushPrint();
   TConsoleCommStruct * CommStruct = GetCommStruct();
   try
   {
@@ -790,12 +876,21 @@ int __fastcall TExternalConsole::Choice(
 //---------------------------------------------------------------------------
 bool __fastcall TExternalConsole::PendingAbort()
 {
+  // Polled regularly during operations, so use it to release stale buffered output
+  FlushAgedPrint();
   return (WaitForSingleObject(FCancelEvent, 0) == WAIT_OBJECT_0);
 }
 //---------------------------------------------------------------------------
+void __fastcall TExternalConsole::Idle()
+{
+  // Output printed before a wait (like keepuptodate) should not be held back for long
+  FlushAgedPrint();
+}
+//---------------------------------------------------------------------------
 void __fastcall TExternalConsole::SetTitle(UnicodeString Title)
 {
   TGuard Guard(FSection.get());
+  FlushPrint();
   TConsoleCommStruct * CommStruct = GetCommStruct();
   try
   {
@@ -886,12 +981,14 @@ bool __fastcall TExternalConsole::HasFlag(TConsoleFlag Flag) const
 //---------------------------------------------------------------------------
 void __fastcall TExternalConsole::WaitBeforeExit()
 {
-  // noop
+  TGuard Guard(FSection.get());
+  FlushPrint();
 }
 //---------------------------------------------------------------------------
 void __fastcall TExternalConsole::Progress(TScriptProgress & Progress)
 {
   TGuard Guard(FSection.get());
+  FlushPrint();
   TConsoleCommStruct * CommStruct = GetCommStruct();
 
   typedef TConsoleCommStruct::TProgressEvent TProgressEvent;
@@ -953,6 +1050,7 @@ void __fastcall TExternalConsole::Progress(TScriptProgress & Progress)
 void __fastcall TExternalConsole::TransferOut(const unsigned char * Data, size_t Len)
 {
   TGuard Guard(FSection.get());
+  FlushPrint();
   DebugAssert((Data == NULL) == (Len == 0));
   size_t Offset = 0;
   do
@@ -978,6 +1076,7 @@ void __fastcall TExternalConsole::TransferOut(const unsigned char * Data, size_t
 size_t __fastcall TExternalConsole::TransferIn(unsigned char * Data, size_t Len)
 {
   TGuard Guard(FSection.get());
+  FlushPrint();
   size_t Offset = 0;
   size_t Result = 0;
   while ((Result == Offset) && (Offset < Len))
@@ -1031,6 +1130,7 @@ public:
     UnicodeString Message);
   virtual bool __fastcall HasFlag(TConsoleFlag Flag) const;
   virtual bool __fastcall PendingAbort();
+  virtual void __fastcall Idle();
   virtual void __fastcall SetTitle(UnicodeString Title);
   virtual void __fastcall WaitBeforeExit();
 
@@ -1077,6 +1177,11 @@ bool __fastcall TNullConsole::PendingAbort()
   return false;
 }
 //---------------------------------------------------------------------------
+void __fastcall TNullConsole::Idle()
+{
+  // noop
+}
+//---------------------------------------------------------------------------
 void __fastcall TNullConsole::SetTitle(UnicodeString /*Title*/)
 {
   // noop
@@ -1189,11 +1294,19 @@ private:
     TSynchronizeLogEntry Entry, const UnicodeString Message);
   void __fastcall ScriptSynchronizeStartStop(TScript * Script,
     const UnicodeString LocalDirectory, const UnicodeString RemoteDirectory,
-    const TCopyParamType & CopyParam, int SynchronizeParams);
+    const TCopyParamType & CopyParam, int SynchronizeParams, bool RemoteChanges);
   void __fastcall SynchronizeControllerSynchronize(TSynchronizeController * Sender,
     const UnicodeString LocalDirectory, const UnicodeString RemoteDirectory,
     const TCopyParamType & CopyParam, const TSynchronizeParamType & Params,
     TSynchronizeChecklist ** Checklist, TSynchronizeOptions * Options, bool Full);
+  void __fastcall SynchronizeControllerRemoteChange(TSynchronizeController * Sender,
+    const UnicodeString LocalDirectory, const UnicodeString RemoteDirectory,
+    const TCopyParamType & CopyParam, const TSynchronizeParamType & Params,
+    TSynchronizeChecklist ** Checklist, TSynchronizeOptions * Options, bool Full);
+  void __fastcall KeepUpToDateSynchronize(
+    const UnicodeString & LocalDirectory, const UnicodeString & RemoteDirectory, TTerminal::TSynchronizeMode Mode,
+    const TCopyParamType & CopyParam, const TSynchronizeParamType & Params,
+    TSynchronizeChecklist ** Checklist, TSynchronizeOptions * Options);
   void __fastcall SynchronizeControllerSynchronizeInvalid(TSynchronizeController * Sender,
     const UnicodeString Directory, const UnicodeString ErrorStr);
   void __fastcall SynchronizeControllerTooManyDirectories(TSynchronizeController * Sender,
@@ -1218,6 +1331,7 @@ TConsoleRunner::TConsoleRunner(TConsole * Console) :
   FScript = NULL;
   FAborted = false;
   FBatchScript = false;
+  FSynchronizeController.OnRemoteChange = SynchronizeControllerRemoteChange;
   Timer = new TTimer(Application);
   Timer->OnTimer = TimerTimer;
   Timer->Interval = MSecsPerSec;
@@ -1243,6 +1357,7 @@ void __fastcall TConsoleRunner::TimerTimer(TObject * /*Sender*/)
 {
   // sole presence of timer causes message to be dispatched,
   // hence breaks the loops
+  FConsole->Idle();
 }
 //---------------------------------------------------------------------------
 unsigned int TConsoleRunner::InputTimeout()
@@ -1812,13 +1927,13 @@ void __fastcall TConsoleRunner::ScriptQueryCancel(TScript * /*Script*/, bool & C
 //---------------------------------------------------------------------------
 void __fastcall TConsoleRunner::ScriptSynchronizeStartStop(TScript * /*Script*/,
   const UnicodeString LocalDirectory, const UnicodeString RemoteDirectory,
-  const TCopyParamType & CopyParam, int SynchronizeParams)
+  const TCopyParamType & CopyParam, int SynchronizeParams, bool RemoteChanges)
 {
   TSynchronizeParamType Params;
   Params.LocalDirectory = LocalDirectory;
   Params.RemoteDirectory = RemoteDirectory;
   Params.Params = SynchronizeParams;
-  Params.Options = soRecurse;
+  Params.Options = soRecurse | FLAGMASK(RemoteChanges, soRemoteChanges);
 
   FSynchronizeController.StartStop(Application, true, Params,
     CopyParam, NULL, SynchronizeControllerAbort, NULL,
@@ -1832,6 +1947,7 @@ void __fastcall TConsoleRunner::ScriptSynchronizeStartStop(TScript * /*Script*/,
     {
       Application->HandleMessage();
       FScript->Terminal->Idle();
+      FSynchronizeController.PollRemoteChanges(FScript->Terminal);
     }
   }
   __finally
@@ -1876,26 +1992,45 @@ void __fastcall TConsoleRunner::SynchronizeControllerSynchronize(
   TSynchronizeController * /*Sender*/, const UnicodeString LocalDirectory,
   const UnicodeString RemoteDirectory, const TCopyParamType & CopyParam,
   const TSynchronizeParamType & Params, TSynchronizeChecklist ** Checklist,
-  TSynchronizeOptions * /*Options*/, bool Full)
+  TSynchronizeOptions * Options, bool Full)
 {
   if (!Full)
   {
-    try
+    KeepUpToDateSynchronize(LocalDirectory, RemoteDirectory, TTerminal::smRemote, CopyParam, Params, Checklist, Options);
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TConsoleRunner::SynchronizeControllerRemoteChange(
+  TSynchronizeController * /*Sender*/, const UnicodeString LocalDirectory,
+  const UnicodeString RemoteDirectory, const TCopyParamType & CopyParam,
+  const TSynchronizeParamType & Params, TSynchronizeChecklist ** Checklist,
+  TSynchronizeOptions * Options, bool Full)
+{
+  DebugAssert(!Full);
+  DebugUsedParam(Full);
+  KeepUpToDateSynchronize(LocalDirectory, RemoteDirectory, TTerminal::smLocal, CopyParam, Params, Checklist, Options);
+}
+//---------------------------------------------------------------------------
+void __fastcall TConsoleRunner::KeepUpToDateSynchronize(
+  const UnicodeString & LocalDirectory, const UnicodeString & RemoteDirectory, TTerminal::TSynchronizeMode Mode,
+  const TCopyParamType & CopyParam, const TSynchronizeParamType & Params,
+  TSynchronizeChecklist ** Checklist, TSynchronizeOptions * Options)
+{
+  try
+  {
+    FScript->Synchronize(LocalDirectory, RemoteDirectory, Mode, CopyParam,
+      Params.Params, Options, Checklist);
+  }
+  catch (Exception &)
+  {
+    if ((FScript->Batch == TScript::BatchContinue) &&
+        FScript->Terminal->Active)
     {
-      FScript->Synchronize(LocalDirectory, RemoteDirectory, CopyParam,
-        Params.Params, Checklist);
+      // noop
     }
-    catch (Exception &)
+    else
     {
-      if ((FScript->Batch == TScript::BatchContinue) &&
-          FScript->Terminal->Active)
-      {
-        // noop
-      }
-      else
-      {
-        throw;
-      }
+      throw;
     }
   }
 }
@@ -3,8 +3,78 @@
 #pragma hdrstop
 
 #include <SessionData.h>
+#include <PuttyTools.h>
 #include "EditorManager.h"
 //---------------------------------------------------------------------------
+static const int EditedFileBlockSize = 1024 * 1024;
+//---------------------------------------------------------------------------
+TEditedFileBlocks::TEditedFileBlocks()
+{
+  Size = -1;
+}
+//---------------------------------------------------------------------------
+void TEditedFileBlocks::Calculate(const UnicodeString & FileName)
+{
+  Size = 0;
+  Hashes.clear();
+  // Before reading, so that a change while reading is detected by IsFileUnchanged
+  TSearchRecSmart SearchRec;
+  Modification = FileSearchRec(FileName, SearchRec) ? SearchRec.GetLastWriteTime() : TDateTime();
+  // The editor may keep the file opened for writing, do not block it either (like TTerminal::OpenLocalFile)
+  std::unique_ptr<TFileStream> Stream(new TFileStream(ApiPath(FileName), fmOpenRead | fmShareDenyNone));
+  RawByteString Buffer;
+  Buffer.SetLength(EditedFileBlockSize);
+  int Read;
+  while ((Read = Stream->Read(Buffer.c_str(), EditedFileBlockSize)) > 0)
+  {
+    Hashes.push_back(Sha256(Buffer.c_str(), Read));
+    Size += Read;
+  }
+}
+//---------------------------------------------------------------------------
+bool TEditedFileBlocks::ChangedRanges(const TEditedFileBlocks & Previous, TFileRanges & Ranges) const
+{
+  // Nothing to compare to or nothing to keep.
+  // Files of a single block are not worth it, they are uploaded whole (via a temporary file, if configured).
+  bool Result = (Previous.Size > EditedFileBlockSize) && (Size > 0);
+  if (Result)
+  {
+    for (size_t Index = 0; Index < Hashes.size(); Index++)
+    {
+      bool Last = (Index == Hashes.size() - 1);
+      // When the size has changed, the last block has to be written (even if it matches) to set the new size
+      bool Changed =
+        (Index >= Previous.Hashes.size()) ||
+        (Hashes[Index] != Previous.Hashes[Index]) ||
+        (Last && (Size != Previous.Size));
+      if (Changed)
+      {
+        __int64 Offset = static_cast<__int64>(Index) * EditedFileBlockSize;
+        __int64 BlockSize = std::min(static_cast<__int64>(EditedFileBlockSize), Size - Offset);
+        // Merge with the preceding changed block
+        if (!Ranges.empty() && (Ranges.back().first + Ranges.back().second == Offset))
+        {
+          Ranges.back().second += BlockSize;
+        }
+        else
+        {
+          Ranges.push_back(std::make_pair(Offset, BlockSize));
+        }
+      }
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+bool TEditedFileBlocks::IsFileUnchanged(const UnicodeString & FileName) const
+{
+  TSearchRecSmart SearchRec;
+  return
+    FileSearchRec(FileName, SearchRec) &&
+    (SearchRec.Size == Size) &&
+    (SearchRec.GetLastWriteTime() == Modification);
+}
+//---------------------------------------------------------------------------
 TEditedFileData::TEditedFileData()
 {
   ForceText = false;
@@ -7,6 +7,23 @@
 class TManagedTerminal;
 class TTerminalQueue;
 //---------------------------------------------------------------------------
+// Hashes of fixed-size blocks of an edited file, to upload only the changed blocks on the next save
+struct TEditedFileBlocks
+{
+  TEditedFileBlocks();
+
+  void Calculate(const UnicodeString & FileName);
+  bool ChangedRanges(const TEditedFileBlocks & Previous, TFileRanges & Ranges) const;
+  bool IsFileUnchanged(const UnicodeString & FileName) const;
+
+  __int64 Size;
+  // Of the local file, when the hashes were calculated
+  TDateTime Modification;
+  // Of the remote file, once uploaded
+  TDateTime RemoteModification;
+  std::vector<UnicodeString> Hashes;
+};
+//---------------------------------------------------------------------------
 struct TEditedFileData
 {
   TEditedFileData();
@@ -21,6 +38,8 @@ struct TEditedFileData
   UnicodeString OriginalFileName;
   UnicodeString Command;
   TDateTime SourceTimestamp;
+  // Blocks of the file as it was last uploaded, invalidated while uploading
+  TEditedFileBlocks UploadedBlocks;
 };
 //---------------------------------------------------------------------------
 typedef void __fastcall (__closure * TEditedFileChangedEvent)
@@ -570,6 +570,7 @@ void __fastcall TGUIConfiguration::Default()
   FBeepSound = L"SystemDefault";
   FCopyParamCurrent = L"";
   FKeepUpToDateChangeDelay = 500;
+  FKeepUpToDateRemoteInterval = 10000;
   FChecksumAlg = L"sha1";
   FSessionReopenAutoIdle = SessionReopenAutoIdleDefault;
   FSessionReopenAutoIdleOn = true;
@@ -649,6 +650,7 @@ void __fastcall TGUIConfiguration::UpdateStaticUsage()
     KEY(DateTime, BeepOnFinishAfter); \
     KEY(String,   BeepSound); \
     KEY(Integer,  KeepUpToDateChangeDelay); \
+    KEY(Integer,  KeepUpToDateRemoteInterval); \
     KEY(String,   ChecksumAlg); \
     KEY(Integer,  SessionReopenAutoIdle); \
     KEY(Bool,     SessionReopenAutoIdleOn); \
@@ -21,6 +21,7 @@ const int soRecurse =         0x01;
 const int soSynchronize =     0x02;
 const int soSynchronizeAsk =  0x04;
 const int soContinueOnError = 0x08;
+const int soRemoteChanges =   0x10;
 //---------------------------------------------------------------------------
 class TGUICopyParamType : public TCopyParamType
 {
@@ -186,6 +187,7 @@ private:
   UnicodeString FCopyParamCurrent;
   TRemoteProperties FNewDirectoryProperties;
   int FKeepUpToDateChangeDelay;
+  int FKeepUpToDateRemoteInterval;
   UnicodeString FChecksumAlg;
   int FSessionReopenAutoIdle;
   bool FSessionReopenAutoIdleOn;
@@ -288,6 +290,7 @@ public:
   __property bool HasCopyParamPreset[UnicodeString Name] = { read = GetHasCopyParamPreset };
   __property TRemoteProperties NewDirectoryProperties = { read = FNewDirectoryProperties, write = SetNewDirectoryProperties };
   __property int KeepUpToDateChangeDelay = { read = FKeepUpToDateChangeDelay, write = FKeepUpToDateChangeDelay };
+  __property int KeepUpToDateRemoteInterval = { read = FKeepUpToDateRemoteInterval, write = FKeepUpToDateRemoteInterval };
   __property UnicodeString ChecksumAlg = { read = FChecksumAlg, write = FChecksumAlg };
   __property int SessionReopenAutoIdle = { read = FSessionReopenAutoIdle, write = FSessionReopenAutoIdle };
   __property bool SessionReopenAutoIdleOn = { read = FSessionReopenAutoIdleOn, write = FSessionReopenAutoIdleOn };
@@ -5,6 +5,7 @@
 #include <RemoteFiles.h>
 #include <Terminal.h>
 #include <DiscMon.hpp>
+#include <DirectoryMonitor.hpp>
 #include "SynchronizeController.h"
 //---------------------------------------------------------------------------
 __fastcall TSynchronizeController::TSynchronizeController(
@@ -15,6 +16,9 @@ __fastcall TSynchronizeController::TSynchronizeController(
   FOnSynchronizeInvalid = AOnSynchronizeInvalid;
   FOnTooManyDirectories = AOnTooManyDirectories;
   FSynchronizeMonitor = NULL;
+  FChangeMonitor = NULL;
+  FChangesLost = 0;
+  FOnRemoteChange = NULL;
   FSynchronizeAbort = NULL;
   FSynchronizeLog = NULL;
   FOptions = NULL;
@@ -23,6 +27,7 @@ __fastcall TSynchronizeController::TSynchronizeController(
 __fastcall TSynchronizeController::~TSynchronizeController()
 {
   DebugAssert(FSynchronizeMonitor == NULL);
+  DebugAssert(FChangeMonitor == NULL);
 }
 //---------------------------------------------------------------------------
 void __fastcall TSynchronizeController::StartStop(TObject * Sender,
@@ -83,12 +88,14 @@ void __fastcall TSynchronizeController::StartStop(TObject * Sender,
       FSynchronizeMonitor->OnSynchronize = OnSynchronizeThreads;
       // get count before open to avoid thread issues
       int Directories = FSynchronizeMonitor->Directories->Count;
+      StartChangeMonitor(dynamic_cast<TComponent*>(Sender));
       FSynchronizeMonitor->Open();
 
       SynchronizeLog(slStart, FMTLOAD(SYNCHRONIZE_START, (Directories)));
     }
     catch(...)
     {
+      StopChangeMonitor();
       SAFE_DESTROY(FSynchronizeMonitor);
       throw;
     }
@@ -96,10 +103,474 @@ void __fastcall TSynchronizeController::StartStop(TObject * Sender,
   else
   {
     FOptions = NULL;
+    StopChangeMonitor();
     SAFE_DESTROY(FSynchronizeMonitor);
   }
 }
 //---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::StartChangeMonitor(TComponent * Owner)
+{
+  DebugAssert(FChangeMonitor == NULL);
+  FChangesLost = 0;
+  std::unique_ptr<TDirectoryMonitor> ChangeMonitor(new TDirectoryMonitor(Owner));
+  ChangeMonitor->Path = FSynchronizeParams.LocalDirectory;
+  ChangeMonitor->WatchSubtree = FLAGSET(FSynchronizeParams.Options, soRecurse);
+  ChangeMonitor->WatchFilters =
+    FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE;
+  ChangeMonitor->OnCreated = FileChanged;
+  ChangeMonitor->OnModified = FileChanged;
+  ChangeMonitor->OnDeleted = FileChanged;
+  ChangeMonitor->OnRenamed = FileRenamed;
+  ChangeMonitor->OnOverflow = ChangesLost;
+  try
+  {
+    ChangeMonitor->Active = true;
+    FChangeMonitor = ChangeMonitor.release();
+  }
+  catch (Exception & E)
+  {
+    // Not supported on some file systems.
+    // Without individual changes, the whole directories are compared on every change.
+    AppLogFmt(L"Cannot watch individual file changes in %s: %s", (FSynchronizeParams.LocalDirectory, E.Message));
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::StopChangeMonitor()
+{
+  SAFE_DESTROY(FChangeMonitor);
+  for (TChangedFiles::iterator I = FChangedFiles.begin(); I != FChangedFiles.end(); I++)
+  {
+    delete I->second;
+  }
+  FChangedFiles.clear();
+  FDirectoryChangesLost.clear();
+  FDirectoryCollected.clear();
+  FRemoteDirectories.clear();
+  FOwnRemoteChanges.clear();
+  FRemoteRootDirectory = UnicodeString();
+  FRemotePolled = TDateTime();
+}
+//---------------------------------------------------------------------------
+static UnicodeString __fastcall ChangedDirectoryKey(const UnicodeString & Directory)
+{
+  return AnsiUpperCase(IncludeTrailingBackslash(Directory));
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::FileChanged(TObject * /*Sender*/, const UnicodeString FileName)
+{
+  // Above this, it is not worth tracking the individual files
+  const int MaxChangedFiles = 1000;
+
+  UnicodeString Key = ChangedDirectoryKey(ExtractFilePath(FileName));
+  TChangedFiles::iterator I = FChangedFiles.find(Key);
+  if (I == FChangedFiles.end())
+  {
+    I = FChangedFiles.insert(std::make_pair(Key, CreateSortedStringList())).first;
+  }
+
+  // The file change notifications and the directory change notifications come from different threads.
+  // A change reported only shortly after the directory was synchronized was possibly part
+  // of that synchronization already, but it was not included in its list of changed files.
+  // Such change would otherwise be missed until another change in the directory,
+  // so compare the whole directory the next time.
+  std::map<UnicodeString, TDateTime>::iterator C = FDirectoryCollected.find(Key);
+  if (C != FDirectoryCollected.end())
+  {
+    int LateChangeDelay = std::max(GUIConfiguration->KeepUpToDateChangeDelay, static_cast<int>(MSecsPerSec));
+    if (WithinPastMilliSeconds(Now(), C->second, LateChangeDelay))
+    {
+      SAFE_DESTROY(I->second);
+    }
+    FDirectoryCollected.erase(C);
+  }
+
+  if (I->second != NULL)
+  {
+    UnicodeString Name = ExtractFileName(FileName);
+    // The change can be reported with a short 8.3 name, which would not match the long name
+    if ((Name.Pos(L"~") > 0) || (I->second->Count >= MaxChangedFiles))
+    {
+      SAFE_DESTROY(I->second);
+    }
+    else
+    {
+      // Duplicates are ignored, so repeated changes of the same file are coalesced
+      I->second->Add(Name);
+    }
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::FileRenamed(
+  TObject * Sender, const UnicodeString FromFileName, const UnicodeString ToFileName)
+{
+  FileChanged(Sender, FromFileName);
+  FileChanged(Sender, ToFileName);
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::ChangesLost(TObject * /*Sender*/)
+{
+  // We do not know, what directories were affected, so all need to be fully compared
+  FChangesLost++;
+}
+//---------------------------------------------------------------------------
+bool __fastcall TSynchronizeController::CollectChangedFiles(
+  const UnicodeString & Directory, TSynchronizeOptions * Options, TSynchronizeOptions & ChangedOptions)
+{
+  bool Result = false;
+  if (FChangeMonitor != NULL)
+  {
+    // Process the file change notifications that are still waiting for the main thread
+    CheckSynchronize();
+
+    UnicodeString Key = ChangedDirectoryKey(Directory);
+    FDirectoryCollected[Key] = Now();
+    std::unique_ptr<TStringList> FileNames;
+    TChangedFiles::iterator I = FChangedFiles.find(Key);
+    if (I != FChangedFiles.end())
+    {
+      FileNames.reset(I->second);
+      FChangedFiles.erase(I);
+    }
+
+    bool Lost = false;
+    if (FChangesLost > 0)
+    {
+      int & DirectoryChangesLost = FDirectoryChangesLost[Key];
+      Lost = (DirectoryChangesLost < FChangesLost);
+      DirectoryChangesLost = FChangesLost;
+    }
+
+    // When no change was recorded (it is possibly still being delivered),
+    // it is safer to compare the whole directory
+    if (!Lost && (FileNames.get() != NULL) && (FileNames->Count > 0))
+    {
+      ChangedOptions.Filter = CreateSortedStringList();
+      for (int Index = 0; Index < FileNames->Count; Index++)
+      {
+        UnicodeString FileName = FileNames->Strings[Index];
+        if ((Options == NULL) || Options->MatchesFilter(FileName))
+        {
+          ChangedOptions.Filter->Add(FileName);
+        }
+      }
+      Result = true;
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::AddRemoteDirectory(const UnicodeString & Directory, TDateTime NextPoll)
+{
+  if (FRemoteDirectories.find(Directory) == FRemoteDirectories.end())
+  {
+    TRemoteDirectoryState State;
+    State.NextPoll = NextPoll;
+    State.Interval = GUIConfiguration->KeepUpToDateRemoteInterval;
+    State.Listed = false;
+    State.Count = 0;
+    State.SizeSum = 0;
+    State.MaxModification = TDateTime();
+    FRemoteDirectories.insert(std::make_pair(Directory, State));
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::RemoveRemoteDirectory(const UnicodeString & Directory)
+{
+  // The keys include trailing slash, so this removes the directory with all its subdirectories
+  TRemoteDirectories::iterator I = FRemoteDirectories.lower_bound(Directory);
+  while ((I != FRemoteDirectories.end()) && StartsStr(Directory, I->first))
+  {
+    I = FRemoteDirectories.erase(I);
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::PollRemoteChanges(TTerminal * Terminal)
+{
+  // Not to block the local changes for too long
+  const int MaxDirectoriesPerPoll = 10;
+
+  TDateTime N = Now();
+  // The owner may call us more often, not to iterate all directories too often
+  if ((FSynchronizeMonitor != NULL) &&
+      FLAGSET(FSynchronizeParams.Options, soRemoteChanges) &&
+      (FOnRemoteChange != NULL) &&
+      !WithinPastMilliSeconds(N, FRemotePolled, MSecsPerSec))
+  {
+    FRemotePolled = N;
+    try
+    {
+      if (FRemoteRootDirectory.IsEmpty())
+      {
+        FRemoteRootDirectory =
+          UnixIncludeTrailingBackslash(Terminal->AbsolutePath(FSynchronizeParams.RemoteDirectory, true));
+        AddRemoteDirectory(FRemoteRootDirectory, N);
+      }
+
+      // The most overdue first. As unchanged directories back off,
+      // the recently changed directories are polled more often.
+      typedef std::vector<std::pair<double, UnicodeString> > TDueDirectories;
+      TDueDirectories DueDirectories;
+      for (TRemoteDirectories::const_iterator I = FRemoteDirectories.begin(); I != FRemoteDirectories.end(); I++)
+      {
+        if (I->second.NextPoll <= N)
+        {
+          DueDirectories.push_back(std::make_pair(static_cast<double>(I->second.NextPoll), I->first));
+        }
+      }
+      std::sort(DueDirectories.begin(), DueDirectories.end());
+
+      for (TDueDirectories::const_iterator I = DueDirectories.begin();
+           (I != DueDirectories.end()) && (I - DueDirectories.begin() < MaxDirectoriesPerPoll);
+           I++)
+      {
+        // may have been removed with its parent meanwhile
+        if (FRemoteDirectories.find(I->second) != FRemoteDirectories.end())
+        {
+          PollRemoteDirectory(Terminal, I->second);
+        }
+      }
+    }
+    catch (Exception & E)
+    {
+      SynchronizeAbort(dynamic_cast<EFatal*>(&E) != NULL);
+    }
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::PollRemoteDirectory(TTerminal * Terminal, const UnicodeString & Directory)
+{
+  const int MaxIntervalFactor = 16;
+
+  std::unique_ptr<TRemoteFileList> FileList;
+  try
+  {
+    FileList.reset(Terminal->CustomReadDirectoryListing(Directory, false));
+  }
+  catch (Exception & E)
+  {
+    // Losing the connection or the root directory (or an abort) ends the synchronization
+    if ((dynamic_cast<EFatal*>(&E) != NULL) || (dynamic_cast<EAbort*>(&E) != NULL) ||
+        (Directory == FRemoteRootDirectory))
+    {
+      throw;
+    }
+    // The directory was most likely deleted, what the poll of its parent reflects.
+    // If it was not, the parent poll adds it back, once its contents change.
+    RemoveRemoteDirectory(Directory);
+    return;
+  }
+  TDateTime N = Now();
+  int BaseInterval = GUIConfiguration->KeepUpToDateRemoteInterval;
+  int MaxInterval = BaseInterval * MaxIntervalFactor;
+  // Adding subdirectories below does not invalidate the reference
+  TRemoteDirectoryState & State = FRemoteDirectories[Directory];
+
+  // on error user may select "skip", then we get NULL
+  if (FileList.get() == NULL)
+  {
+    State.Interval = MaxInterval;
+  }
+  else
+  {
+    TRemoteFileStates Files;
+    int Count = 0;
+    __int64 SizeSum = 0;
+    TDateTime MaxModification;
+    for (int Index = 0; Index < FileList->Count; Index++)
+    {
+      TRemoteFile * File = FileList->Files[Index];
+      bool Allowed = !File->IsParentDirectory && !File->IsThisDirectory;
+      if (Allowed && !FCopyParam.AllowAnyTransfer()) // optimization
+      {
+        TFileMasks::TParams MaskParams;
+        MaskParams.Size = File->Resolve()->Size;
+        MaskParams.Modification = File->Modification;
+        Allowed = FCopyParam.AllowTransfer(Directory + File->FileName, osRemote, File->IsDirectory, MaskParams, File->IsHidden);
+      }
+
+      if (Allowed)
+      {
+        TRemoteFileState FileState;
+        FileState.Size = File->IsDirectory ? 0 : File->Size;
+        FileState.Modification = File->Modification;
+        // Not descending into symlinked directories to avoid cycles
+        FileState.IsDirectory = File->IsDirectory && !File->IsSymLink;
+        Files.insert(std::make_pair(File->FileName, FileState));
+        Count++;
+        SizeSum += FileState.Size;
+        if (FileState.Modification > MaxModification)
+        {
+          MaxModification = FileState.Modification;
+        }
+      }
+    }
+
+    // Renames or replacements may keep the fingerprint,
+    // so the listing is compared even when it has not changed
+    bool Changed =
+      State.Listed &&
+      ((Count != State.Count) || (SizeSum != State.SizeSum) || (MaxModification != State.MaxModification));
+    std::unique_ptr<TStringList> ChangedFiles(CreateSortedStringList(true));
+    if (!State.Listed)
+    {
+      // The first listing is just the baseline to compare the later listings against
+      for (TRemoteFileStates::const_iterator I = Files.begin(); I != Files.end(); I++)
+      {
+        if (I->second.IsDirectory)
+        {
+          AddRemoteDirectory(UnixIncludeTrailingBackslash(Directory + I->first), N);
+        }
+      }
+    }
+    else
+    {
+      for (TRemoteFileStates::const_iterator I = Files.begin(); I != Files.end(); I++)
+      {
+        UnicodeString SubDirectory = UnixIncludeTrailingBackslash(Directory + I->first);
+        TRemoteFileStates::const_iterator Previous = State.Files.find(I->first);
+        if (Previous == State.Files.end())
+        {
+          // New directories are transferred as a whole
+          ChangedFiles->Add(I->first);
+          if (I->second.IsDirectory)
+          {
+            AddRemoteDirectory(SubDirectory, IncMilliSecond(N, BaseInterval));
+          }
+        }
+        else if (I->second.IsDirectory && Previous->second.IsDirectory)
+        {
+          // Contents of the directory have changed, poll it straight away
+          if (I->second.Modification != Previous->second.Modification)
+          {
+            Changed = true;
+            TRemoteDirectories::iterator SubState = FRemoteDirectories.find(SubDirectory);
+            if (SubState != FRemoteDirectories.end())
+            {
+              SubState->second.NextPoll = N;
+              SubState->second.Interval = BaseInterval;
+            }
+            else
+            {
+              // Its listing has failed before
+              AddRemoteDirectory(SubDirectory, N);
+            }
+          }
+        }
+        else if ((I->second.IsDirectory != Previous->second.IsDirectory) ||
+                 (I->second.Size != Previous->second.Size) ||
+                 (I->second.Modification != Previous->second.Modification))
+        {
+          ChangedFiles->Add(I->first);
+          if (Previous->second.IsDirectory)
+          {
+            RemoveRemoteDirectory(SubDirectory);
+          }
+          else if (I->second.IsDirectory)
+          {
+            AddRemoteDirectory(SubDirectory, IncMilliSecond(N, BaseInterval));
+          }
+        }
+      }
+
+      for (TRemoteFileStates::const_iterator I = State.Files.begin(); I != State.Files.end(); I++)
+      {
+        if (Files.find(I->first) == Files.end())
+        {
+          ChangedFiles->Add(I->first);
+          if (I->second.IsDirectory)
+          {
+            RemoveRemoteDirectory(UnixIncludeTrailingBackslash(Directory + I->first));
+          }
+        }
+      }
+    }
+
+    UnicodeString RelativeDirectory =
+      Directory.SubString(FRemoteRootDirectory.Length() + 1, Directory.Length() - FRemoteRootDirectory.Length());
+    DiscardOwnRemoteChanges(RelativeDirectory, Files, ChangedFiles.get());
+
+    Changed = Changed || (ChangedFiles->Count > 0);
+    State.Interval = Changed ? BaseInterval : std::min(State.Interval * 2, MaxInterval);
+    State.Listed = true;
+    State.Count = Count;
+    State.SizeSum = SizeSum;
+    State.MaxModification = MaxModification;
+    State.Files.swap(Files);
+
+    if (ChangedFiles->Count > 0)
+    {
+      UnicodeString LocalDirectory =
+        IncludeTrailingBackslash(FSynchronizeParams.LocalDirectory) + FromUnixPath(RelativeDirectory);
+
+      SynchronizeLog(slChange, FMTLOAD(SYNCHRONIZE_CHANGE, (UnixExcludeTrailingBackslash(Directory))));
+
+      TSynchronizeOptions Options;
+      Options.Filter = ChangedFiles.release();
+      TSynchronizeParamType Params = FSynchronizeParams;
+      // What we have just listed is newer than the cache
+      Params.Params &= ~TTerminal::spUseCache;
+      FOnRemoteChange(this, LocalDirectory, Directory, FCopyParam, Params, NULL, &Options, false);
+    }
+  }
+  State.NextPoll = IncMilliSecond(N, State.Interval);
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::RecordOwnRemoteChanges(
+  const UnicodeString & RelativeDirectory, TSynchronizeChecklist * Checklist)
+{
+  for (int Index = 0; Index < Checklist->Count; Index++)
+  {
+    const TSynchronizeChecklist::TItem * Item = Checklist->Item[Index];
+    if (Item->Checked && !Item->IsDirectory)
+    {
+      switch (Item->Action)
+      {
+        case TSynchronizeChecklist::saUploadNew:
+        case TSynchronizeChecklist::saUploadUpdate:
+          FOwnRemoteChanges[RelativeDirectory + Item->GetFileName()] = true;
+          break;
+
+        case TSynchronizeChecklist::saDeleteRemote:
+          FOwnRemoteChanges[RelativeDirectory + Item->GetFileName()] = false;
+          break;
+
+        default:
+          // noop
+          break;
+      }
+    }
+  }
+}
+//---------------------------------------------------------------------------
+void __fastcall TSynchronizeController::DiscardOwnRemoteChanges(
+  const UnicodeString & RelativeDirectory, const TRemoteFileStates & Files, TStringList * ChangedFiles)
+{
+  // The uploaded files differ from the previous listing (particularly with timestamps not preserved),
+  // but they must not be reflected back on the local directory.
+  // The new size and timestamp are not known (text mode, timestamp precision),
+  // so the first change found after the upload is attributed to it, if the file still exists.
+  TOwnRemoteChanges::iterator I = FOwnRemoteChanges.lower_bound(RelativeDirectory);
+  while ((I != FOwnRemoteChanges.end()) && StartsStr(RelativeDirectory, I->first))
+  {
+    UnicodeString FileName = I->first.SubString(RelativeDirectory.Length() + 1, I->first.Length() - RelativeDirectory.Length());
+    if (FileName.Pos(L"/") > 0)
+    {
+      I++;
+    }
+    else
+    {
+      TRemoteFileStates::const_iterator File = Files.find(FileName);
+      bool Exists = (File != Files.end()) && !File->second.IsDirectory;
+      int ChangedIndex = ChangedFiles->IndexOf(FileName);
+      if ((ChangedIndex >= 0) && (Exists == I->second))
+      {
+        ChangedFiles->Delete(ChangedIndex);
+      }
+      I = FOwnRemoteChanges.erase(I);
+    }
+  }
+}
+//---------------------------------------------------------------------------
 void __fastcall TSynchronizeController::SynchronizeChange(
   TObject * /*Sender*/, const UnicodeString Directory, bool & SubdirsChanged)
 {
@@ -114,9 +585,10 @@ void __fastcall TSynchronizeController::SynchronizeChange(
 
     DebugAssert(LocalDirectory.SubString(1, RootLocalDirectory.Length()) ==
       RootLocalDirectory);
-    RemoteDirectory = RemoteDirectory +
+    UnicodeString RelativeDirectory =
       ToUnixPath(LocalDirectory.SubString(RootLocalDirectory.Length() + 1,
         LocalDirectory.Length() - RootLocalDirectory.Length()));
+    RemoteDirectory = RemoteDirectory + RelativeDirectory;
 
     SynchronizeLog(slChange, FMTLOAD(SYNCHRONIZE_CHANGE,
       (ExcludeTrailingBackslash(LocalDirectory))));
@@ -128,6 +600,11 @@ void __fastcall TSynchronizeController::SynchronizeChange(
       // can contain non-root specific options in future
       TSynchronizeOptions * Options =
         ((LocalDirectory == RootLocalDirectory) ? FOptions : &DefaultOptions);
+      TSynchronizeOptions ChangedOptions;
+      if (CollectChangedFiles(LocalDirectory, Options, ChangedOptions))
+      {
+        Options = &ChangedOptions;
+      }
       TSynchronizeChecklist * Checklist = NULL;
       FOnSynchronize(this, LocalDirectory, RemoteDirectory, FCopyParam,
         FSynchronizeParams, &Checklist, Options, false);
@@ -135,6 +612,11 @@ void __fastcall TSynchronizeController::SynchronizeChange(
       {
         try
         {
+          if (FLAGSET(FSynchronizeParams.Options, soRemoteChanges))
+          {
+            RecordOwnRemoteChanges(RelativeDirectory, Checklist);
+          }
+
           if (FLAGSET(FSynchronizeParams.Options, soRecurse))
           {
             SubdirsChanged = false;
@@ -41,6 +41,10 @@ namespace Discmon
 {
 class TDiscMonitor;
 }
+namespace Directorymonitor
+{
+class TDirectoryMonitor;
+}
 //---------------------------------------------------------------------------
 enum TSynchronizeOperation { soUpload, soDelete };
 //---------------------------------------------------------------------------
@@ -59,11 +63,59 @@ public:
     TSynchronizeLog OnSynchronizeLog);
   void __fastcall LogOperation(TSynchronizeOperation Operation, const UnicodeString FileName);
 
+  // Individual file changes, to synchronize only the changed files, once the directory change is notified.
+  // Fed by TDirectoryMonitor, but can be fed by any other source of changes.
+  void __fastcall FileChanged(TObject * Sender, const UnicodeString FileName);
+  void __fastcall FileRenamed(TObject * Sender, const UnicodeString FromFileName, const UnicodeString ToFileName);
+  void __fastcall ChangesLost(TObject * Sender);
+
+  // With soRemoteChanges, to be called periodically, relists remote directories that are due
+  // and reflects their changes via OnRemoteChange
+  void __fastcall PollRemoteChanges(TTerminal * Terminal);
+
+  __property TSynchronizeEvent OnRemoteChange = { read = FOnRemoteChange, write = FOnRemoteChange };
+
 private:
+  // NULL list means that the whole directory needs to be compared
+  typedef std::map<UnicodeString, TStringList *> TChangedFiles;
+  struct TRemoteFileState
+  {
+    __int64 Size;
+    TDateTime Modification;
+    bool IsDirectory;
+  };
+  typedef std::map<UnicodeString, TRemoteFileState> TRemoteFileStates;
+  struct TRemoteDirectoryState
+  {
+    TDateTime NextPoll;
+    int Interval;
+    bool Listed;
+    // fingerprint, used only to schedule the back-off,
+    // the changes are always found by comparing the Files
+    int Count;
+    __int64 SizeSum;
+    TDateTime MaxModification;
+    TRemoteFileStates Files;
+  };
+  typedef std::map<UnicodeString, TRemoteDirectoryState> TRemoteDirectories;
+  // Remote files changed by the synchronization itself, by path relative to the remote root,
+  // true for uploaded files, false for deleted files
+  typedef std::map<UnicodeString, bool> TOwnRemoteChanges;
+
   TSynchronizeEvent FOnSynchronize;
   TSynchronizeParamType FSynchronizeParams;
   TSynchronizeOptions * FOptions;
   Discmon::TDiscMonitor * FSynchronizeMonitor;
+  Directorymonitor::TDirectoryMonitor * FChangeMonitor;
+  TChangedFiles FChangedFiles;
+  int FChangesLost;
+  std::map<UnicodeString, int> FDirectoryChangesLost;
+  std::map<UnicodeString, TDateTime> FDirectoryCollected;
+  TSynchronizeEvent FOnRemoteChange;
+  UnicodeString FRemoteRootDirectory;
+  TDateTime FRemotePolled;
+  TRemoteDirectories FRemoteDirectories;
+  TOwnRemoteChanges FOwnRemoteChanges;
   TSynchronizeAbortEvent FSynchronizeAbort;
   TSynchronizeInvalidEvent FOnSynchronizeInvalid;
   TSynchronizeTooManyDirectories FOnTooManyDirectories;
@@ -80,6 +132,16 @@ private:
     bool & Add);
   void __fastcall SynchronizeTooManyDirectories(TObject * Sender, int & MaxDirectories);
   void __fastcall SynchronizeDirectoriesChange(TObject * Sender, int Directories);
+  void __fastcall StartChangeMonitor(TComponent * Owner);
+  void __fastcall StopChangeMonitor();
+  bool __fastcall CollectChangedFiles(
+    const UnicodeString & Directory, TSynchronizeOptions * Options, TSynchronizeOptions & ChangedOptions);
+  void __fastcall AddRemoteDirectory(const UnicodeString & Directory, TDateTime NextPoll);
+  void __fastcall RemoveRemoteDirectory(const UnicodeString & Directory);
+  void __fastcall PollRemoteDirectory(TTerminal * Terminal, const UnicodeString & Directory);
+  void __fastcall RecordOwnRemoteChanges(const UnicodeString & RelativeDirectory, TSynchronizeChecklist * Checklist);
+  void __fastcall DiscardOwnRemoteChanges(
+    const UnicodeString & RelativeDirectory, const TRemoteFileStates & Files, TStringList * ChangedFiles);
 };
 //---------------------------------------------------------------------------
 void __fastcall LogSynchronizeEvent(TTerminal * Terminal, const UnicodeString & Message);
@@ -2376,6 +2376,248 @@ void TTerminalManager::TerminalLoadedDirectory(TManagedTerminal * ATerminal)
 }
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
+static const int ThumbnailPrefixSize = 128 * 1024;
+static const int ThumbnailCacheMaxAge = 30; // days
+static const __int64 ThumbnailCacheMaxSize = 64 * 1024 * 1024;
+// Thumbnails of different sessions are retrieved in parallel threads
+static LONG ThumbnailCachePruned = FALSE;
+// Bytes cached since the last pruning, so that the size limit holds even during long runs
+static LONG ThumbnailCacheAdded = 0;
+//---------------------------------------------------------------------------
+static void PruneThumbnailCache()
+{
+  TDateTime Threshold = Now() - ThumbnailCacheMaxAge;
+  // Cache hits touch the files, so the oldest write time is the least recently used entry
+  typedef std::multimap<TDateTime, std::pair<UnicodeString, __int64> > TCachedThumbnails;
+  TCachedThumbnails CachedThumbnails;
+  __int64 TotalSize = 0;
+  TSearchRecOwned SearchRec;
+  if (FindFirstUnchecked(TPath::Combine(WinConfiguration->ThumbnailCacheDirectory(), L"*.bmp"), faAnyFile, SearchRec) == 0)
+  {
+    do
+    {
+      if (SearchRec.IsRealFile())
+      {
+        TDateTime LastWriteTime = SearchRec.GetLastWriteTime();
+        if (LastWriteTime < Threshold)
+        {
+          DeleteFile(ApiPath(SearchRec.GetFilePath()));
+        }
+        else
+        {
+          CachedThumbnails.insert(std::make_pair(LastWriteTime, std::make_pair(SearchRec.GetFilePath(), static_cast<__int64>(SearchRec.Size))));
+          TotalSize += SearchRec.Size;
+        }
+      }
+    }
+    while (FindNextUnchecked(SearchRec) == 0);
+  }
+
+  TCachedThumbnails::const_iterator I = CachedThumbnails.begin();
+  while ((TotalSize > ThumbnailCacheMaxSize) && (I != CachedThumbnails.end()))
+  {
+    if (DeleteFile(ApiPath(I->second.first)))
+    {
+      TotalSize -= I->second.second;
+    }
+    ++I;
+  }
+}
+//---------------------------------------------------------------------------
+static void TouchCachedThumbnail(const UnicodeString & Path)
+{
+  HANDLE Handle =
+    CreateFile(ApiPath(Path).c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+  if (Handle != INVALID_HANDLE_VALUE)
+  {
+    FILETIME WrTime;
+    GetSystemTimeAsFileTime(&WrTime);
+    SetFileTime(Handle, NULL, NULL, &WrTime);
+    CloseHandle(Handle);
+  }
+}
+//---------------------------------------------------------------------------
+static TBitmap * LoadCachedThumbnail(const UnicodeString & Path)
+{
+  TBitmap * Result = NULL;
+  if (FileExists(ApiPath(Path)))
+  {
+    std::unique_ptr<TBitmap> Bitmap(new TBitmap());
+    try
+    {
+      Bitmap->LoadFromFile(ApiPath(Path));
+      Result = Bitmap.release();
+      TouchCachedThumbnail(Path);
+    }
+    catch (Exception & E)
+    {
+      AppLogFmt(L"Cannot load cached thumbnail %s: %s", (Path, E.Message));
+      DeleteFile(ApiPath(Path));
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+static void SaveCachedThumbnail(const UnicodeString & Path, TBitmap * Thumbnail)
+{
+  try
+  {
+    if (ForceDirectories(ApiPath(ExtractFileDir(Path))))
+    {
+      Thumbnail->SaveToFile(ApiPath(Path));
+
+      TSearchRec SearchRec;
+      if (FileSearchRec(Path, SearchRec))
+      {
+        LONG Size = static_cast<LONG>(SearchRec.Size);
+        if (InterlockedExchangeAdd(&ThumbnailCacheAdded, Size) + Size > ThumbnailCacheMaxSize / 4)
+        {
+          InterlockedExchange(&ThumbnailCacheAdded, 0);
+          PruneThumbnailCache();
+        }
+      }
+    }
+  }
+  catch (Exception & E)
+  {
+    AppLogFmt(L"Cannot cache thumbnail %s: %s", (Path, E.Message));
+  }
+}
+//---------------------------------------------------------------------------
+static unsigned int GetImageValue(const unsigned char * Data, int Len, bool BigEndian)
+{
+  unsigned int Result = 0;
+  for (int Index = 0; Index < Len; Index++)
+  {
+    Result = (Result << 8) | Data[BigEndian ? Index : (Len - 1 - Index)];
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+static bool IsImageRange(size_t Offset, size_t Size, size_t Len)
+{
+  return (Offset <= Len) && (Size <= Len - Offset);
+}
+//---------------------------------------------------------------------------
+static bool IsJpeg(const unsigned char * Data, size_t Len)
+{
+  return (Len >= 2) && (Data[0] == 0xFF) && (Data[1] == 0xD8);
+}
+//---------------------------------------------------------------------------
+// Finds the next marker segment in the given range, without going past the start of the compressed data.
+// Start and Size describe the segment payload, which might be truncated, when the data is incomplete.
+static bool FindJpegSegment(
+  const unsigned char * Data, size_t Len, unsigned char MarkerFrom, unsigned char MarkerTo,
+  size_t & Pos, size_t & Start, size_t & Size)
+{
+  bool Result = false;
+  bool Done = false;
+  while (!Done && IsImageRange(Pos, 4, Len) && (Data[Pos] == 0xFF))
+  {
+    unsigned char Marker = Data[Pos + 1];
+    size_t SegmentLen = GetImageValue(Data + Pos + 2, 2, true);
+    // SOS (start of scan) or a corrupted length
+    if ((Marker == 0xDA) || (SegmentLen < 2))
+    {
+      Done = true;
+    }
+    else
+    {
+      if ((Marker >= MarkerFrom) && (Marker <= MarkerTo))
+      {
+        Start = Pos + 4;
+        Size = SegmentLen - 2;
+        Result = true;
+        Done = true;
+      }
+      Pos += 2 + SegmentLen;
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+static bool GetJpegDimensions(const RawByteString & Jpeg, int & Width, int & Height)
+{
+  const unsigned char * Data = reinterpret_cast<const unsigned char *>(Jpeg.c_str());
+  size_t Len = Jpeg.Length();
+  size_t Pos = 2;
+  size_t Start, Size;
+  bool Result =
+    IsJpeg(Data, Len) &&
+    // SOF0 (baseline) to SOF2 (progressive)
+    FindJpegSegment(Data, Len, 0xC0, 0xC2, Pos, Start, Size) &&
+    (Size >= 5) && IsImageRange(Start, 5, Len);
+  if (Result)
+  {
+    Height = GetImageValue(Data + Start + 1, 2, true);
+    Width = GetImageValue(Data + Start + 3, 2, true);
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
+// Extracts JPEG thumbnail from EXIF APP1 segment (IFD1 JPEGInterchangeFormat tags)
+static bool ExtractExifThumbnail(const RawByteString & Prefix, RawByteString & Thumbnail)
+{
+  const unsigned char * Data = reinterpret_cast<const unsigned char *>(Prefix.c_str());
+  size_t Len = Prefix.Length();
+  bool Result = false;
+  size_t Pos = 2;
+  size_t Start, Size;
+  while (!Result && IsJpeg(Data, Len) && FindJpegSegment(Data, Len, 0xE1, 0xE1, Pos, Start, Size))
+  {
+    const size_t ExifHeaderLen = 6;
+    if (IsImageRange(Start, Size, Len) && (Size >= ExifHeaderLen + 8) &&
+        (memcmp(Data + Start, "Exif\0\0", ExifHeaderLen) == 0))
+    {
+      const unsigned char * Tiff = Data + Start + ExifHeaderLen;
+      size_t TiffLen = Size - ExifHeaderLen;
+      bool BigEndian = (Tiff[0] == 'M') && (Tiff[1] == 'M');
+      if (BigEndian || ((Tiff[0] == 'I') && (Tiff[1] == 'I')))
+      {
+        // Skip IFD0, we need only its link to IFD1, which describes the thumbnail
+        size_t Ifd = GetImageValue(Tiff + 4, 4, BigEndian);
+        if (IsImageRange(Ifd, 2, TiffLen))
+        {
+          size_t Entries = GetImageValue(Tiff + Ifd, 2, BigEndian);
+          size_t Link = Ifd + 2 + Entries * 12;
+          Ifd = IsImageRange(Link, 4, TiffLen) ? GetImageValue(Tiff + Link, 4, BigEndian) : 0;
+        }
+        else
+        {
+          Ifd = 0;
+        }
+
+        if ((Ifd > 0) && IsImageRange(Ifd, 2, TiffLen))
+        {
+          size_t Entries = GetImageValue(Tiff + Ifd, 2, BigEndian);
+          size_t ThumbnailOffset = 0;
+          size_t ThumbnailSize = 0;
+          for (size_t Index = 0; (Index < Entries) && IsImageRange(Ifd + 2 + Index * 12, 12, TiffLen); Index++)
+          {
+            const unsigned char * Entry = Tiff + Ifd + 2 + Index * 12;
+            unsigned int Tag = GetImageValue(Entry, 2, BigEndian);
+            if (Tag == 0x0201) // JPEGInterchangeFormat
+            {
+              ThumbnailOffset = GetImageValue(Entry + 8, 4, BigEndian);
+            }
+            else if (Tag == 0x0202) // JPEGInterchangeFormatLength
+            {
+              ThumbnailSize = GetImageValue(Entry + 8, 4, BigEndian);
+            }
+          }
+
+          if ((ThumbnailOffset > 0) && (ThumbnailSize > 0) && IsImageRange(ThumbnailOffset, ThumbnailSize, TiffLen))
+          {
+            Thumbnail = RawByteString(reinterpret_cast<const char *>(Tiff + ThumbnailOffset), ThumbnailSize);
+            Result = IsJpeg(Tiff + ThumbnailOffset, ThumbnailSize);
+          }
+        }
+      }
+    }
+  }
+  return Result;
+}
+//---------------------------------------------------------------------------
 TThumbnailDownloadQueueItem::TThumbnailDownloadQueueItem(
     TCustomScpExplorerForm * ScpExplorer, TManagedTerminal * Terminal, const UnicodeString & SourceDir,
     const UnicodeString & TargetDir, const TCopyParamType * CopyParam) :
@@ -2450,17 +2692,11 @@ void __fastcall TThumbnailDownloadQueueItem::DoTransferExecute(TTerminal * Termi
       }
       else if (DebugAlwaysTrue(CheckQueueFront(Index, FileName, ThumbnailSize)))
       {
-        std::unique_ptr<TStringList> Files(new TStringList());
-        Files->AddObject(FileName, File.get());
-
         std::unique_ptr<TBitmap> Thumbnail;
 
         {
           TUnguard Unguard(Section);
-          Terminal->CopyToLocal(Files.get(), FTargetDir, FCopyParam, FParams, NULL);
-          UnicodeString LocalPath =
-            TPath::Combine(FTargetDir, Terminal->ChangeFileName(FCopyParam, UnixExtractFileName(FileName), osRemote, false));
-          Thumbnail.reset(GetThumbnail(LocalPath, ThumbnailSize));
+          Thumbnail.reset(RetrieveThumbnail(Terminal, File.get(), ThumbnailSize));
         }
 
         if (CheckQueueFront(Index, FileName, ThumbnailSize))
@@ -2490,3 +2726,107 @@ void __fastcall TThumbnailDownloadQueueItem::DoTransferExecute(TTerminal * Termi
 
   FManagedTerminal->ThumbnailDownloadQueueItem = NULL;
 }
+//---------------------------------------------------------------------------
+bool TThumbnailDownloadQueueItem::CanUseEmbeddedThumbnail(TTerminal * Terminal, const TRemoteFile * File)
+{
+  UnicodeString Ext = UnixExtractFileExt(File->FileName);
+  return
+    (SameText(Ext, L".jpg") || SameText(Ext, L".jpeg")) &&
+    (File->Size > ThumbnailPrefixSize) &&
+    // Only SFTP can download a part of a file (PartSize) to memory (OnTransferOut)
+    Terminal->IsCapable[fcParallelFileTransfers] &&
+    Terminal->IsCapable[fcTransferOut];
+}
+//---------------------------------------------------------------------------
+UnicodeString TThumbnailDownloadQueueItem::ThumbnailCachePath(const TRemoteFile * File, const TSize & ThumbnailSize)
+{
+  UnicodeString Key =
+    FORMAT(L"%s\n%s\n%s\n%s\n%dx%d",
+      (FManagedTerminal->SessionData->SessionKey, File->FullFileName, IntToStr(File->Size),
+       StandardTimestamp(File->Modification), ThumbnailSize.cx, ThumbnailSize.cy));
+  UTF8String KeyBuf(Key);
+  return TPath::Combine(WinConfiguration->ThumbnailCacheDirectory(), Sha256(KeyBuf.c_str(), KeyBuf.Length()) + L".bmp");
+}
+//---------------------------------------------------------------------------
+void __fastcall TThumbnailDownloadQueueItem::ThumbnailPrefixOut(TObject *, const unsigned char * Data, size_t Len)
+{
+  FThumbnailPrefix += RawByteString(reinterpret_cast<const char *>(Data), Len);
+}
+//---------------------------------------------------------------------------
+TBitmap * TThumbnailDownloadQueueItem::RetrieveEmbeddedThumbnail(
+  TTerminal * Terminal, TStrings * Files, const TSize & ThumbnailSize)
+{
+  TCopyParamType CopyParam(*FCopyParam);
+  CopyParam.PartOffset = 0;
+  CopyParam.PartSize = ThumbnailPrefixSize;
+  CopyParam.OnTransferOut = ThumbnailPrefixOut;
+  FThumbnailPrefix = RawByteString();
+  Terminal->CopyToLocal(Files, FTargetDir, &CopyParam, FParams, NULL);
+
+  TBitmap * Result = NULL;
+  RawByteString Embedded;
+  int Width, Height;
+  if (ExtractExifThumbnail(FThumbnailPrefix, Embedded) &&
+      GetJpegDimensions(Embedded, Width, Height) &&
+      // Do not upscale, rather download the full image
+      ((Width >= ThumbnailSize.cx) || (Height >= ThumbnailSize.cy)))
+  {
+    AppLogFmt(L"Using embedded %dx%d thumbnail", (Width, Height));
+    UnicodeString LocalPath = TPath::Combine(FTargetDir, L"embedded-thumbnail.jpg");
+    {
+      std::unique_ptr<TFileStream> Stream(new TFileStream(ApiPath(LocalPath), fmCreate));
+      Stream->WriteBuffer(Embedded.c_str(), Embedded.Length());
+    }
+    Result = GetThumbnail(LocalPath, ThumbnailSize);
+  }
+  FThumbnailPrefix = RawByteString();
+  return Result;
+}
+//---------------------------------------------------------------------------
+TBitmap * TThumbnailDownloadQueueItem::RetrieveThumbnail(TTerminal * Terminal, TRemoteFile * File, const TSize & ThumbnailSize)
+{
+  bool UseCache = WinConfiguration->RemoteThumbnailCache;
+  UnicodeString CachePath;
+  std::unique_ptr<TBitmap> Result;
+  if (UseCache)
+  {
+    if (InterlockedExchange(&ThumbnailCachePruned, TRUE) == FALSE)
+    {
+      PruneThumbnailCache();
+    }
+
+    CachePath = ThumbnailCachePath(File, ThumbnailSize);
+    Result.reset(LoadCachedThumbnail(CachePath));
+  }
+  if (Result.get() != NULL)
+  {
+    AppLog(L"Using cached thumbnail");
+  }
+  else
+  {
+    UnicodeString FileName = File->FullFileName;
+    std::unique_ptr<TStringList> Files(new TStringList());
+    Files->AddObject(FileName, File);
+
+    if (CanUseEmbeddedThumbnail(Terminal, File))
+    {
+      Result.reset(RetrieveEmbeddedThumbnail(Terminal, Files.get(), ThumbnailSize));
+    }
+
+    // Large JPEG files are queued even above the size limit, in a hope they have an embedded thumbnail
+    if ((Result.get() == NULL) &&
+        (File->Size <= static_cast<__int64>(WinConfiguration->RemoteThumbnailSizeLimit) * 1024))
+    {
+      Terminal->CopyToLocal(Files.get(), FTargetDir, FCopyParam, FParams, NULL);
+      UnicodeString LocalPath =
+        TPath::Combine(FTargetDir, Terminal->ChangeFileName(FCopyParam, UnixExtractFileName(FileName), osRemote, false));
+      Result.reset(GetThumbnail(LocalPath, ThumbnailSize));
+    }
+
+    if (UseCache && (Result.get() != NULL))
+    {
+      SaveCachedThumbnail(CachePath, Result.get());
+    }
+  }
+  return Result.release();
+}
@@ -266,15 +266,22 @@ public:
     const UnicodeString & TargetDir, const TCopyParamType * CopyParam);
   __fastcall ~TThumbnailDownloadQueueItem();
 
+  static bool CanUseEmbeddedThumbnail(TTerminal * Terminal, const TRemoteFile * File);
+
 protected:
   virtual void __fastcall DoTransferExecute(TTerminal * Terminal, TParallelOperation * ParallelOperation);
 
 private:
   TManagedTerminal * FManagedTerminal;
   TCustomScpExplorerForm * FScpExplorer;
+  RawByteString FThumbnailPrefix;
 
   bool Continue();
   bool CheckQueueFront(int Index, const UnicodeString & FileName, TSize ThumbnailSize);
+  TBitmap * RetrieveThumbnail(TTerminal * Terminal, TRemoteFile * File, const TSize & ThumbnailSize);
+  TBitmap * RetrieveEmbeddedThumbnail(TTerminal * Terminal, TStrings * Files, const TSize & ThumbnailSize);
+  UnicodeString ThumbnailCachePath(const TRemoteFile * File, const TSize & ThumbnailSize);
+  void __fastcall ThumbnailPrefixOut(TObject * Sender, const unsigned char * Data, size_t Len);
 };
 //---------------------------------------------------------------------------
 #endif
@@ -635,6 +635,7 @@ void __fastcall TWinConfiguration::Default()
   LoadingTooLongLimit = 15;
   RemoteThumbnailMask = EmptyStr;
   RemoteThumbnailSizeLimit = 50 * 1024;
+  RemoteThumbnailCache = true;
   FirstRun = StandardDatestamp();
 
   FEditor.Font.FontName = DefaultFixedWidthFontName;
@@ -1126,6 +1127,7 @@ THierarchicalStorage * TWinConfiguration::CreateScpStorage(bool & SessionList)
     KEY(Integer,  LoadingTooLongLimit); \
     KEY(String,   RemoteThumbnailMask); \
     KEY(Integer,  RemoteThumbnailSizeLimit); \
+    KEY(Bool,     RemoteThumbnailCache); \
     KEY(String,   FirstRun); \
   ); \
   BLOCK(L"Interface\\Editor", CANCREATE, \
@@ -2674,6 +2676,25 @@ void __fastcall TWinConfiguration::CleanupTemporaryFolders(TStrings * Folders)
   }
 }
 //---------------------------------------------------------------------------
+UnicodeString TWinConfiguration::ThumbnailCacheDirectory()
+{
+  return TPath::Combine(ExpandedTemporaryDirectory(), AppNameString() + L"Thumbnails");
+}
+//---------------------------------------------------------------------------
+bool TWinConfiguration::AnyThumbnailCache()
+{
+  return DirectoryExists(ApiPath(ThumbnailCacheDirectory()));
+}
+//---------------------------------------------------------------------------
+void __fastcall TWinConfiguration::CleanupThumbnailCache()
+{
+  UnicodeString Directory = ThumbnailCacheDirectory();
+  if (!RecursiveDeleteFile(Directory))
+  {
+    throw ExtException(LoadStr(CLEANUP_TEMP_ERROR), Directory);
+  }
+}
+//---------------------------------------------------------------------------
 int TWinConfiguration::GetResourceModuleCompleteness(HINSTANCE Module)
 {
   UnicodeString CompletenessStr = LoadStrFrom(Module, TRANSLATION_COMPLETENESS);
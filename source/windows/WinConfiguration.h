@@ -494,6 +494,7 @@ private:
   bool FSessionTabCaptionTruncation;
   UnicodeString FRemoteThumbnailMask;
   int FRemoteThumbnailSizeLimit;
+  bool FRemoteThumbnailCache;
   UnicodeString FFirstRun;
   int FDontDecryptPasswords;
   int FMasterPasswordSession;
@@ -679,6 +680,9 @@ public:
   void __fastcall CleanupTemporaryFolders();
   void __fastcall CleanupTemporaryFolders(TStrings * Folders = NULL);
   UnicodeString __fastcall ExpandedTemporaryDirectory();
+  UnicodeString ThumbnailCacheDirectory();
+  bool AnyThumbnailCache();
+  void __fastcall CleanupThumbnailCache();
   void __fastcall CheckDefaultTranslation();
   const TEditorPreferences * __fastcall DefaultEditorForFile(
     const UnicodeString FileName, bool Local, const TFileMasks::TParams & MaskParams);
@@ -830,6 +834,7 @@ public:
   __property int LoadingTooLongLimit = { read = GetLoadingTooLongLimit, write = SetLoadingTooLongLimit };
   __property UnicodeString RemoteThumbnailMask = { read = FRemoteThumbnailMask, write = FRemoteThumbnailMask };
   __property int RemoteThumbnailSizeLimit = { read = FRemoteThumbnailSizeLimit, write = FRemoteThumbnailSizeLimit };
+  __property bool RemoteThumbnailCache = { read = FRemoteThumbnailCache, write = FRemoteThumbnailCache };
   __property UnicodeString FirstRun = { read = FFirstRun, write = SetFirstRun };
   __property LCID DefaultLocale = { read = FDefaultLocale };
   __property int LocaleCompletenessTreshold = { read = GetLocaleCompletenessTreshold };
@@ -671,6 +671,7 @@ public:
     UnicodeString Message) = 0;
   virtual bool __fastcall HasFlag(TConsoleFlag Flag) const = 0;
   virtual bool __fastcall PendingAbort() = 0;
+  virtual void __fastcall Idle() = 0;
   virtual void __fastcall SetTitle(UnicodeString Title) = 0;
   virtual void __fastcall WaitBeforeExit() = 0;
   virtual void __fastcall Progress(TScriptProgress & Progress) = 0;